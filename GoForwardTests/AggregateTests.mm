@@ -0,0 +1,334 @@
+//
+//  AggregateTests.mm
+//  GoForwardTests
+//
+
+#import <XCTest/XCTest.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <realm/group.hpp>
+#include <realm/group_by.hpp>
+#include <realm/aggregate_sketch.hpp>
+#include <realm/distinct_filter.hpp>
+
+using namespace realm;
+
+namespace {
+
+enum { col_Country, col_Amount, col_Price, col_Flag };
+
+TableRef make_sales()
+{
+    struct { const char* country; int64_t amount; double price; bool flag; } rows[] = {
+        { "NO", 10, 1.0, true },
+        { "SE",  5, 2.0, false },
+        { "NO", 20, 3.0, false },
+        { "DK",  7, 4.0, true },
+        { "SE",  1, 5.0, false },
+        { "NO", 30, 6.0, true }
+    };
+    TableRef table = Table::create();
+    table->add_column(type_String, "country");
+    table->add_column(type_Int, "amount");
+    table->add_column(type_Double, "price");
+    table->add_column(type_Bool, "flag");
+    for (const auto& row: rows) {
+        std::size_t i = table->add_empty_row();
+        table->set_string(col_Country, i, row.country);
+        table->set_int(col_Amount, i, row.amount);
+        table->set_double(col_Price, i, row.price);
+        table->set_bool(col_Flag, i, row.flag);
+    }
+    return table;
+}
+
+TableRef make_numbers(int64_t first, int64_t last)
+{
+    TableRef table = Table::create();
+    table->add_column(type_Int, "value");
+    table->add_empty_row(std::size_t(last - first + 1));
+    for (int64_t v = first; v <= last; ++v)
+        table->set_int(0, std::size_t(v - first), v);
+    return table;
+}
+
+template<class F> bool throws_logic_error(F func)
+{
+    try {
+        func();
+    }
+    catch (LogicError&) {
+        return true;
+    }
+    return false;
+}
+
+} // anonymous namespace
+
+@interface AggregateTests : XCTestCase
+@end
+
+@implementation AggregateTests
+
+- (void)testGroupByOneKeyWithSeveralAggregates {
+    TableRef table = make_sales();
+    GroupBy group_by(*table);
+    std::size_t key = group_by.add_key(col_Country);
+    std::size_t sum = group_by.add_aggregate(Table::aggr_sum, col_Amount);
+    std::size_t num = group_by.add_aggregate(Table::aggr_count);
+    std::size_t avg = group_by.add_aggregate(Table::aggr_avg, col_Price);
+    std::size_t max = group_by.add_aggregate(Table::aggr_max, col_Amount);
+    GroupByResult result = group_by.run();
+
+    // Groups are reported in the order of their first row
+    XCTAssertEqual(result.size(), 3);
+    XCTAssertTrue(result.get_key(key, 0).get_string() == "NO");
+    XCTAssertTrue(result.get_key(key, 1).get_string() == "SE");
+    XCTAssertTrue(result.get_key(key, 2).get_string() == "DK");
+    XCTAssertEqual(result.get_first_row(1), 1);
+
+    XCTAssertEqual(result.get_aggregate(sum, 0).get_int(), 60);
+    XCTAssertEqual(result.get_aggregate(num, 0).get_int(), 3);
+    XCTAssertEqual(result.get_aggregate(avg, 0).get_double(), 10.0 / 3);
+    XCTAssertEqual(result.get_aggregate(max, 0).get_int(), 30);
+    XCTAssertEqual(result.get_aggregate(sum, 1).get_int(), 6);
+    XCTAssertEqual(result.get_aggregate(avg, 1).get_double(), 3.5);
+    XCTAssertEqual(result.get_count(num, 2), 1);
+}
+
+- (void)testGroupByMatchesTableAggregate {
+    TableRef table = make_sales();
+    GroupBy group_by(*table);
+    group_by.add_key(col_Country);
+    group_by.add_aggregate(Table::aggr_sum, col_Amount);
+    GroupByResult result = group_by.run();
+
+    for (std::size_t i = 0; i < result.size(); ++i) {
+        StringData country = result.get_key(0, i).get_string();
+        int64_t expected = table->where().equal(col_Country, country).sum_int(col_Amount);
+        XCTAssertEqual(result.get_aggregate(0, i).get_int(), expected);
+    }
+}
+
+- (void)testGroupByMultipleKeysOverQuery {
+    TableRef table = make_sales();
+    GroupBy group_by(*table);
+    group_by.add_key(col_Country);
+    group_by.add_key(col_Flag);
+    std::size_t num = group_by.add_aggregate(Table::aggr_count);
+    Query query = table->where().greater(col_Amount, 1);
+    GroupByResult result = group_by.run(query);
+
+    // (NO, true), (SE, false), (NO, false), (DK, true); SE/1 is filtered out
+    XCTAssertEqual(result.size(), 4);
+    XCTAssertTrue(result.get_key(0, 0).get_string() == "NO");
+    XCTAssertTrue(result.get_key(1, 0).get_bool());
+    XCTAssertEqual(result.get_aggregate(num, 0).get_int(), 2);
+    XCTAssertTrue(result.get_key(0, 2).get_string() == "NO");
+    XCTAssertFalse(result.get_key(1, 2).get_bool());
+    XCTAssertEqual(result.get_aggregate(num, 1).get_int(), 1);
+}
+
+- (void)testGroupByLinkedColumnSeparatesNullLinks {
+    Group group;
+    TableRef owners = group.add_table("owners");
+    owners->add_column(type_String, "city");
+    owners->add_empty_row(3);
+    owners->set_string(0, 0, "Oslo");
+    owners->set_string(0, 1, "Bergen");
+    owners->set_string(0, 2, "Oslo");
+    TableRef accounts = group.add_table("accounts");
+    accounts->add_column_link(type_Link, "owner", *owners);
+    accounts->add_column(type_Int, "balance");
+    accounts->add_empty_row(5);
+    std::size_t links[] = { 0, 1, npos, 2, npos };
+    for (std::size_t i = 0; i < 5; ++i) {
+        if (links[i] != npos)
+            accounts->set_link(0, i, links[i]);
+        accounts->set_int(1, i, int64_t(i + 1));
+    }
+
+    GroupBy group_by(*accounts);
+    group_by.add_key(0, 0);
+    std::size_t sum = group_by.add_aggregate(Table::aggr_sum, 1);
+    GroupByResult result = group_by.run();
+
+    XCTAssertEqual(result.size(), 3);
+    XCTAssertTrue(result.get_key(0, 0).get_string() == "Oslo");
+    XCTAssertEqual(result.get_aggregate(sum, 0).get_int(), 1 + 4);
+    XCTAssertTrue(result.get_key(0, 1).get_string() == "Bergen");
+    XCTAssertTrue(result.is_null_link(0, 2));
+    XCTAssertTrue(result.is_null(0, 2));
+    XCTAssertEqual(result.get_aggregate(sum, 2).get_int(), 3 + 5);
+}
+
+- (void)testGroupByNullableKeySeparatesNullFromZero {
+    TableRef table = Table::create();
+    table->add_column(type_Int, "key", true);
+    table->add_empty_row(3);
+    table->set_int(0, 0, 0);
+    table->set_null(0, 1);
+    table->set_int(0, 2, 0);
+
+    GroupBy group_by(*table);
+    group_by.add_key(0);
+    std::size_t num = group_by.add_aggregate(Table::aggr_count);
+    GroupByResult result = group_by.run();
+
+    XCTAssertEqual(result.size(), 2);
+    XCTAssertFalse(result.is_null(0, 0));
+    XCTAssertEqual(result.get_aggregate(num, 0).get_int(), 2);
+    XCTAssertTrue(result.is_null(0, 1));
+    XCTAssertFalse(result.is_null_link(0, 1));
+}
+
+- (void)testGroupByParallelMatchesSingleThreaded {
+    std::size_t n = GroupBy::parallel_threshold + 5000;
+    TableRef table = Table::create();
+    table->add_column(type_Int, "key");
+    table->add_column(type_Double, "value");
+    table->add_empty_row(n);
+    std::mt19937 rng(7);
+    for (std::size_t i = 0; i < n; ++i) {
+        table->set_int(0, i, int64_t(rng() % 1000));
+        table->set_double(1, i, double(rng() % 100));
+    }
+
+    GroupBy serial(*table);
+    serial.add_key(0);
+    serial.add_aggregate(Table::aggr_sum, 1);
+    serial.set_num_threads(1);
+    GroupByResult expected = serial.run();
+
+    GroupBy parallel(*table);
+    parallel.add_key(0);
+    parallel.add_aggregate(Table::aggr_sum, 1);
+    parallel.set_num_threads(4);
+    GroupByResult result = parallel.run();
+
+    XCTAssertEqual(result.size(), expected.size());
+    for (std::size_t i = 0; i < std::min(result.size(), expected.size()); ++i) {
+        XCTAssertEqual(result.get_first_row(i), expected.get_first_row(i));
+        XCTAssertEqual(result.get_aggregate(0, i).get_double(), expected.get_aggregate(0, i).get_double());
+    }
+}
+
+- (void)testGroupByRejectsUnsupportedTypes {
+    TableRef table = Table::create();
+    table->add_column(type_Binary, "binary");
+    table->add_column(type_String, "string");
+    GroupBy group_by(*table);
+    XCTAssertTrue(throws_logic_error([&] { group_by.add_key(0); }));
+    XCTAssertTrue(throws_logic_error([&] { group_by.add_key(1, 0); }));
+    XCTAssertTrue(throws_logic_error([&] { group_by.add_aggregate(Table::aggr_sum); }));
+    XCTAssertTrue(throws_logic_error([&] { group_by.add_aggregate(Table::aggr_sum, 1); }));
+    XCTAssertNoThrow(group_by.add_key(1));
+}
+
+- (void)testVarianceAndExactQuantiles {
+    TableRef table = make_numbers(1, 100);
+    TableView view = table->where().find_all();
+
+    std::size_t count = 0;
+    XCTAssertEqualWithAccuracy(Statistics::variance(view, 0, &count), 841.6666666, 1e-6);
+    XCTAssertEqual(count, 100);
+    XCTAssertEqualWithAccuracy(Statistics::stddev(view, 0), std::sqrt(841.6666666), 1e-6);
+    XCTAssertEqual(Statistics::median(view, 0, Statistics::mode_exact), 50.5);
+    XCTAssertEqual(Statistics::quantile(view, 0, 0, Statistics::mode_exact), 1);
+    XCTAssertEqual(Statistics::quantile(view, 0, 1, Statistics::mode_exact), 100);
+    XCTAssertEqual(Statistics::count_distinct(view, 0, Statistics::mode_exact), 100);
+
+    Query query = table->where().greater(0, 50);
+    XCTAssertEqualWithAccuracy(Statistics::variance(query, 0), 212.5, 1e-9);
+    XCTAssertEqual(Statistics::count_distinct(query, 0, Statistics::mode_exact), 50);
+}
+
+- (void)testApproximateStatisticsAreClose {
+    TableRef table = make_numbers(0, 9999);
+    TableView view = table->where().find_all();
+
+    std::vector<double> q = Statistics::quantiles(view, 0, { 0.1, 0.5, 0.99 });
+    XCTAssertEqual(q.size(), 3);
+    XCTAssertEqualWithAccuracy(q[0], 999.9, 100);
+    XCTAssertEqualWithAccuracy(q[1], 4999.5, 100);
+    XCTAssertEqualWithAccuracy(q[2], 9899.01, 100);
+
+    std::size_t distinct = Statistics::count_distinct(view, 0);
+    XCTAssertEqualWithAccuracy(double(distinct), 10000.0, 500.0);
+}
+
+- (void)testAccumulatorsMerge {
+    VarianceAccumulator all, first, second;
+    HyperLogLog all_hll, first_hll, second_hll;
+    for (int i = 0; i < 1000; ++i) {
+        all.add(i * 0.5);
+        (i < 300 ? first : second).add(i * 0.5);
+        all_hll.add(int64_t(i));
+        (i < 300 ? first_hll : second_hll).add(int64_t(i));
+    }
+    first.merge(second);
+    XCTAssertEqual(first.count(), all.count());
+    XCTAssertEqualWithAccuracy(first.mean(), all.mean(), 1e-9);
+    XCTAssertEqualWithAccuracy(first.variance(), all.variance(), 1e-6);
+
+    first_hll.merge(second_hll);
+    XCTAssertEqual(first_hll.estimate(), all_hll.estimate());
+}
+
+- (void)testStatisticsRejectStringColumns {
+    TableRef table = Table::create();
+    table->add_column(type_String, "string");
+    table->add_empty_row();
+    TableView view = table->where().find_all();
+    XCTAssertTrue(throws_logic_error([&] { Statistics::variance(view, 0); }));
+    XCTAssertNoThrow(Statistics::count_distinct(view, 0, Statistics::mode_exact));
+}
+
+- (void)testDistinctFilterKeepsFirstRowOfEachCombination {
+    TableRef table = make_sales();
+    DistinctFilter distinct({ col_Country, col_Flag });
+    TableView view = distinct.find_all(*table);
+
+    // (NO, true), (SE, false), (NO, false), (DK, true)
+    XCTAssertEqual(view.size(), 4);
+    std::size_t expected[] = { 0, 1, 2, 3 };
+    for (std::size_t i = 0; i < 4; ++i)
+        XCTAssertEqual(view.get_source_ndx(i), expected[i]);
+
+    Query query = table->where().equal(col_Country, "NO");
+    XCTAssertEqual(DistinctFilter({ col_Country }).find_all(query).size(), 1);
+}
+
+- (void)testDistinctFilterKeepsFirstRowInSortOrder {
+    TableRef table = make_sales();
+    TableView view = table->where().find_all();
+    view.sort(col_Amount, false);
+    DistinctFilter distinct({ col_Country });
+    distinct.apply(view);
+
+    XCTAssertEqual(view.size(), 3);
+    XCTAssertEqual(view.get_int(col_Amount, 0), 30);
+    XCTAssertEqual(view.get_int(col_Amount, 1), 7);
+    XCTAssertEqual(view.get_int(col_Amount, 2), 5);
+}
+
+- (void)testDistinctFilterSyncReappliesFilter {
+    TableRef table = make_sales();
+    DistinctFilter distinct({ col_Country });
+    Query query = table->where();
+    TableView view = distinct.find_all(query);
+    XCTAssertEqual(view.size(), 3);
+    XCTAssertFalse(distinct.sync_if_needed(view));
+
+    std::size_t row = table->add_empty_row();
+    table->set_string(col_Country, row, "FI");
+    row = table->add_empty_row();
+    table->set_string(col_Country, row, "FI");
+    XCTAssertTrue(distinct.sync_if_needed(view));
+    XCTAssertEqual(view.size(), 4);
+}
+
+@end
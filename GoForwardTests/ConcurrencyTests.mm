@@ -0,0 +1,239 @@
+//
+//  ConcurrencyTests.mm
+//  GoForwardTests
+//
+
+#import <XCTest/XCTest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <realm/handover_batch.hpp>
+#include <realm/async_query_executor.hpp>
+#include <realm/writer_queue.hpp>
+
+#include "RealmTestUtil.h"
+
+using namespace realm;
+using test_util::TestRealm;
+
+namespace {
+
+// Table "values" with one Int column, where row i holds i
+void create_table(TestRealm& realm, std::size_t num_rows)
+{
+    realm.write([=](Group& group) {
+        TableRef table = group.add_table("values");
+        table->add_column(type_Int, "value");
+        table->add_empty_row(num_rows);
+        for (std::size_t i = 0; i < num_rows; ++i)
+            table->set_int(0, i, int64_t(i));
+    });
+}
+
+void add_value(TestRealm& realm, int64_t value)
+{
+    realm.write([=](Group& group) {
+        TableRef table = group.get_table("values");
+        table->set_int(0, table->add_empty_row(), value);
+    });
+}
+
+// Collects the results that the executor delivers on its worker threads
+class ResultQueue {
+public:
+    AsyncQueryExecutor::Callback callback()
+    {
+        return [this](AsyncQueryExecutor::Result result) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_results.push_back(std::move(result));
+            m_cond.notify_all();
+        };
+    }
+
+    bool pop(AsyncQueryExecutor::Result& result,
+             std::chrono::milliseconds timeout = std::chrono::seconds(10))
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_cond.wait_for(lock, timeout, [this] { return !m_results.empty(); }))
+            return false;
+        result = std::move(m_results.front());
+        m_results.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<AsyncQueryExecutor::Result> m_results;
+};
+
+} // anonymous namespace
+
+@interface ConcurrencyTests : XCTestCase
+@end
+
+@implementation ConcurrencyTests
+
+- (void)testHandoverBatchImportsAtVersionOfExport {
+    TestRealm realm("handover_batch");
+    create_table(realm, 10);
+    ConstTableRef table = realm.reader->begin_read().get_table("values");
+    add_value(realm, 100);
+
+    // Exported from the newer version, which the writer holds until the
+    // batch has been imported
+    HandoverBatch batch;
+    HandoverBatch::Ticket<TableView> view_ticket;
+    HandoverBatch::Ticket<Row> row_ticket;
+    {
+        TableRef source = const_cast<Group&>(realm.writer->begin_read()).get_table("values");
+        TableView view = source->where().greater_equal(0, 5).find_all();
+        Row row = (*source)[3];
+        HandoverBatch::Exporter exporter(batch, *realm.writer);
+        view_ticket = exporter.add(view, MutableSourcePayload::Move);
+        row_ticket = exporter.add(row);
+    }
+    XCTAssertEqual(batch.size(), 2);
+    XCTAssertTrue(batch.get_version() == realm.writer->get_version_of_current_transaction());
+
+    // One advance for the whole batch
+    batch.import(*realm.reader, realm.reader_history.get());
+    realm.writer->end_read();
+    XCTAssertTrue(realm.reader->get_version_of_current_transaction() == batch.get_version());
+    XCTAssertEqual(table->size(), 11);
+
+    std::unique_ptr<TableView> view = batch.take(view_ticket);
+    std::unique_ptr<Row> row = batch.take(row_ticket);
+    XCTAssertEqual(view->size(), 6);
+    XCTAssertEqual(view->get_int(0, 5), 100);
+    XCTAssertEqual(row->get_int(0), 3);
+    realm.reader->end_read();
+}
+
+- (void)testHandoverBatchRejectsUnreachableVersion {
+    TestRealm realm("handover_batch_version");
+    create_table(realm, 10);
+    realm.reader->begin_read();
+    add_value(realm, 100);
+
+    HandoverBatch batch;
+    {
+        TableRef source = const_cast<Group&>(realm.writer->begin_read()).get_table("values");
+        Row row = (*source)[0];
+        HandoverBatch::Exporter exporter(batch, *realm.writer);
+        exporter.add(row);
+    }
+
+    // An older shared group cannot be advanced without a history
+    bool thrown = false;
+    try {
+        batch.import(*realm.reader);
+    }
+    catch (SharedGroup::BadVersion&) {
+        thrown = true;
+    }
+    XCTAssertTrue(thrown);
+    realm.writer->end_read();
+    realm.reader->end_read();
+}
+
+- (void)testExecutorRunsSubmittedQuery {
+    TestRealm realm("async_query");
+    create_table(realm, 10);
+    ConstTableRef table = realm.reader->begin_read().get_table("values");
+    AsyncQueryExecutor executor(realm.path);
+    ResultQueue results;
+
+    uint_fast64_t token = executor.submit(*realm.reader, table->where().greater(0, 4), results.callback());
+    AsyncQueryExecutor::Result result;
+    XCTAssertTrue(results.pop(result));
+    XCTAssertEqual(result.token, token);
+    XCTAssertFalse(result.error);
+
+    std::unique_ptr<TableView> view = result.import(*realm.reader, *realm.reader_history);
+    XCTAssertEqual(view->size(), 5);
+    XCTAssertEqual(view->get_int(0, 0), 5);
+
+    // Submitted queries are not rerun
+    add_value(realm, 100);
+    executor.notify();
+    XCTAssertFalse(results.pop(result, std::chrono::milliseconds(2 * AsyncQueryExecutor::poll_interval)));
+    realm.reader->end_read();
+}
+
+- (void)testExecutorRerunsSubscribedQueryUntilCancelled {
+    TestRealm realm("async_query_subscribe");
+    create_table(realm, 10);
+    ConstTableRef table = realm.reader->begin_read().get_table("values");
+    AsyncQueryExecutor executor(realm.path);
+    ResultQueue results;
+
+    uint_fast64_t token = executor.subscribe(*realm.reader, table->where().greater(0, 4), results.callback());
+    AsyncQueryExecutor::Result result;
+    XCTAssertTrue(results.pop(result));
+    XCTAssertEqual(result.import(*realm.reader, *realm.reader_history)->size(), 5);
+
+    // The reader is advanced to the version of the rerun
+    add_value(realm, 100);
+    executor.notify();
+    XCTAssertTrue(results.pop(result));
+    XCTAssertEqual(result.token, token);
+    std::unique_ptr<TableView> view = result.import(*realm.reader, *realm.reader_history);
+    XCTAssertEqual(view->size(), 6);
+    XCTAssertEqual(table->size(), 11);
+
+    executor.cancel(token);
+    add_value(realm, 200);
+    executor.notify();
+    XCTAssertFalse(results.pop(result, std::chrono::milliseconds(2 * AsyncQueryExecutor::poll_interval)));
+    realm.reader->end_read();
+}
+
+- (void)testWriterQueueCountsTurnsAndYields {
+    test_util::TestPath path("writer_queue");
+    WriterQueue queue(path);
+    {
+        WriterQueue::Turn turn(queue, WriterQueue::priority_Normal);
+        XCTAssertFalse(turn.should_yield());
+        turn.yield();
+    }
+    WriterQueue::Stats stats = queue.get_stats(WriterQueue::priority_Normal);
+    XCTAssertEqual(stats.num_turns, 2);
+    XCTAssertEqual(stats.num_yields, 1);
+    XCTAssertEqual(queue.get_stats(WriterQueue::priority_High).num_turns, 0);
+    XCTAssertEqual(queue.get_num_waiting(WriterQueue::priority_Normal), 0);
+}
+
+- (void)testWriterQueueLetsHighPriorityWriterInFirst {
+    test_util::TestPath path("writer_queue_priority");
+    WriterQueue queue(path);
+    std::mutex mutex;
+    std::vector<std::string> order;
+    auto record = [&](const char* name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        order.push_back(name);
+    };
+
+    WriterQueue::Turn low(queue, WriterQueue::priority_Low);
+    std::thread high_writer([&] {
+        WriterQueue::Turn high(queue, WriterQueue::priority_High);
+        record("high");
+    });
+    while (queue.get_num_waiting(WriterQueue::priority_High) == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    XCTAssertTrue(low.should_yield());
+
+    low.yield();
+    record("low");
+    high_writer.join();
+    XCTAssertTrue(order == (std::vector<std::string>{ "high", "low" }));
+    XCTAssertFalse(low.should_yield());
+}
+
+@end
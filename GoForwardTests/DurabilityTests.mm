@@ -0,0 +1,142 @@
+//
+//  DurabilityTests.mm
+//  GoForwardTests
+//
+
+#import <XCTest/XCTest.h>
+
+#include <string>
+
+#include <realm/write_ahead_log.hpp>
+#include <realm/mem_only.hpp>
+
+#include "RealmTestUtil.h"
+
+using namespace realm;
+
+namespace {
+
+void add_rows(Group& group, std::size_t num_rows, std::size_t value_size)
+{
+    TableRef table = group.get_or_add_table("data");
+    if (table->get_column_count() == 0)
+        table->add_column(type_String, "value");
+    std::string value(value_size, 'x');
+    for (std::size_t i = 0; i < num_rows; ++i) {
+        std::size_t row = table->add_empty_row();
+        table->set_string(0, row, value);
+    }
+}
+
+} // anonymous namespace
+
+@interface DurabilityTests : XCTestCase
+@end
+
+@implementation DurabilityTests
+
+#ifdef REALM_HAVE_WRITE_AHEAD_LOG
+
+- (void)testWriteAheadLogGrowsWithEveryCommit {
+    test_util::TestPath path("wal");
+    {
+        WriteAheadLog wal(path);
+        SharedGroup sg(wal, SharedGroup::durability_Async);
+        util::File::SizeType prev_size = wal.get_log_size();
+        for (int i = 0; i < 3; ++i) {
+            WriteTransaction wt(sg);
+            add_rows(wt.get_group(), 10, 100);
+            wt.commit();
+            XCTAssertGreaterThan(wal.get_log_size(), prev_size);
+            prev_size = wal.get_log_size();
+        }
+
+        // A rolled back transaction leaves no entry
+        {
+            WriteTransaction wt(sg);
+            add_rows(wt.get_group(), 10, 100);
+        }
+        XCTAssertEqual(wal.get_log_size(), prev_size);
+    }
+
+    // Every commit reached the database file when the session ended, so
+    // there is nothing to replay, and the log is truncated
+    XCTAssertEqual(WriteAheadLog::recover(path), 0);
+    {
+        WriteAheadLog wal(path);
+        XCTAssertEqual(wal.get_log_size(), 0);
+        SharedGroup sg(wal, SharedGroup::durability_Async);
+        ReadTransaction rt(sg);
+        XCTAssertEqual(rt.get_table("data")->size(), 30);
+    }
+}
+
+- (void)testWriteAheadLogRecoveryIgnoresTornEntry {
+    test_util::TestPath path("wal_torn");
+    {
+        WriteAheadLog wal(path);
+        SharedGroup sg(wal, SharedGroup::durability_Async);
+        WriteTransaction wt(sg);
+        add_rows(wt.get_group(), 1, 10);
+        wt.commit();
+    }
+
+    // As left by a crash in the middle of an append
+    {
+        util::File file(WriteAheadLog::get_log_path(path), util::File::mode_Update);
+        file.seek(file.get_size());
+        file.write("\x07\x00\x00\x00", 4);
+    }
+    XCTAssertNoThrow(WriteAheadLog::recover(path));
+    {
+        SharedGroup sg(path);
+        ReadTransaction rt(sg);
+        XCTAssertEqual(rt.get_table("data")->size(), 1);
+    }
+}
+
+#endif // REALM_HAVE_WRITE_AHEAD_LOG
+
+- (void)testMemOnlyPathFallsBackWithoutRamBackedDir {
+    std::string dir = MemOnly::get_memory_backed_dir();
+#ifdef __APPLE__
+    XCTAssertTrue(dir.empty());
+#endif
+    std::string path = MemOnly::get_path("cache.realm", "/fallback");
+    if (dir.empty())
+        XCTAssertTrue(path == "/fallback/cache.realm");
+    else
+        XCTAssertTrue(path == dir + "/cache.realm");
+}
+
+- (void)testMemOnlyCommitReportsGrowthPastLimit {
+    test_util::TestPath path("mem_only");
+    SharedGroup sg(path, false, SharedGroup::durability_MemOnly);
+
+    // No limit
+    add_rows(sg.begin_write(), 10, 10);
+    XCTAssertNoThrow(MemOnly::commit_and_check_size(sg, 0));
+
+    const std::size_t max_size = 64 * 1024;
+    add_rows(sg.begin_write(), 200, 1000);
+    bool thrown = false;
+    try {
+        MemOnly::commit_and_check_size(sg, max_size);
+    }
+    catch (DatabaseSizeLimitExceeded&) {
+        thrown = true;
+    }
+    XCTAssertTrue(thrown);
+
+    // The transaction was still committed, and commits that do not grow the
+    // file are accepted even though it is past the limit
+    {
+        ReadTransaction rt(sg);
+        XCTAssertEqual(rt.get_table("data")->size(), 210);
+    }
+    Group& group = sg.begin_write();
+    group.get_table("data")->set_string(0, 0, "y");
+    XCTAssertNoThrow(MemOnly::commit_and_check_size(sg, max_size));
+}
+
+@end
@@ -0,0 +1,245 @@
+//
+//  QueryTests.mm
+//  GoForwardTests
+//
+
+#import <XCTest/XCTest.h>
+
+#include <vector>
+
+#include <realm/query_cursor.hpp>
+#include <realm/row_index_set.hpp>
+#include <realm/batch_reader.hpp>
+#include <realm/prepared_query.hpp>
+
+using namespace realm;
+
+namespace {
+
+enum { col_Int, col_Double, col_String };
+
+// Spans several B+-tree leaves (REALM_MAX_BPNODE_SIZE is 1000)
+const std::size_t num_rows = 2500;
+
+TableRef make_table(std::size_t n = num_rows)
+{
+    const char* names[] = { "alpha", "Beta", "gamma", "DELTA", "epsilon" };
+    TableRef table = Table::create();
+    table->add_column(type_Int, "int");
+    table->add_column(type_Double, "double");
+    table->add_column(type_String, "string");
+    table->add_empty_row(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        table->set_int(col_Int, i, int64_t(i));
+        table->set_double(col_Double, i, i * 0.25);
+        table->set_string(col_String, i, names[i % 5]);
+    }
+    return table;
+}
+
+std::vector<std::size_t> get_rows(const TableView& view)
+{
+    std::vector<std::size_t> rows;
+    for (std::size_t i = 0; i < view.size(); ++i)
+        rows.push_back(view.get_source_ndx(i));
+    return rows;
+}
+
+template<class F> bool throws_logic_error(F func)
+{
+    try {
+        func();
+    }
+    catch (LogicError&) {
+        return true;
+    }
+    return false;
+}
+
+} // anonymous namespace
+
+@interface QueryTests : XCTestCase
+@end
+
+@implementation QueryTests
+
+- (void)testCursorProducesMatchesInBatches {
+    TableRef table = make_table();
+    Query query = table->where().greater(col_Int, 999);
+    QueryCursor cursor(query, 400);
+
+    std::vector<std::size_t> rows;
+    std::vector<std::size_t> batch_sizes;
+    std::size_t n;
+    while ((n = cursor.next_batch(rows)) != 0)
+        batch_sizes.push_back(n);
+
+    XCTAssertTrue(batch_sizes == (std::vector<std::size_t>{ 400, 400, 400, 300 }));
+    XCTAssertTrue(rows == get_rows(query.find_all()));
+    XCTAssertTrue(cursor.is_at_end());
+    XCTAssertEqual(cursor.get_num_yielded(), 1500);
+}
+
+- (void)testCursorSkip {
+    TableRef table = make_table();
+    Query query = table->where().greater(col_Int, 999);
+    QueryCursor cursor(query, 10);
+
+    XCTAssertEqual(cursor.skip(1000), 1000);
+    std::vector<std::size_t> rows;
+    XCTAssertEqual(cursor.next_batch(rows), 10);
+    XCTAssertEqual(rows.front(), 2000);
+    XCTAssertEqual(cursor.skip(1000), 490);
+    XCTAssertTrue(cursor.is_at_end());
+    XCTAssertEqual(cursor.get_num_yielded(), 1500);
+}
+
+- (void)testCursorRequiresResetAfterChange {
+    TableRef table = make_table();
+    QueryCursor cursor(table->where().equal(col_String, "alpha"), 100);
+    std::vector<std::size_t> rows;
+    cursor.next_batch(rows);
+    XCTAssertTrue(cursor.is_in_sync());
+
+    table->remove(0);
+    XCTAssertFalse(cursor.is_in_sync());
+    XCTAssertTrue(throws_logic_error([&] { cursor.next_batch(rows); }));
+
+    cursor.reset();
+    XCTAssertTrue(cursor.is_in_sync());
+    rows.clear();
+    cursor.next_batch(rows);
+    XCTAssertEqual(rows.front(), 4);
+}
+
+- (void)testCursorRejectsViewRestrictedQuery {
+    TableRef table = make_table();
+    TableView view = table->where().find_all();
+    Query query = table->where(&view).greater(col_Int, 10);
+    XCTAssertTrue(throws_logic_error([&] { QueryCursor cursor(query); }));
+}
+
+- (void)testRowIndexSetChoosesRepresentation {
+    TableRef table = make_table(10000);
+
+    TableView all = table->where().find_all();
+    RowIndexSet ranges(all);
+    XCTAssertEqual(ranges.get_kind(), RowIndexSet::kind_ranges);
+
+    std::vector<std::size_t> every_other;
+    for (std::size_t i = 0; i < 10000; i += 2)
+        every_other.push_back(i);
+    RowIndexSet bitmap(every_other);
+    XCTAssertEqual(bitmap.get_kind(), RowIndexSet::kind_bitmap);
+
+    std::vector<std::size_t> sparse = { 9000, 17, 512, 3 };
+    RowIndexSet packed(sparse);
+    XCTAssertEqual(packed.get_kind(), RowIndexSet::kind_packed);
+
+    for (const RowIndexSet* set: { &ranges, &bitmap, &packed }) {
+        XCTAssertLessThan(set->get_byte_size(), set->size() * sizeof (std::size_t));
+    }
+    XCTAssertEqual(bitmap.size(), 5000);
+    XCTAssertEqual(bitmap.get_source_ndx(1234), 2468);
+    XCTAssertEqual(packed.get_source_ndx(0), 9000);
+    XCTAssertEqual(packed.get_source_ndx(3), 3);
+
+    std::vector<std::size_t> visited;
+    packed.for_each([&](std::size_t row) { visited.push_back(row); });
+    XCTAssertTrue(visited == sparse);
+}
+
+- (void)testRowIndexSetAggregatesMatchTableView {
+    TableRef table = make_table(10000);
+    Query query = table->where().less(col_Int, 100).Or().greater(col_Int, 5000);
+    TableView view = query.find_all();
+
+    for (const RowIndexSet& set: { RowIndexSet(view), RowIndexSet(query) }) {
+        XCTAssertEqual(set.size(), view.size());
+        XCTAssertEqual(set.sum_int(*table, col_Int), view.sum_int(col_Int));
+        XCTAssertEqual(set.minimum_int(*table, col_Int), view.minimum_int(col_Int));
+        XCTAssertEqual(set.maximum_int(*table, col_Int), view.maximum_int(col_Int));
+        XCTAssertEqualWithAccuracy(set.sum_double(*table, col_Double), view.sum_double(col_Double), 1e-6);
+        XCTAssertEqualWithAccuracy(set.average_int(*table, col_Int), view.average_int(col_Int), 1e-9);
+    }
+}
+
+- (void)testBatchReaderRangesMatchSingleRowReads {
+    TableRef table = make_table();
+    std::vector<int64_t> ints(num_rows);
+    std::vector<double> doubles(num_rows);
+    std::vector<StringData> strings(num_rows);
+    BatchReader::get_int_range(*table, col_Int, 0, num_rows, ints.data());
+    BatchReader::get_double_range(*table, col_Double, 0, num_rows, doubles.data());
+    BatchReader::get_string_range(*table, col_String, 0, num_rows, strings.data());
+    for (std::size_t i = 0; i < num_rows; ++i) {
+        if (ints[i] != table->get_int(col_Int, i) || doubles[i] != table->get_double(col_Double, i) ||
+                strings[i] != table->get_string(col_String, i)) {
+            XCTFail(@"Mismatch at row %zu", i);
+            break;
+        }
+    }
+
+    // A range that starts and ends inside leaves
+    std::vector<int64_t> part(1200);
+    BatchReader::get_int_range(*table, col_Int, 990, 2190, part.data());
+    XCTAssertEqual(part.front(), 990);
+    XCTAssertEqual(part.back(), 2189);
+}
+
+- (void)testBatchReaderGather {
+    TableRef table = make_table();
+    std::size_t rows[] = { 2499, 0, 1000, 999, 1001, 7 };
+    int64_t ints[6];
+    StringData strings[6];
+    BatchReader::gather_int(*table, col_Int, rows, 6, ints);
+    BatchReader::gather_string(*table, col_String, rows, 6, strings);
+    for (std::size_t i = 0; i < 6; ++i) {
+        XCTAssertEqual(ints[i], int64_t(rows[i]));
+        XCTAssertTrue(strings[i] == table->get_string(col_String, rows[i]));
+    }
+
+    TableView view = table->where().equal(col_String, "gamma").find_all();
+    view.sort(col_Int, false);
+    std::vector<double> doubles(view.size());
+    BatchReader::gather_double(view, col_Double, 0, view.size(), doubles.data());
+    for (std::size_t i = 0; i < view.size(); ++i)
+        XCTAssertEqual(doubles[i], view.get_double(col_Double, i));
+}
+
+- (void)testPreparedQueryRebindsParameters {
+    TableRef table = make_table();
+    PreparedQuery prepared(table->where().equal(col_String, "alpha"));
+    std::size_t min = prepared.add_condition<GreaterEqual>(col_Int, int64_t(0));
+    std::size_t max = prepared.add_condition<Less>(col_Int, int64_t(0));
+    XCTAssertEqual(prepared.get_num_params(), 2);
+
+    for (int64_t lower: { 0, 10, 1234 }) {
+        prepared.set_int(min, lower);
+        prepared.set_int(max, lower + 100);
+        std::size_t expected = table->where().equal(col_String, "alpha")
+            .greater_equal(col_Int, lower).less(col_Int, lower + 100).count();
+        XCTAssertEqual(prepared.get_query().count(), expected);
+    }
+}
+
+- (void)testPreparedQueryStringParameters {
+    TableRef table = make_table();
+    PreparedQuery prepared(table->where());
+    std::size_t name = prepared.add_condition<ContainsIns>(col_String, "ALP");
+    XCTAssertEqual(prepared.get_query().count(), num_rows / 5);
+
+    // Longer than the initial value, so the buffers of the node must grow
+    prepared.set_string(name, "epsilon");
+    XCTAssertEqual(prepared.get_query().count(), num_rows / 5);
+    prepared.set_string(name, "TA");
+    XCTAssertEqual(prepared.get_query().count(), 2 * num_rows / 5);
+
+    // A copy has the same parameters, and binds independently
+    PreparedQuery copy(prepared);
+    copy.set_string(name, "zeta");
+    XCTAssertEqual(copy.get_query().count(), 0);
+    XCTAssertEqual(prepared.get_query().count(), 2 * num_rows / 5);
+}
+
+@end
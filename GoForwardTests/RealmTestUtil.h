@@ -0,0 +1,78 @@
+//
+//  RealmTestUtil.h
+//  GoForwardTests
+//
+
+#import <Foundation/Foundation.h>
+
+#include <memory>
+#include <string>
+
+#include <realm/util/file.hpp>
+#include <realm/group_shared.hpp>
+#include <realm/commit_log.hpp>
+
+namespace test_util {
+
+/// The path of a database file in the temporary directory, unique to one
+/// test. The database file and the files that accompany it (lock file,
+/// history, write-ahead log and writer queue) are removed when the path is
+/// created and when it is destroyed.
+class TestPath {
+public:
+    explicit TestPath(const char* name)
+    {
+        NSString* file = [NSString stringWithFormat:@"%s-%@.realm", name, [[NSUUID UUID] UUIDString]];
+        m_path = [[NSTemporaryDirectory() stringByAppendingPathComponent:file] UTF8String];
+        clean();
+    }
+
+    ~TestPath()
+    {
+        clean();
+    }
+
+    operator const std::string&() const { return m_path; }
+    const char* c_str() const { return m_path.c_str(); }
+
+private:
+    std::string m_path;
+
+    void clean()
+    {
+        const char* suffixes[] = { "", ".lock", ".log", ".log_a", ".log_b", ".wal", ".writers" };
+        for (const char* suffix: suffixes)
+            realm::util::File::try_remove(m_path + suffix);
+    }
+};
+
+
+/// A database with a history, opened by two shared groups: one that
+/// commits, standing in for another thread or process, and one that reads,
+/// and advances its read transaction over those commits.
+struct TestRealm {
+    TestPath path;
+    std::unique_ptr<realm::ClientHistory> writer_history;
+    std::unique_ptr<realm::SharedGroup> writer;
+    std::unique_ptr<realm::ClientHistory> reader_history;
+    std::unique_ptr<realm::SharedGroup> reader;
+
+    explicit TestRealm(const char* name):
+        path(name),
+        writer_history(realm::make_client_history(path)),
+        writer(new realm::SharedGroup(*writer_history)),
+        reader_history(realm::make_client_history(path)),
+        reader(new realm::SharedGroup(*reader_history))
+    {
+    }
+
+    /// Run \a func in a write transaction of the writer, and commit.
+    template<class F> realm::SharedGroup::version_type write(F func)
+    {
+        realm::WriteTransaction wt(*writer);
+        func(wt.get_group());
+        return wt.commit();
+    }
+};
+
+} // namespace test_util
@@ -0,0 +1,172 @@
+//
+//  RowTests.mm
+//  GoForwardTests
+//
+
+#import <XCTest/XCTest.h>
+
+#include <vector>
+
+#include <realm/row_tracker.hpp>
+#include <realm/lang_bind_helper.hpp>
+
+#include "RealmTestUtil.h"
+
+using namespace realm;
+
+namespace {
+
+TableRef make_table(std::size_t num_rows)
+{
+    TableRef table = Table::create();
+    table->add_column(type_Int, "value");
+    table->add_empty_row(num_rows);
+    for (std::size_t i = 0; i < num_rows; ++i)
+        table->set_int(0, i, int64_t(i));
+    return table;
+}
+
+std::vector<int64_t> get_values(const Table& table)
+{
+    std::vector<int64_t> values;
+    for (std::size_t i = 0; i < table.size(); ++i)
+        values.push_back(table.get_int(0, i));
+    return values;
+}
+
+} // anonymous namespace
+
+@interface RowTests : XCTestCase
+@end
+
+@implementation RowTests
+
+- (void)testTrackedRowFollowsInsertionsAndRemovals {
+    TableRef table = make_table(10);
+    RowTracker tracker(*table);
+    TrackedRow row = tracker.track(7);
+    TrackedRow last = tracker.track(9);
+    XCTAssertEqual(tracker.get_num_tracked(), 2);
+
+    tracker.remove(3);
+    XCTAssertEqual(row.get_index(), 6);
+    XCTAssertEqual(table->get_int(0, row.get_index()), 7);
+
+    tracker.insert_empty_row(0, 2);
+    XCTAssertEqual(row.get_index(), 8);
+    XCTAssertEqual(table->get_int(0, row.get_index()), 7);
+
+    // Row 2 holds 0, and the last row, which holds 9, moves there
+    tracker.move_last_over(2);
+    XCTAssertTrue(last.is_attached());
+    XCTAssertEqual(last.get_index(), 2);
+    XCTAssertEqual(table->get_int(0, last.get_index()), 9);
+
+    tracker.remove(row.get_index());
+    XCTAssertFalse(row.is_attached());
+    XCTAssertTrue(row.get_table() == nullptr);
+    XCTAssertTrue(last.get_table() == table.get());
+}
+
+- (void)testReleasedHandlesAreNotTracked {
+    TableRef table = make_table(5);
+    RowTracker tracker(*table);
+    {
+        TrackedRow a = tracker.track(1);
+        TrackedRow b = tracker.track(2);
+        TrackedRow c = std::move(b);
+        XCTAssertEqual(c.get_index(), 2);
+        XCTAssertEqual(tracker.get_num_tracked(), 2);
+        a.detach();
+        XCTAssertEqual(tracker.get_num_tracked(), 1);
+    }
+    XCTAssertEqual(tracker.get_num_tracked(), 0);
+}
+
+- (void)testClearDetachesEveryHandle {
+    TableRef table = make_table(5);
+    RowTracker tracker(*table);
+    TrackedRow a = tracker.track(0);
+    TrackedRow b = tracker.track(4);
+    tracker.clear();
+    XCTAssertEqual(table->size(), 0);
+    XCTAssertFalse(a.is_attached());
+    XCTAssertFalse(b.is_attached());
+}
+
+- (void)testTrackerObservesOtherTransactions {
+    test_util::TestRealm realm("row_tracker");
+    realm.write([](Group& group) {
+        TableRef table = group.add_table("rows");
+        table->add_column(type_Int, "value");
+        table->add_empty_row(10);
+        for (std::size_t i = 0; i < 10; ++i)
+            table->set_int(0, i, int64_t(i));
+    });
+
+    // Bindings hold the group of a read transaction as mutable, and only
+    // modify it once promoted to write
+    Group& group = const_cast<Group&>(realm.reader->begin_read());
+    TableRef table = group.get_table("rows");
+    RowTracker tracker(*table);
+    TrackedRow five = tracker.track(5);
+    TrackedRow two = tracker.track(2);
+    TrackedRow nine = tracker.track(9);
+
+    realm.write([](Group& group) {
+        TableRef t = group.get_table("rows");
+        t->insert_empty_row(0, 3);
+        t->remove(5);           // The row that held 2
+        t->move_last_over(4);   // The row that held 9 moves to 4
+    });
+    LangBindHelper::advance_read(*realm.reader, *realm.reader_history, tracker.observer());
+
+    XCTAssertFalse(two.is_attached());
+    XCTAssertEqual(table->get_int(0, five.get_index()), 5);
+    XCTAssertEqual(nine.get_index(), 4);
+    XCTAssertEqual(table->get_int(0, nine.get_index()), 9);
+    realm.reader->end_read();
+}
+
+- (void)testRemoveRowsMatchesRemovingOneByOne {
+    TableRef batch = make_table(10);
+    TableRef single = make_table(10);
+
+    // Any order, with duplicates
+    batch->remove_rows({ 7, 2, 7, 0 });
+    for (std::size_t row: { 7, 2, 0 })
+        single->remove(row);
+    XCTAssertTrue(get_values(*batch) == get_values(*single));
+    XCTAssertTrue(get_values(*batch) == (std::vector<int64_t>{ 1, 3, 4, 5, 6, 8, 9 }));
+}
+
+- (void)testMoveLastOverRowsMatchesMovingOneByOne {
+    TableRef batch = make_table(10);
+    TableRef single = make_table(10);
+
+    batch->move_last_over_rows({ 1, 8, 1 });
+    for (std::size_t row: { 8, 1 })
+        single->move_last_over(row);
+    XCTAssertTrue(get_values(*batch) == get_values(*single));
+    XCTAssertTrue(get_values(*batch) == (std::vector<int64_t>{ 0, 9, 2, 3, 4, 5, 6, 7 }));
+}
+
+- (void)testRemoveRowsUpdatesAccessors {
+    TableRef table = make_table(10);
+    Row removed = (*table)[5];
+    Row kept = (*table)[8];
+    TableView view = table->where().find_all();
+
+    table->remove_rows({ 2, 5 });
+    XCTAssertFalse(removed.is_attached());
+    XCTAssertEqual(kept.get_index(), 6);
+    XCTAssertEqual(kept.get_int(0), 8);
+    view.sync_if_needed();
+    XCTAssertEqual(view.size(), 8);
+
+    table->remove_rows({ 0, 1, 2, 3, 4, 5, 6, 7 });
+    XCTAssertTrue(table->is_empty());
+    XCTAssertFalse(kept.is_attached());
+}
+
+@end
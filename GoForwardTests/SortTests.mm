@@ -0,0 +1,189 @@
+//
+//  SortTests.mm
+//  GoForwardTests
+//
+
+#import <XCTest/XCTest.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <realm/sort_engine.hpp>
+#include <realm/collation_key.hpp>
+
+using namespace realm;
+
+namespace {
+
+enum { col_Int, col_Double, col_String, col_Bool };
+
+TableRef make_table(std::size_t num_rows, unsigned seed)
+{
+    const char* words[] = { "apple", "Apple", "\xc3\x89mile", "\xc3\xa9" "clair", "zoo", "Zebra", "", "a" };
+    std::mt19937 rng(seed);
+    TableRef table = Table::create();
+    table->add_column(type_Int, "int");
+    table->add_column(type_Double, "double");
+    table->add_column(type_String, "string");
+    table->add_column(type_Bool, "bool");
+    table->add_empty_row(num_rows);
+    for (std::size_t i = 0; i < num_rows; ++i) {
+        table->set_int(col_Int, i, int64_t(rng() % 100) - 50);
+        table->set_double(col_Double, i, double(int(rng() % 2000) - 1000) / 8);
+        table->set_string(col_String, i, words[rng() % 8]);
+        table->set_bool(col_Bool, i, rng() % 2 == 0);
+    }
+    return table;
+}
+
+// Rows that compare equal may be ordered differently, so compare the
+// sorted values rather than the row indexes
+bool same_order(const TableView& a, const TableView& b, const std::vector<std::size_t>& columns)
+{
+    if (a.size() != b.size())
+        return false;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        for (std::size_t col: columns) {
+            switch (col) {
+                case col_Int:
+                    if (a.get_int(col, i) != b.get_int(col, i))
+                        return false;
+                    break;
+                case col_Double:
+                    if (a.get_double(col, i) != b.get_double(col, i))
+                        return false;
+                    break;
+                case col_String:
+                    if (a.get_string(col, i) != b.get_string(col, i))
+                        return false;
+                    break;
+                case col_Bool:
+                    if (a.get_bool(col, i) != b.get_bool(col, i))
+                        return false;
+                    break;
+            }
+        }
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+@interface SortTests : XCTestCase
+@end
+
+@implementation SortTests
+
+- (void)testSingleColumnSortMatchesTableViewSort {
+    TableRef table = make_table(1000, 1);
+    for (std::size_t col: { col_Int, col_Double, col_String, col_Bool }) {
+        for (bool ascending: { true, false }) {
+            TableView expected = table->where().find_all();
+            expected.sort(col, ascending);
+            TableView view = table->where().find_all();
+            SortEngine({ col }, { ascending }).sort(view);
+            XCTAssertTrue(same_order(view, expected, { col }), @"column %zu", col);
+        }
+    }
+}
+
+- (void)testMultiColumnSortMatchesTableViewSort {
+    TableRef table = make_table(1000, 2);
+    std::vector<std::size_t> columns = { col_Bool, col_String, col_Int };
+    std::vector<bool> ascending = { true, false, true };
+
+    TableView expected = table->where().find_all();
+    expected.sort(columns, ascending);
+    TableView view = table->where().find_all();
+    SortEngine(columns, ascending).sort(view);
+    XCTAssertTrue(same_order(view, expected, columns));
+}
+
+- (void)testSortIsStable {
+    TableRef table = make_table(500, 3);
+    TableView view = table->where().find_all();
+    SortEngine({ col_Bool }, { true }).sort(view);
+    for (std::size_t i = 1; i < view.size(); ++i) {
+        if (view.get_bool(col_Bool, i - 1) == view.get_bool(col_Bool, i))
+            XCTAssertLessThan(view.get_source_ndx(i - 1), view.get_source_ndx(i));
+    }
+}
+
+- (void)testParallelSortMatchesSingleThreadedSort {
+    TableRef table = make_table(SortEngine::parallel_threshold + 1000, 4);
+    std::vector<std::size_t> columns = { col_String, col_Double };
+
+    TableView serial = table->where().find_all();
+    SortEngine serial_engine(columns, { true, true });
+    serial_engine.set_num_threads(1);
+    serial_engine.sort(serial);
+
+    TableView parallel = table->where().find_all();
+    SortEngine parallel_engine(columns, { true, true });
+    parallel_engine.set_num_threads(4);
+    parallel_engine.sort(parallel);
+
+    // Both are stable, so even the order of equal rows must agree
+    XCTAssertEqual(serial.size(), parallel.size());
+    for (std::size_t i = 0; i < serial.size(); ++i) {
+        if (serial.get_source_ndx(i) != parallel.get_source_ndx(i)) {
+            XCTFail(@"Orders differ at %zu", i);
+            break;
+        }
+    }
+}
+
+- (void)testSyncIfNeededResortsAfterChange {
+    TableRef table = make_table(100, 5);
+    SortEngine engine({ col_Int }, { true });
+    TableView view = table->where().find_all();
+    engine.sort(view);
+    XCTAssertFalse(engine.sync_if_needed(view));
+
+    table->set_int(col_Int, 0, -1000);
+    table->add_empty_row();
+    table->set_int(col_Int, table->size() - 1, 1000);
+    XCTAssertTrue(engine.sync_if_needed(view));
+    XCTAssertEqual(view.size(), table->size());
+    XCTAssertEqual(view.get_int(col_Int, 0), -1000);
+    XCTAssertEqual(view.get_int(col_Int, view.size() - 1), 1000);
+    XCTAssertFalse(engine.sync_if_needed(view));
+}
+
+- (void)testSortRejectsUnsupportedColumnType {
+    TableRef table = Table::create();
+    table->add_column(type_Binary, "binary");
+    table->add_empty_row(2);
+    TableView view = table->where().find_all();
+    bool thrown = false;
+    try {
+        SortEngine({ 0 }, { true }).sort(view);
+    }
+    catch (LogicError&) {
+        thrown = true;
+    }
+    XCTAssertTrue(thrown);
+}
+
+- (void)testCollationKeysAgreeWithUtf8Compare {
+    if (!collation_keys_available())
+        return;
+    const char* strings[] = {
+        "", "a", "A", "ab", "b", "B", "Z", "z", "0", " ",
+        "\xc3\xa9", "\xc3\x89", "e", "f", "\xc3\xa6", "\xc5\x93", "\xe2\x82\xac", "\xe4\xb8\xad"
+    };
+    for (const char* a: strings) {
+        std::string key_a;
+        append_collation_key(a, key_a);
+        for (const char* b: strings) {
+            std::string key_b;
+            append_collation_key(b, key_b);
+            bool expected = utf8_compare(a, b);
+            bool actual = compare_collation_keys(key_a.data(), key_a.size(), key_b.data(), key_b.size());
+            XCTAssertEqual(actual, expected, @"'%s' < '%s'", a, b);
+        }
+    }
+}
+
+@end
@@ -0,0 +1,209 @@
+//
+//  StringIndexTests.mm
+//  GoForwardTests
+//
+
+#import <XCTest/XCTest.h>
+
+#include <vector>
+
+#include <realm/index_string_fold.hpp>
+#include <realm/index_string_ngram.hpp>
+#include <realm/index_string_hash.hpp>
+#include <realm/lang_bind_helper.hpp>
+
+#include "RealmTestUtil.h"
+
+using namespace realm;
+
+namespace {
+
+TableRef make_table(const std::vector<const char*>& values)
+{
+    TableRef table = Table::create();
+    table->add_column(type_String, "name");
+    table->add_empty_row(values.size());
+    for (std::size_t i = 0; i < values.size(); ++i)
+        table->set_string(0, i, values[i]);
+    return table;
+}
+
+} // anonymous namespace
+
+@interface StringIndexTests : XCTestCase
+@end
+
+@implementation StringIndexTests
+
+- (void)testCaseFoldedLookupIgnoresCase {
+    TableRef table = make_table({ "Apple", "apple", "APPLE", "Banana", "Apricot" });
+    CaseFoldedStringIndex index(*table, 0);
+
+    std::vector<std::size_t> rows;
+    index.find_all(rows, "aPpLe");
+    XCTAssertTrue(rows == (std::vector<std::size_t>{ 0, 1, 2 }));
+    XCTAssertEqual(index.count("BANANA"), 1);
+    XCTAssertEqual(index.find_first("banana"), 3);
+    XCTAssertEqual(index.find_first("cherry"), not_found);
+
+    rows.clear();
+    index.find_all_begins_with(rows, "ap");
+    XCTAssertTrue(rows == (std::vector<std::size_t>{ 0, 1, 2, 4 }));
+}
+
+- (void)testCaseFoldedQueryCondition {
+    TableRef table = make_table({ "Apple", "Banana", "APPLE" });
+    CaseFoldedStringIndex index(*table, 0);
+
+    Query query = table->where();
+    query.expression(new CaseFoldedIndexCompare<EqualIns>(index, "apple"), true);
+    XCTAssertEqual(query.count(), 2);
+    XCTAssertEqual(query.count(), table->where().equal(0, "apple", false).count());
+}
+
+- (void)testCaseFoldedReportedChangeKeepsIndexInSync {
+    TableRef table = make_table({ "Apple", "Banana" });
+    CaseFoldedStringIndex index(*table, 0);
+    XCTAssertEqual(index.count("apple"), 1);
+
+    index.begin_change();
+    table->set_string(0, 1, "APPLE");
+    index.set(1, "Banana", "APPLE");
+    XCTAssertTrue(index.is_in_sync());
+    XCTAssertFalse(index.sync_if_needed());
+    XCTAssertEqual(index.count("apple"), 2);
+
+    index.begin_change();
+    table->insert_empty_row(0);
+    index.insert(0, "", 1, false);
+    index.begin_change();
+    table->set_string(0, 0, "apple");
+    index.set(0, "", "apple");
+    XCTAssertFalse(index.sync_if_needed());
+    std::vector<std::size_t> rows;
+    index.find_all(rows, "APPLE");
+    XCTAssertTrue(rows == (std::vector<std::size_t>{ 0, 1, 2 }));
+}
+
+- (void)testCaseFoldedUnreportedChangeCausesRebuild {
+    TableRef table = make_table({ "Apple", "Banana" });
+    CaseFoldedStringIndex index(*table, 0);
+    XCTAssertEqual(index.count("apple"), 1);
+
+    table->set_string(0, 1, "apple");
+    XCTAssertFalse(index.is_in_sync());
+    XCTAssertEqual(index.count("apple"), 2);
+    XCTAssertTrue(index.is_in_sync());
+}
+
+- (void)testObserverMaintainsIndexAcrossAdvanceRead {
+    test_util::TestRealm realm("string_index");
+    realm.write([](Group& group) {
+        TableRef table = group.add_table("fruit");
+        table->add_column(type_String, "name");
+        table->add_column(type_Int, "price");
+        table->add_empty_row(3);
+        table->set_string(0, 0, "Apple");
+        table->set_string(0, 1, "Banana");
+        table->set_string(0, 2, "Cherry");
+    });
+
+    const Group& group = realm.reader->begin_read();
+    ConstTableRef table = group.get_table("fruit");
+    CaseFoldedStringIndex fold(*table, 0);
+    TrigramStringIndex trigram(*table, 0);
+    XCTAssertEqual(fold.count("apple"), 1);
+    std::vector<std::size_t> rows;
+    XCTAssertTrue(trigram.find_candidates(rows, "ana"));
+
+    realm.write([](Group& group) {
+        TableRef t = group.get_table("fruit");
+        t->set_string(0, 2, "APPLE");
+        t->insert_empty_row(0);
+        t->set_string(0, 0, "Banana split");
+        t->set_int(1, 1, 10);
+        t->move_last_over(2);
+    });
+
+    LangBindHelper::advance_read(*realm.reader, *realm.reader_history, fold.observer());
+    XCTAssertFalse(fold.sync_if_needed());
+    XCTAssertEqual(table->size(), 3);
+    rows.clear();
+    fold.find_all(rows, "apple");
+    XCTAssertTrue(rows == (std::vector<std::size_t>{ 1, 2 }));
+    XCTAssertEqual(fold.count("banana"), 0);
+    XCTAssertEqual(fold.count("banana split"), 1);
+
+    // The trigram index was not passed to advance_read(), so it must be
+    // rebuilt rather than return stale candidates
+    XCTAssertFalse(trigram.is_in_sync());
+    XCTAssertTrue(trigram.find_candidates(rows, "split"));
+    XCTAssertTrue(rows == (std::vector<std::size_t>{ 0 }));
+    realm.reader->end_read();
+}
+
+- (void)testTrigramCandidatesAreSupersetOfMatches {
+    TableRef table = make_table({ "The Quick Brown Fox", "lazy dog", "QUICKSILVER", "quack" });
+    TrigramStringIndex index(*table, 0);
+    XCTAssertGreaterThan(index.num_grams(), 0);
+
+    std::vector<std::size_t> rows;
+    XCTAssertTrue(index.find_candidates(rows, "quick"));
+    XCTAssertTrue(rows == (std::vector<std::size_t>{ 0, 2 }));
+
+    XCTAssertTrue(index.find_candidates(rows, "zebra"));
+    XCTAssertTrue(rows.empty());
+
+    // Too short to produce a gram
+    XCTAssertFalse(index.find_candidates(rows, "qu"));
+    XCTAssertTrue(rows.empty());
+
+    Query query = table->where();
+    query.expression(new TrigramIndexCompare<ContainsIns>(index, "QUICK"), true);
+    XCTAssertEqual(query.count(), table->where().contains(0, "QUICK", false).count());
+}
+
+- (void)testTrigramKeepsInvalidUtf8ValuesAsCandidates {
+    TableRef table = make_table({ "abc", "xyz" });
+    table->set_string(0, 1, StringData("ab\xff" "c", 4));
+    TrigramStringIndex index(*table, 0);
+
+    std::vector<std::size_t> rows;
+    XCTAssertTrue(index.find_candidates(rows, "abc"));
+    XCTAssertTrue(rows == (std::vector<std::size_t>{ 0, 1 }));
+
+    // An invalid needle cannot be folded, so it cannot be filtered
+    XCTAssertFalse(index.find_candidates(rows, StringData("\xff\xfe\xfd", 3)));
+}
+
+- (void)testHashedIndexLookupWithLongCommonPrefix {
+    std::string prefix(200, 'p');
+    std::string a = prefix + "a", b = prefix + "b";
+    TableRef table = make_table({ a.c_str(), b.c_str(), a.c_str() });
+    HashedStringIndex index(*table, 0);
+
+    XCTAssertEqual(index.count(a), 2);
+    XCTAssertEqual(index.find_first(b), 1);
+    XCTAssertEqual(index.find_first(prefix), not_found);
+    std::vector<std::size_t> rows;
+    index.find_all(rows, a);
+    XCTAssertTrue(rows == (std::vector<std::size_t>{ 0, 2 }));
+
+    index.begin_change();
+    table->set_string(0, 0, b);
+    index.set(0, a, b);
+    XCTAssertFalse(index.sync_if_needed());
+    XCTAssertEqual(index.count(b), 2);
+
+    // Reported the way StringColumn reports move_last_over() to StringIndex
+    index.begin_change();
+    table->move_last_over(0);
+    index.erase(0, b, true);
+    index.begin_change();
+    index.update_ref(a, 2, 0);
+    XCTAssertFalse(index.sync_if_needed());
+    XCTAssertEqual(index.find_first(a), 0);
+    XCTAssertEqual(index.count(b), 1);
+}
+
+@end
@@ -0,0 +1,331 @@
+//
+//  TransactionTests.mm
+//  GoForwardTests
+//
+
+#import <XCTest/XCTest.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <realm/lang_bind_helper.hpp>
+#include <realm/stale_table_tracker.hpp>
+#include <realm/pinned_reader.hpp>
+#include <realm/table_change_waiter.hpp>
+#include <realm/change_set.hpp>
+#include <realm/snapshot_monitor.hpp>
+#include <realm/optimistic_transaction.hpp>
+
+#include "RealmTestUtil.h"
+
+using namespace realm;
+using test_util::TestRealm;
+
+namespace {
+
+// Tables 0 ("a") and 1 ("b"), each with two Int columns and 5 rows, where
+// row i holds i
+void create_tables(TestRealm& realm)
+{
+    realm.write([](Group& group) {
+        for (const char* name: { "a", "b" }) {
+            TableRef table = group.add_table(name);
+            table->add_column(type_Int, "x");
+            table->add_column(type_Int, "y");
+            table->add_empty_row(5);
+            for (std::size_t i = 0; i < 5; ++i) {
+                table->set_int(0, i, int64_t(i));
+                table->set_int(1, i, int64_t(i));
+            }
+        }
+    });
+}
+
+void set_int(TestRealm& realm, std::size_t table_ndx, std::size_t col_ndx, std::size_t row_ndx, int64_t value)
+{
+    realm.write([=](Group& group) {
+        group.get_table(table_ndx)->set_int(col_ndx, row_ndx, value);
+    });
+}
+
+} // anonymous namespace
+
+@interface TransactionTests : XCTestCase
+@end
+
+@implementation TransactionTests
+
+- (void)testStaleTableTrackerRecordsChangedTablesAndColumns {
+    TestRealm realm("stale_tables");
+    create_tables(realm);
+    realm.reader->begin_read();
+    StaleTableTracker stale;
+
+    set_int(realm, 0, 1, 3, 42);
+    LangBindHelper::advance_read(*realm.reader, *realm.reader_history, stale.observer());
+    XCTAssertTrue(stale.is_stale(0));
+    XCTAssertTrue(stale.is_stale(0, 1));
+    XCTAssertFalse(stale.is_stale(0, 0));
+    XCTAssertFalse(stale.is_stale(1));
+    XCTAssertFalse(stale.get_state(0)->rows_changed);
+    XCTAssertTrue(stale.get_state(1) == nullptr);
+
+    int num_refreshed = 0;
+    XCTAssertTrue(stale.refresh_if_stale(0, [&](const StaleTableTracker::TableState&) { ++num_refreshed; }));
+    XCTAssertFalse(stale.refresh_if_stale(0, [&](const StaleTableTracker::TableState&) { ++num_refreshed; }));
+    XCTAssertEqual(num_refreshed, 1);
+
+    // Row insertion changes every column
+    realm.write([](Group& group) { group.get_table(1)->add_empty_row(); });
+    LangBindHelper::advance_read(*realm.reader, *realm.reader_history, stale.observer());
+    XCTAssertFalse(stale.is_stale(0));
+    XCTAssertTrue(stale.is_stale(1, 0));
+    XCTAssertTrue(stale.get_state(1)->rows_changed);
+
+    // So does a change to the set of group-level tables
+    stale.clear_all();
+    realm.write([](Group& group) { group.add_table("c"); });
+    LangBindHelper::advance_read(*realm.reader, *realm.reader_history, stale.observer());
+    XCTAssertTrue(stale.is_stale(0));
+    XCTAssertTrue(stale.is_stale(1));
+    realm.reader->end_read();
+}
+
+- (void)testPinnedReaderReusesUnchangedSnapshot {
+    TestRealm realm("pinned_reader");
+    create_tables(realm);
+    PinnedReader reader(*realm.reader, realm.reader_history.get(), std::chrono::hours(1));
+
+    ConstTableRef table = reader.begin_read().get_table(0);
+    reader.end_read();
+    XCTAssertTrue(reader.is_pinned());
+    reader.begin_read();
+    reader.end_read();
+    XCTAssertEqual(reader.get_num_reused(), 1);
+    XCTAssertEqual(reader.get_num_refreshed(), 0);
+
+    // Advancing through the history keeps the accessors
+    set_int(realm, 0, 0, 0, 42);
+    reader.begin_read();
+    XCTAssertEqual(reader.get_num_refreshed(), 1);
+    XCTAssertTrue(table->is_attached());
+    XCTAssertEqual(table->get_int(0, 0), 42);
+    reader.end_read();
+
+    reader.release();
+    XCTAssertFalse(reader.is_pinned());
+}
+
+- (void)testPinnedReaderReleasesOldPin {
+    TestRealm realm("pinned_reader_age");
+    create_tables(realm);
+    PinnedReader reader(*realm.reader, realm.reader_history.get(), std::chrono::milliseconds(1));
+    reader.begin_read();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    reader.end_read();
+    XCTAssertFalse(reader.is_pinned());
+}
+
+- (void)testTableChangeWaiterFiltersUnwatchedChanges {
+    TestRealm realm("change_waiter");
+    create_tables(realm);
+    ConstTableRef table = realm.reader->begin_read().get_table(0);
+    TableChangeWaiter waiter(*realm.reader, *realm.reader_history);
+    waiter.watch_column(0, 1);
+    XCTAssertFalse(waiter.has_changed());
+
+    set_int(realm, 1, 1, 0, 42);
+    XCTAssertFalse(waiter.has_changed());
+    set_int(realm, 0, 0, 0, 42);
+    XCTAssertFalse(waiter.has_changed());
+    XCTAssertEqual(waiter.get_num_filtered(), 2);
+
+    set_int(realm, 0, 1, 0, 42);
+    XCTAssertTrue(waiter.has_changed());
+
+    // The read transaction is at the latest version
+    XCTAssertEqual(table->get_int(1, 0), 42);
+    realm.reader->end_read();
+}
+
+- (void)testTableChangeWaiterWakesOnWatchedCommitAndOnRelease {
+    TestRealm realm("change_waiter_wait");
+    create_tables(realm);
+    ConstTableRef table = realm.reader->begin_read().get_table(0);
+    TableChangeWaiter waiter(*realm.reader, *realm.reader_history);
+    waiter.watch_table(0);
+
+    std::thread committer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        set_int(realm, 1, 0, 0, 1);
+        set_int(realm, 0, 0, 0, 1);
+    });
+    XCTAssertTrue(waiter.wait_for_change());
+    committer.join();
+    XCTAssertEqual(table->get_int(0, 0), 1);
+
+    std::thread releaser([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        waiter.release();
+    });
+    XCTAssertFalse(waiter.wait_for_change());
+    releaser.join();
+    XCTAssertFalse(waiter.wait_for_change());
+    realm.reader->end_read();
+}
+
+- (void)testChangeSetReportsRowChanges {
+    TestRealm realm("change_set");
+    create_tables(realm);
+    realm.reader->begin_read();
+
+    realm.write([](Group& group) {
+        TableRef table = group.get_table(0);
+        table->set_int(1, 0, 100);
+        table->move_last_over(1); // Row 4 moves to 1
+        table->add_empty_row();
+    });
+    ChangeSet changes = ChangeSetBuilder::advance_read(*realm.reader, *realm.reader_history);
+
+    XCTAssertFalse(changes.table_set_changed);
+    XCTAssertTrue(changes.get_table(1) == nullptr);
+    const TableChangeSet* c = changes.get_table(0);
+    XCTAssertTrue(c != nullptr);
+    if (!c)
+        return;
+    XCTAssertFalse(c->cleared);
+    XCTAssertFalse(c->schema_changed);
+    XCTAssertEqual(c->deletions.count(), 1);
+    XCTAssertTrue(c->deletions.contains(1));
+    XCTAssertEqual(c->insertions.count(), 1);
+    XCTAssertTrue(c->insertions.contains(4));
+    XCTAssertEqual(c->modifications.count(), 1);
+    XCTAssertTrue(c->modifications.contains(0));
+    XCTAssertTrue(c->moves == (std::vector<std::pair<std::size_t, std::size_t>>{ { 4, 1 } }));
+    XCTAssertTrue(c->is_column_modified(1));
+    XCTAssertFalse(c->is_column_modified(0));
+
+    realm.write([](Group& group) { group.get_table(1)->clear(); });
+    changes = ChangeSetBuilder::advance_read(*realm.reader, *realm.reader_history);
+    XCTAssertTrue(changes.get_table(1) && changes.get_table(1)->cleared);
+    realm.reader->end_read();
+}
+
+- (void)testIndexSetMergesAdjacentRanges {
+    IndexSet set;
+    set.push_back(1);
+    set.push_back(2);
+    set.push_back(5, 8);
+    set.push_back(8);
+    XCTAssertEqual(set.count(), 6);
+    XCTAssertEqual(std::distance(set.begin(), set.end()), 2);
+    XCTAssertTrue(set.contains(7));
+    XCTAssertFalse(set.contains(3));
+}
+
+- (void)testSnapshotMonitorReportsAndReleasesStaleReaders {
+    TestRealm realm("snapshot_monitor");
+    create_tables(realm);
+    SnapshotMonitor monitor;
+    SnapshotMonitor::Reader reader(monitor, *realm.reader, "background", realm.reader_history.get());
+    ConstTableRef table = reader.begin_read().get_table(0);
+
+    for (int i = 1; i <= 3; ++i)
+        set_int(realm, 0, 0, 0, i);
+
+    SnapshotMonitor::Stats stats = monitor.get_stats(*realm.writer);
+    XCTAssertEqual(stats.readers.size(), 1);
+    if (stats.readers.size() != 1)
+        return;
+    XCTAssertTrue(stats.readers[0].label == "background");
+    XCTAssertLessThan(stats.readers[0].version, stats.latest_version);
+    XCTAssertGreaterThanOrEqual(stats.num_versions, 2);
+
+    XCTAssertEqual(monitor.request_release(std::chrono::hours(1)), 0);
+    XCTAssertEqual(monitor.request_release(SnapshotMonitor::clock::duration::zero()), 1);
+    reader.check();
+    XCTAssertEqual(table->get_int(0, 0), 3);
+
+    stats = monitor.get_stats(*realm.writer);
+    XCTAssertEqual(stats.readers.size(), 1);
+    XCTAssertEqual(stats.readers[0].version, stats.latest_version);
+    reader.end_read();
+    XCTAssertEqual(monitor.get_stats(*realm.writer).readers.size(), 0);
+}
+
+- (void)testSnapshotMonitorThrowPolicy {
+    TestRealm realm("snapshot_monitor_throw");
+    create_tables(realm);
+    SnapshotMonitor monitor(SnapshotMonitor::release_Throw);
+    SnapshotMonitor::Reader reader(monitor, *realm.reader, "report");
+    reader.begin_read();
+    XCTAssertNoThrow(reader.check());
+    monitor.request_release(SnapshotMonitor::clock::duration::zero());
+    bool thrown = false;
+    try {
+        reader.check();
+    }
+    catch (SnapshotReleaseRequested&) {
+        thrown = true;
+    }
+    XCTAssertTrue(thrown);
+    reader.end_read();
+}
+
+- (void)testOptimisticTransactionCommitsWithoutConflict {
+    TestRealm realm("optimistic");
+    create_tables(realm);
+    ConstTableRef table = realm.reader->begin_read().get_table(0);
+    {
+        OptimisticTransaction tr(*realm.reader, *realm.reader_history);
+        int64_t v = table->get_int(0, 2);
+        tr.read(0, 2);
+        tr.write(0, [=](Table& t) { t.set_int(0, 2, v + 10); });
+
+        // Modifications of other rows, and appends, do not conflict
+        set_int(realm, 0, 0, 3, 42);
+        realm.write([](Group& group) { group.get_table(0)->add_empty_row(); });
+        XCTAssertTrue(tr.commit());
+    }
+    XCTAssertEqual(table->get_int(0, 2), 12);
+    realm.reader->end_read();
+}
+
+- (void)testOptimisticTransactionDetectsConflicts {
+    TestRealm realm("optimistic_conflict");
+    create_tables(realm);
+    ConstTableRef table = realm.reader->begin_read().get_table(1);
+
+    // A modification of a row that was read
+    {
+        OptimisticTransaction tr(*realm.reader, *realm.reader_history);
+        tr.read(0, 2);
+        tr.write(1, [](Table& t) { t.set_int(0, 0, -1); });
+        set_int(realm, 0, 1, 2, 42);
+        XCTAssertFalse(tr.commit());
+        XCTAssertEqual(tr.get_conflict_table(), 0);
+    }
+    XCTAssertEqual(table->get_int(0, 0), 0);
+
+    // An insertion that shifts the rows of a table that is written
+    {
+        OptimisticTransaction tr(*realm.reader, *realm.reader_history);
+        tr.write(1, [](Table& t) { t.set_int(0, 0, -1); });
+        realm.write([](Group& group) { group.get_table(1)->insert_empty_row(0); });
+        XCTAssertFalse(tr.commit());
+        XCTAssertEqual(tr.get_conflict_table(), 1);
+    }
+
+    // A new group-level table conflicts with everything
+    {
+        OptimisticTransaction tr(*realm.reader, *realm.reader_history);
+        tr.read(1, 0);
+        realm.write([](Group& group) { group.add_table("c"); });
+        XCTAssertFalse(tr.commit());
+        XCTAssertEqual(tr.get_conflict_table(), npos);
+    }
+    realm.reader->end_read();
+}
+
+@end
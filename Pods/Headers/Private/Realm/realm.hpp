@@ -1 +1 @@
-../../../Realm/include/realm.hpp
\ No newline at end of file
+../../../../Vendor/Realm/include/realm.hpp
\ No newline at end of file
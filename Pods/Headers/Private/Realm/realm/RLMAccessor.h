@@ -1 +1 @@
-../../../../Realm/include/realm/RLMAccessor.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMAccessor.h
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/RLMAnalytics.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMAnalytics.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/RLMArray.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMArray.h
\ No newline at end of file
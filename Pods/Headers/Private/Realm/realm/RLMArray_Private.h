@@ -1 +1 @@
-../../../../Realm/include/realm/RLMArray_Private.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMArray_Private.h
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/RLMCollection.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMCollection.h
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/RLMConstants.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMConstants.h
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/RLMDefines.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMDefines.h
\ No newline at end of file
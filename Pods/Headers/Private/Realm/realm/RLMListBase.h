@@ -1 +1 @@
-../../../../Realm/include/realm/RLMListBase.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMListBase.h
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/RLMMigration.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMMigration.h
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/RLMMigration_Private.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMMigration_Private.h
\ No newline at end of file
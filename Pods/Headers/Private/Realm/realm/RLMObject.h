@@ -1 +1 @@
-../../../../Realm/include/realm/RLMObject.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMObject.h
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/RLMObjectBase.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMObjectBase.h
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/RLMObjectSchema.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMObjectSchema.h
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/RLMObjectSchema_Private.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMObjectSchema_Private.h
\ No newline at end of file
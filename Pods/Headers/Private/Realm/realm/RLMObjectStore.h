@@ -1 +1 @@
-../../../../Realm/include/realm/RLMObjectStore.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMObjectStore.h
\ No newline at end of file
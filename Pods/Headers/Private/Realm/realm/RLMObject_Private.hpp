@@ -1 +1 @@
-../../../../Realm/include/realm/RLMObject_Private.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMObject_Private.hpp
\ No newline at end of file
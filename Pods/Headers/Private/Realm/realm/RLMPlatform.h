@@ -1 +1 @@
-../../../../Realm/include/realm/RLMPlatform.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMPlatform.h
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/RLMProperty.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMProperty.h
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/RLMProperty_Private.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMProperty_Private.h
\ No newline at end of file
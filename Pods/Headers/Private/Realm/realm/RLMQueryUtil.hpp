@@ -1 +1 @@
-../../../../Realm/include/realm/RLMQueryUtil.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMQueryUtil.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/RLMRealmUtil.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMRealmUtil.h
\ No newline at end of file
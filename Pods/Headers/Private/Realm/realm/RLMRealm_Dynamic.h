@@ -1 +1 @@
-../../../../Realm/include/realm/RLMRealm_Dynamic.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMRealm_Dynamic.h
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/RLMRealm_Private.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMRealm_Private.h
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/RLMResults.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMResults.h
\ No newline at end of file
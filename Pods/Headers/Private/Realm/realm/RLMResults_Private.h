@@ -1 +1 @@
-../../../../Realm/include/realm/RLMResults_Private.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMResults_Private.h
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/RLMSchema.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMSchema.h
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/RLMSwiftBridgingHeader.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMSwiftBridgingHeader.h
\ No newline at end of file
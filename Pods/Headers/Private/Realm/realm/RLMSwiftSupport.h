@@ -1 +1 @@
-../../../../Realm/include/realm/RLMSwiftSupport.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMSwiftSupport.h
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/RLMUpdateChecker.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMUpdateChecker.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/RLMUtil.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/RLMUtil.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/Realm.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/Realm.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/aggregate_sketch.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/alloc.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/alloc.hpp
\ No newline at end of file
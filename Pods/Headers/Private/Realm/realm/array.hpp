@@ -1 +1 @@
-../../../../Realm/include/realm/array.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/array.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/array_integer.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/array_integer.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/array_string.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/array_string.hpp
\ No newline at end of file
@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/async_query_executor.hpp
\ No newline at end of file
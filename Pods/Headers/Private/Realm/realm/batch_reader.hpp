@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/batch_reader.hpp
\ No newline at end of file
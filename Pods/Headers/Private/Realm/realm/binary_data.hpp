@@ -1 +1 @@
-../../../../Realm/include/realm/binary_data.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/binary_data.hpp
\ No newline at end of file
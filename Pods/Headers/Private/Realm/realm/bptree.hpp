@@ -1 +1 @@
-../../../../Realm/include/realm/bptree.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/bptree.hpp
\ No newline at end of file
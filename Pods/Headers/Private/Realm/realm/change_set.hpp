@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/change_set.hpp
\ No newline at end of file
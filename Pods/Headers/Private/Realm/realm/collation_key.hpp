@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/collation_key.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/column.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/column.hpp
\ No newline at end of file
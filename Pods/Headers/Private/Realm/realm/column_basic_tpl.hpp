@@ -1 +1 @@
-../../../../Realm/include/realm/column_basic_tpl.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/column_basic_tpl.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/column_linklist.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/column_linklist.hpp
\ No newline at end of file
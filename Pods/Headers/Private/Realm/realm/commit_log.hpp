@@ -1 +1 @@
-../../../../Realm/include/realm/commit_log.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/commit_log.hpp
\ No newline at end of file
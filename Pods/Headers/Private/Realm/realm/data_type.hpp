@@ -1 +1 @@
-../../../../Realm/include/realm/data_type.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/data_type.hpp
\ No newline at end of file
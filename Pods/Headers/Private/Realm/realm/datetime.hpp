@@ -1 +1 @@
-../../../../Realm/include/realm/datetime.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/datetime.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/descriptor.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/descriptor.hpp
\ No newline at end of file
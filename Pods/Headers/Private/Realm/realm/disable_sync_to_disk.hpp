@@ -1 +1 @@
-../../../../Realm/include/realm/disable_sync_to_disk.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/disable_sync_to_disk.hpp
\ No newline at end of file
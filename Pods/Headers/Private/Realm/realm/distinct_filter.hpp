@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/distinct_filter.hpp
\ No newline at end of file
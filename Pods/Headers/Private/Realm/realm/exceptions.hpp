@@ -1 +1 @@
-../../../../Realm/include/realm/exceptions.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/exceptions.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/group.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/group.hpp
\ No newline at end of file
@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/group_by.hpp
\ No newline at end of file
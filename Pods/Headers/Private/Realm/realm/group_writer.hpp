@@ -1 +1 @@
-../../../../Realm/include/realm/group_writer.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/group_writer.hpp
\ No newline at end of file
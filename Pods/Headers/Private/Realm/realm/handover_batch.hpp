@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/handover_batch.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/handover_defs.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/handover_defs.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/history.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/history.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../../Realm/include/realm/impl/array_writer.hpp
\ No newline at end of file
+../../../../../../Vendor/Realm/include/realm/impl/array_writer.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../../Realm/include/realm/impl/destroy_guard.hpp
\ No newline at end of file
+../../../../../../Vendor/Realm/include/realm/impl/destroy_guard.hpp
\ No newline at end of file
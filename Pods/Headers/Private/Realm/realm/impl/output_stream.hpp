@@ -1 +1 @@
-../../../../../Realm/include/realm/impl/output_stream.hpp
\ No newline at end of file
+../../../../../../Vendor/Realm/include/realm/impl/output_stream.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../../Realm/include/realm/impl/simulated_failure.hpp
\ No newline at end of file
+../../../../../../Vendor/Realm/include/realm/impl/simulated_failure.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../../Realm/include/realm/impl/transact_log.hpp
\ No newline at end of file
+../../../../../../Vendor/Realm/include/realm/impl/transact_log.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/importer.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/importer.hpp
\ No newline at end of file
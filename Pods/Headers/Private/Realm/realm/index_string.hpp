@@ -1 +1 @@
-../../../../Realm/include/realm/index_string.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/index_string.hpp
\ No newline at end of file
@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/index_string_fold.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/lang_bind_helper.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/lang_bind_helper.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/link_view.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/link_view.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/link_view_fwd.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/link_view_fwd.hpp
\ No newline at end of file
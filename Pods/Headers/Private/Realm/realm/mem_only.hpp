@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/mem_only.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/mixed.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/mixed.hpp
\ No newline at end of file
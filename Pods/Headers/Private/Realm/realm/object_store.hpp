@@ -1 +1 @@
-../../../../Realm/include/realm/object_store.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/object_store.hpp
\ No newline at end of file
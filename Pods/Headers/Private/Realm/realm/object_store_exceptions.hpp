@@ -1 +1 @@
-../../../../Realm/include/realm/object_store_exceptions.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/object_store_exceptions.hpp
\ No newline at end of file
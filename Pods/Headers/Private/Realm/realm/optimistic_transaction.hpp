@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/optimistic_transaction.hpp
\ No newline at end of file
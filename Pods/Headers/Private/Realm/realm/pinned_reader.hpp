@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/pinned_reader.hpp
\ No newline at end of file
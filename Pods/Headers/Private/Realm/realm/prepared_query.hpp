@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/prepared_query.hpp
\ No newline at end of file
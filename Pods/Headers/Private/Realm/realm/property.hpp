@@ -1 +1 @@
-../../../../Realm/include/realm/property.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/property.hpp
\ No newline at end of file
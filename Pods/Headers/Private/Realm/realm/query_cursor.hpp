@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/query_cursor.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/query_engine.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/query_engine.hpp
\ No newline at end of file
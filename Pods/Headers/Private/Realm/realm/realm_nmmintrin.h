@@ -1 +1 @@
-../../../../Realm/include/realm/realm_nmmintrin.h
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/realm_nmmintrin.h
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/replication.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/replication.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/row.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/row.hpp
\ No newline at end of file
@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/row_index_set.hpp
\ No newline at end of file
@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/row_tracker.hpp
\ No newline at end of file
@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/snapshot_monitor.hpp
\ No newline at end of file
@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/sort_engine.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/spec.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/spec.hpp
\ No newline at end of file
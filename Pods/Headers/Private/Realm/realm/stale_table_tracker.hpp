@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/stale_table_tracker.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/string_data.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/string_data.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/table.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/table.hpp
\ No newline at end of file
@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/table_change_waiter.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/table_ref.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/table_ref.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/table_view_basic.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/table_view_basic.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/unicode.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/unicode.hpp
\ No newline at end of file
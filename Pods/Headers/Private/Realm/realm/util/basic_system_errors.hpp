@@ -1 +1 @@
-../../../../../Realm/include/realm/util/basic_system_errors.hpp
\ No newline at end of file
+../../../../../../Vendor/Realm/include/realm/util/basic_system_errors.hpp
\ No newline at end of file
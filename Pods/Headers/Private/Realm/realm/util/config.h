@@ -1 +1 @@
-../../../../../Realm/include/realm/util/config.h
\ No newline at end of file
+../../../../../../Vendor/Realm/include/realm/util/config.h
\ No newline at end of file
@@ -1 +1 @@
-../../../../../Realm/include/realm/util/features.h
\ No newline at end of file
+../../../../../../Vendor/Realm/include/realm/util/features.h
\ No newline at end of file
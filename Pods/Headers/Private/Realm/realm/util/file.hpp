@@ -1 +1 @@
-../../../../../Realm/include/realm/util/file.hpp
\ No newline at end of file
+../../../../../../Vendor/Realm/include/realm/util/file.hpp
\ No newline at end of file
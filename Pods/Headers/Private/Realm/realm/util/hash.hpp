@@ -0,0 +1 @@
+../../../../../../Vendor/Realm/include/realm/util/hash.hpp
\ No newline at end of file
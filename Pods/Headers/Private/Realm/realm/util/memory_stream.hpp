@@ -1 +1 @@
-../../../../../Realm/include/realm/util/memory_stream.hpp
\ No newline at end of file
+../../../../../../Vendor/Realm/include/realm/util/memory_stream.hpp
\ No newline at end of file
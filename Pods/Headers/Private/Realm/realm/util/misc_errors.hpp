@@ -1 +1 @@
-../../../../../Realm/include/realm/util/misc_errors.hpp
\ No newline at end of file
+../../../../../../Vendor/Realm/include/realm/util/misc_errors.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../../Realm/include/realm/util/platform_specific_condvar.hpp
\ No newline at end of file
+../../../../../../Vendor/Realm/include/realm/util/platform_specific_condvar.hpp
\ No newline at end of file
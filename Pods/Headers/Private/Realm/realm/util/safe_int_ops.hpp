@@ -1 +1 @@
-../../../../../Realm/include/realm/util/safe_int_ops.hpp
\ No newline at end of file
+../../../../../../Vendor/Realm/include/realm/util/safe_int_ops.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../../Realm/include/realm/util/shared_ptr.hpp
\ No newline at end of file
+../../../../../../Vendor/Realm/include/realm/util/shared_ptr.hpp
\ No newline at end of file
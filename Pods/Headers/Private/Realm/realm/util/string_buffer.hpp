@@ -1 +1 @@
-../../../../../Realm/include/realm/util/string_buffer.hpp
\ No newline at end of file
+../../../../../../Vendor/Realm/include/realm/util/string_buffer.hpp
\ No newline at end of file
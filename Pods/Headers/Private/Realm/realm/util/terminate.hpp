@@ -1 +1 @@
-../../../../../Realm/include/realm/util/terminate.hpp
\ No newline at end of file
+../../../../../../Vendor/Realm/include/realm/util/terminate.hpp
\ No newline at end of file
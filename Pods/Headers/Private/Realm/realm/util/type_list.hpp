@@ -1 +1 @@
-../../../../../Realm/include/realm/util/type_list.hpp
\ No newline at end of file
+../../../../../../Vendor/Realm/include/realm/util/type_list.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../../Realm/include/realm/util/type_traits.hpp
\ No newline at end of file
+../../../../../../Vendor/Realm/include/realm/util/type_traits.hpp
\ No newline at end of file
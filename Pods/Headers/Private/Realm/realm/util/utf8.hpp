@@ -1 +1 @@
-../../../../../Realm/include/realm/util/utf8.hpp
\ No newline at end of file
+../../../../../../Vendor/Realm/include/realm/util/utf8.hpp
\ No newline at end of file
@@ -1 +1 @@
-../../../../Realm/include/realm/utilities.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/utilities.hpp
\ No newline at end of file
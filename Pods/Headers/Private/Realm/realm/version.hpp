@@ -1 +1 @@
-../../../../Realm/include/realm/version.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/version.hpp
\ No newline at end of file
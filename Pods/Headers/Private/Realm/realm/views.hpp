@@ -1 +1 @@
-../../../../Realm/include/realm/views.hpp
\ No newline at end of file
+../../../../../Vendor/Realm/include/realm/views.hpp
\ No newline at end of file
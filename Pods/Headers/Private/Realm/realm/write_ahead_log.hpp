@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/write_ahead_log.hpp
\ No newline at end of file
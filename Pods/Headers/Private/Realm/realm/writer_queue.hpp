@@ -0,0 +1 @@
+../../../../../Vendor/Realm/include/realm/writer_queue.hpp
\ No newline at end of file
@@ -32,6 +32,7 @@
 
 #import "object_store.hpp"
 #import <objc/message.h>
+#import <map>
 
 using namespace realm;
 
@@ -526,6 +527,38 @@ void RLMDeleteObjectFromRealm(__unsafe_unretained RLMObjectBase *const object,
     object->_realm = nil;
 }
 
+void RLMDeleteObjectsFromRealm(id<NSFastEnumeration> objects, RLMRealm *realm) {
+    RLMVerifyInWriteTransaction(realm);
+
+    // collect the rows of each table, so that each table is purged in one batch,
+    // and the accessors, as enumerating the objects again after the rows are
+    // removed may yield different objects (e.g. for RLMResults)
+    std::map<realm::Table *, std::vector<size_t>> rows;
+    NSMutableArray *accessors = [NSMutableArray new];
+    for (id obj in objects) {
+        if (![obj isKindOfClass:RLMObjectBase.class]) {
+            continue;
+        }
+        RLMObjectBase *object = obj;
+        if (realm != object->_realm) {
+            @throw RLMException(@"Can only delete an object from the Realm it belongs to.");
+        }
+        if (object->_row.is_attached()) {
+            rows[object->_row.get_table()].push_back(object->_row.get_index());
+        }
+        [accessors addObject:object];
+    }
+
+    for (auto &tableRows : rows) {
+        tableRows.first->move_last_over_rows(tableRows.second);
+    }
+
+    // set realm to nil
+    for (RLMObjectBase *object in accessors) {
+        object->_realm = nil;
+    }
+}
+
 void RLMDeleteAllObjectsFromRealm(RLMRealm *realm) {
     RLMVerifyInWriteTransaction(realm);
 
@@ -775,11 +775,7 @@ static void CheckReadWrite(RLMRealm *realm, NSString *msg=@"Cannot write to a re
         [array deleteObjectsFromRealm];
     }
     else if ([array conformsToProtocol:@protocol(NSFastEnumeration)]) {
-        for (id obj in array) {
-            if ([obj isKindOfClass:RLMObjectBase.class]) {
-                RLMDeleteObjectFromRealm(obj, self);
-            }
-        }
+        RLMDeleteObjectsFromRealm(array, self);
     }
     else {
         @throw RLMException(@"Invalid array type - container must be an RLMArray, RLMArray, or NSArray of RLMObjects");
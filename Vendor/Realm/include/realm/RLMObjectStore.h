@@ -75,6 +75,9 @@ void RLMAddObjectToRealm(RLMObjectBase *object, RLMRealm *realm, bool createOrUp
 // delete an object from its realm
 void RLMDeleteObjectFromRealm(RLMObjectBase *object, RLMRealm *realm);
 
+// delete a collection of objects from their realm, one batch per table
+void RLMDeleteObjectsFromRealm(id<NSFastEnumeration> objects, RLMRealm *realm);
+
 // deletes all objects from a realm
 void RLMDeleteAllObjectsFromRealm(RLMRealm *realm);
 
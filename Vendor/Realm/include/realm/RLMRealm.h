@@ -474,6 +474,8 @@ typedef void(^RLMNotificationBlock)(NSString *notification, RLMRealm *realm);
 /**
  Delete an `NSArray`, `RLMArray`, or `RLMResults` of objects from this Realm.
 
+ An object that is listed more than once is deleted once.
+
  @param array  `RLMArray`, `NSArray`, or `RLMResults` of `RLMObject`s to be deleted.
  */
 - (void)deleteObjects:(id)array;
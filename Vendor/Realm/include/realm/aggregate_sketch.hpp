@@ -0,0 +1,662 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_AGGREGATE_SKETCH_HPP
+#define REALM_AGGREGATE_SKETCH_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <realm/util/hash.hpp>
+#include <realm/exceptions.hpp>
+#include <realm/table.hpp>
+#include <realm/table_view.hpp>
+#include <realm/query.hpp>
+
+namespace realm {
+
+/// Running mean and variance (Welford's method). Numerically stable, and two
+/// accumulators over disjoint inputs can be merged.
+class VarianceAccumulator {
+public:
+    VarianceAccumulator() REALM_NOEXCEPT: m_count(0), m_mean(0), m_m2(0) {}
+
+    void add(double value) REALM_NOEXCEPT;
+    void merge(const VarianceAccumulator&) REALM_NOEXCEPT;
+
+    std::size_t count() const REALM_NOEXCEPT { return m_count; }
+    double mean() const REALM_NOEXCEPT { return m_mean; }
+
+    /// Sample variance (divides by count - 1), as SQL VARIANCE(). Returns 0
+    /// for fewer than two values.
+    double variance() const REALM_NOEXCEPT;
+    double stddev() const REALM_NOEXCEPT { return std::sqrt(variance()); }
+
+private:
+    std::size_t m_count;
+    double m_mean;
+    double m_m2; // Sum of squared distances from the mean
+};
+
+
+/// Approximate quantiles in bounded memory (merging t-digest).
+///
+/// Values are buffered and periodically merged into a sorted list of
+/// centroids (mean, weight). The size of a centroid is limited by the scale
+/// function k(q) = compression / 2pi * asin(2q - 1), which keeps centroids
+/// near the tails small, so extreme quantiles such as p99 and p999 stay
+/// accurate while the digest holds at most about \a compression centroids.
+/// The exact minimum and maximum are tracked separately.
+class QuantileDigest {
+public:
+    explicit QuantileDigest(double compression = 100);
+
+    void add(double value);
+    void merge(const QuantileDigest&);
+
+    std::size_t count() const REALM_NOEXCEPT { return m_count; }
+
+    /// The value below which a fraction \a q (0...1) of the values fall,
+    /// interpolated between centroids. Returns 0 if no values were added.
+    double quantile(double q) const;
+
+private:
+    struct Centroid {
+        double mean;
+        double weight;
+        bool operator<(const Centroid& c) const REALM_NOEXCEPT { return mean < c.mean; }
+    };
+
+    double m_compression;
+    std::size_t m_count;
+    double m_min, m_max;
+    mutable std::vector<Centroid> m_centroids;
+    mutable std::vector<double> m_buffer;
+
+    double scale(double q) const REALM_NOEXCEPT;
+    double inverse_scale(double k) const REALM_NOEXCEPT;
+    void flush() const;
+};
+
+
+/// Exact quantiles. Keeps every value, so memory grows with the input.
+/// Quantiles interpolate linearly between the two closest ranks.
+class ExactQuantiles {
+public:
+    void add(double value) { m_values.push_back(value); m_is_sorted = false; }
+    std::size_t count() const REALM_NOEXCEPT { return m_values.size(); }
+    double quantile(double q) const;
+
+private:
+    mutable std::vector<double> m_values;
+    mutable bool m_is_sorted = true;
+};
+
+
+/// Approximate count of distinct values (HyperLogLog).
+///
+/// Uses 2^precision one byte registers. The relative standard error is
+/// about 1.04 / sqrt(2^precision), which is 0.8% for the default precision
+/// of 14 (16KiB). Uses 64-bit hashes, so no large range correction is
+/// needed.
+class HyperLogLog {
+public:
+    explicit HyperLogLog(unsigned precision = 14);
+
+    void add(int64_t value) REALM_NOEXCEPT { add_hash(util::hash_mix(uint64_t(value))); }
+    void add(double value) REALM_NOEXCEPT;
+    void add(StringData value) REALM_NOEXCEPT;
+
+    /// Add a value that is already reduced to a well mixed 64-bit hash.
+    void add_hash(uint64_t hash) REALM_NOEXCEPT;
+
+    /// Both must have the same precision.
+    void merge(const HyperLogLog&) REALM_NOEXCEPT;
+
+    double estimate() const REALM_NOEXCEPT;
+
+private:
+    unsigned m_precision;
+    std::vector<unsigned char> m_registers;
+};
+
+
+/// One pass statistics over a numeric column (Int, Bool, Float, Double or
+/// DateTime) of a table view or query result, complementing sum(),
+/// average(), minimum() and maximum(). Null values and detached rows are
+/// skipped. DateTime values are taken as seconds, and Bool values as 0 or
+/// 1. Other column types are rejected with LogicError::type_mismatch.
+///
+/// Quantiles and distinct counts can be computed exactly, at the cost of
+/// memory proportional to the number of values, or approximately with the
+/// sketches above in bounded memory.
+class Statistics {
+public:
+    enum Mode {
+        mode_exact,
+        mode_approximate
+    };
+
+    static double variance(const TableViewBase&, std::size_t column_ndx, std::size_t* resultcount = nullptr);
+    static double stddev(const TableViewBase&, std::size_t column_ndx, std::size_t* resultcount = nullptr);
+
+    static double quantile(const TableViewBase&, std::size_t column_ndx, double q,
+                           Mode = mode_approximate, std::size_t* resultcount = nullptr);
+    static double median(const TableViewBase& view, std::size_t column_ndx, Mode mode = mode_approximate)
+    {
+        return quantile(view, column_ndx, 0.5, mode);
+    }
+
+    /// Several quantiles, such as p50, p95 and p99, in one pass.
+    static std::vector<double> quantiles(const TableViewBase&, std::size_t column_ndx,
+                                         const std::vector<double>& q, Mode = mode_approximate);
+
+    /// Number of distinct non-null values. String columns are supported as
+    /// well. Int, Bool and DateTime values are compared as integers, so
+    /// distinct values beyond the precision of a double are not merged.
+    /// Floating point values are compared by value, except that all NaNs
+    /// count as one value.
+    static std::size_t count_distinct(const TableViewBase&, std::size_t column_ndx,
+                                      Mode = mode_approximate);
+
+    static double variance(Query& query, std::size_t column_ndx, std::size_t* resultcount = nullptr);
+    static double stddev(Query& query, std::size_t column_ndx, std::size_t* resultcount = nullptr);
+    static double quantile(Query& query, std::size_t column_ndx, double q,
+                           Mode = mode_approximate, std::size_t* resultcount = nullptr);
+    static std::vector<double> quantiles(Query& query, std::size_t column_ndx,
+                                         const std::vector<double>& q, Mode = mode_approximate);
+    static std::size_t count_distinct(Query& query, std::size_t column_ndx, Mode = mode_approximate);
+
+private:
+    /// Call \a handler with each non-null value of the column, as a double.
+    template<class F> static void for_each_number(const TableViewBase&, std::size_t column_ndx, F handler);
+
+    /// Call \a handler with each non-null value of an Int, Bool or DateTime
+    /// column, as an integer.
+    template<class F> static void for_each_integer(const TableViewBase&, std::size_t column_ndx, F handler);
+
+    static void check_column_type(const Table&, std::size_t column_ndx);
+
+    /// Bit pattern identifying the value of \a value, the same for 0.0 and
+    /// -0.0 and for all NaNs.
+    static uint64_t canonical_bits(double value) REALM_NOEXCEPT;
+};
+
+
+
+
+// Implementation:
+
+inline void VarianceAccumulator::add(double value) REALM_NOEXCEPT
+{
+    ++m_count;
+    double delta = value - m_mean;
+    m_mean += delta / m_count;
+    m_m2 += delta * (value - m_mean);
+}
+
+inline void VarianceAccumulator::merge(const VarianceAccumulator& other) REALM_NOEXCEPT
+{
+    if (other.m_count == 0)
+        return;
+    std::size_t count = m_count + other.m_count;
+    double delta = other.m_mean - m_mean;
+    m_m2 += other.m_m2 + delta * delta * (double(m_count) * other.m_count / count);
+    m_mean += delta * other.m_count / count;
+    m_count = count;
+}
+
+inline double VarianceAccumulator::variance() const REALM_NOEXCEPT
+{
+    return m_count < 2 ? 0 : m_m2 / (m_count - 1);
+}
+
+
+inline QuantileDigest::QuantileDigest(double compression):
+    m_compression(compression),
+    m_count(0),
+    m_min(0),
+    m_max(0)
+{
+    REALM_ASSERT_3(compression, >=, 10);
+}
+
+inline double QuantileDigest::scale(double q) const REALM_NOEXCEPT
+{
+    const double pi = 3.14159265358979323846;
+    return m_compression / (2 * pi) * std::asin(2 * q - 1);
+}
+
+inline double QuantileDigest::inverse_scale(double k) const REALM_NOEXCEPT
+{
+    const double pi = 3.14159265358979323846;
+    if (k >= m_compression / 4)
+        return 1;
+    return (std::sin(k * 2 * pi / m_compression) + 1) / 2;
+}
+
+inline void QuantileDigest::add(double value)
+{
+    if (m_count == 0 || value < m_min)
+        m_min = value;
+    if (m_count == 0 || value > m_max)
+        m_max = value;
+    ++m_count;
+    m_buffer.push_back(value); // Throws
+    if (m_buffer.size() >= std::size_t(m_compression * 5))
+        flush(); // Throws
+}
+
+inline void QuantileDigest::merge(const QuantileDigest& other)
+{
+    if (other.m_count == 0)
+        return;
+    other.flush(); // Throws
+    if (m_count == 0 || other.m_min < m_min)
+        m_min = other.m_min;
+    if (m_count == 0 || other.m_max > m_max)
+        m_max = other.m_max;
+    m_count += other.m_count;
+    m_centroids.insert(m_centroids.end(), other.m_centroids.begin(), other.m_centroids.end()); // Throws
+    flush(); // Throws
+}
+
+inline void QuantileDigest::flush() const
+{
+    std::vector<Centroid> all;
+    all.reserve(m_centroids.size() + m_buffer.size()); // Throws
+    all.insert(all.end(), m_centroids.begin(), m_centroids.end());
+    for (double v: m_buffer) {
+        Centroid c = { v, 1 };
+        all.push_back(c);
+    }
+    m_buffer.clear();
+    if (all.empty())
+        return;
+    std::sort(all.begin(), all.end());
+
+    // Greedily merge neighbours while the merged centroid spans at most one
+    // unit of k
+    double total = double(m_count);
+    std::vector<Centroid> merged;
+    Centroid current = all[0];
+    double weight_before = 0;
+    double q_limit = inverse_scale(scale(0) + 1);
+    for (std::size_t i = 1; i < all.size(); ++i) {
+        const Centroid& c = all[i];
+        double q = (weight_before + current.weight + c.weight) / total;
+        if (q <= q_limit) {
+            current.weight += c.weight;
+            current.mean += (c.mean - current.mean) * c.weight / current.weight;
+        }
+        else {
+            weight_before += current.weight;
+            merged.push_back(current); // Throws
+            q_limit = inverse_scale(scale(weight_before / total) + 1);
+            current = c;
+        }
+    }
+    merged.push_back(current); // Throws
+    m_centroids.swap(merged);
+}
+
+inline double QuantileDigest::quantile(double q) const
+{
+    if (m_count == 0)
+        return 0;
+    flush(); // Throws
+    q = std::min(std::max(q, 0.0), 1.0);
+    double index = q * m_count;
+    if (index < 1)
+        return m_min;
+    if (index > m_count - 1)
+        return m_max;
+
+    // Each centroid is taken to be centered at the middle of its weight.
+    // Interpolate between neighbouring centers, and between the outer
+    // centers and the exact extremes.
+    double prev_center = 0;
+    double prev_mean = m_min;
+    double weight_before = 0;
+    for (const Centroid& c: m_centroids) {
+        double center = weight_before + c.weight / 2;
+        if (index < center) {
+            double t = (index - prev_center) / (center - prev_center);
+            return prev_mean + t * (c.mean - prev_mean);
+        }
+        prev_center = center;
+        prev_mean = c.mean;
+        weight_before += c.weight;
+    }
+    double t = (index - prev_center) / (m_count - prev_center);
+    return prev_mean + t * (m_max - prev_mean);
+}
+
+
+inline double ExactQuantiles::quantile(double q) const
+{
+    if (m_values.empty())
+        return 0;
+    if (!m_is_sorted) {
+        std::sort(m_values.begin(), m_values.end());
+        m_is_sorted = true;
+    }
+    q = std::min(std::max(q, 0.0), 1.0);
+    double pos = q * (m_values.size() - 1);
+    std::size_t lower = std::size_t(pos);
+    if (lower + 1 >= m_values.size())
+        return m_values.back();
+    return m_values[lower] + (pos - lower) * (m_values[lower + 1] - m_values[lower]);
+}
+
+
+inline HyperLogLog::HyperLogLog(unsigned precision):
+    m_precision(precision),
+    m_registers(std::size_t(1) << precision) // Throws
+{
+    REALM_ASSERT(precision >= 4 && precision <= 18);
+}
+
+inline void HyperLogLog::add(double value) REALM_NOEXCEPT
+{
+    // Same hash for 0.0 and -0.0, and for all NaNs
+    uint64_t bits = 0;
+    if (std::isnan(value)) {
+        bits = 0x7FF8000000000000ULL;
+    }
+    else if (value != 0) {
+        std::memcpy(&bits, &value, sizeof bits);
+    }
+    add_hash(util::hash_mix(bits));
+}
+
+inline void HyperLogLog::add(StringData value) REALM_NOEXCEPT
+{
+    add_hash(util::hash_mix(util::hash_bytes(value.data(), value.size())));
+}
+
+inline void HyperLogLog::add_hash(uint64_t hash) REALM_NOEXCEPT
+{
+    // The top bits select the register, the position of the first one bit
+    // in the rest is the rank. The guard bit bounds the rank.
+    std::size_t ndx = std::size_t(hash >> (64 - m_precision));
+    uint64_t rest = (hash << m_precision) | (uint64_t(1) << (m_precision - 1));
+    unsigned char rank = 1;
+    while (!(rest & (uint64_t(1) << 63))) {
+        rest <<= 1;
+        ++rank;
+    }
+    if (rank > m_registers[ndx])
+        m_registers[ndx] = rank;
+}
+
+inline void HyperLogLog::merge(const HyperLogLog& other) REALM_NOEXCEPT
+{
+    REALM_ASSERT_3(m_precision, ==, other.m_precision);
+    for (std::size_t i = 0; i < m_registers.size(); ++i)
+        m_registers[i] = std::max(m_registers[i], other.m_registers[i]);
+}
+
+inline double HyperLogLog::estimate() const REALM_NOEXCEPT
+{
+    double m = double(m_registers.size());
+    double sum = 0;
+    std::size_t num_zeros = 0;
+    for (unsigned char r: m_registers) {
+        sum += std::ldexp(1.0, -int(r));
+        if (r == 0)
+            ++num_zeros;
+    }
+    double alpha = 0.7213 / (1 + 1.079 / m);
+    double e = alpha * m * m / sum;
+    // Small range correction (linear counting)
+    if (e <= 2.5 * m && num_zeros != 0)
+        e = m * std::log(m / num_zeros);
+    return e;
+}
+
+
+inline void Statistics::check_column_type(const Table& table, std::size_t column_ndx)
+{
+    switch (table.get_column_type(column_ndx)) {
+        case type_Int:
+        case type_Bool:
+        case type_Float:
+        case type_Double:
+        case type_DateTime:
+            return;
+        default:
+            throw LogicError(LogicError::type_mismatch);
+    }
+}
+
+inline uint64_t Statistics::canonical_bits(double value) REALM_NOEXCEPT
+{
+    if (value == 0)
+        return 0;
+    if (std::isnan(value))
+        return 0x7FF8000000000000ULL;
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof bits);
+    return bits;
+}
+
+template<class F>
+void Statistics::for_each_integer(const TableViewBase& view, std::size_t column_ndx, F handler)
+{
+    const Table& table = *view.m_table;
+    DataType type = table.get_column_type(column_ndx);
+    bool is_nullable = table.is_nullable(column_ndx);
+    std::size_t n = view.size();
+    for (std::size_t i = 0; i < n; ++i) {
+        std::size_t row_ndx = view.get_source_ndx(i);
+        if (row_ndx == detached_ref || (is_nullable && table.is_null(column_ndx, row_ndx)))
+            continue;
+        switch (type) {
+            case type_Int:
+                handler(table.get_int(column_ndx, row_ndx));
+                break;
+            case type_Bool:
+                handler(int64_t(table.get_bool(column_ndx, row_ndx)));
+                break;
+            case type_DateTime:
+                handler(int64_t(table.get_datetime(column_ndx, row_ndx).get_datetime()));
+                break;
+            default:
+                REALM_ASSERT(false);
+                return;
+        }
+    }
+}
+
+template<class F>
+void Statistics::for_each_number(const TableViewBase& view, std::size_t column_ndx, F handler)
+{
+    const Table& table = *view.m_table;
+    check_column_type(table, column_ndx); // Throws
+    DataType type = table.get_column_type(column_ndx);
+    bool is_nullable = table.is_nullable(column_ndx);
+    std::size_t n = view.size();
+    for (std::size_t i = 0; i < n; ++i) {
+        std::size_t row_ndx = view.get_source_ndx(i);
+        if (row_ndx == detached_ref || (is_nullable && table.is_null(column_ndx, row_ndx)))
+            continue;
+        switch (type) {
+            case type_Int:
+                handler(double(table.get_int(column_ndx, row_ndx)));
+                break;
+            case type_Bool:
+                handler(table.get_bool(column_ndx, row_ndx) ? 1.0 : 0.0);
+                break;
+            case type_Float:
+                handler(double(table.get_float(column_ndx, row_ndx)));
+                break;
+            case type_Double:
+                handler(table.get_double(column_ndx, row_ndx));
+                break;
+            case type_DateTime:
+                handler(double(table.get_datetime(column_ndx, row_ndx).get_datetime()));
+                break;
+            default:
+                REALM_ASSERT(false);
+                return;
+        }
+    }
+}
+
+inline double Statistics::variance(const TableViewBase& view, std::size_t column_ndx, std::size_t* resultcount)
+{
+    VarianceAccumulator acc;
+    for_each_number(view, column_ndx, [&](double v) { acc.add(v); });
+    if (resultcount)
+        *resultcount = acc.count();
+    return acc.variance();
+}
+
+inline double Statistics::stddev(const TableViewBase& view, std::size_t column_ndx, std::size_t* resultcount)
+{
+    return std::sqrt(variance(view, column_ndx, resultcount));
+}
+
+inline std::vector<double> Statistics::quantiles(const TableViewBase& view, std::size_t column_ndx,
+                                                 const std::vector<double>& q, Mode mode)
+{
+    std::vector<double> result;
+    result.reserve(q.size()); // Throws
+    if (mode == mode_exact) {
+        ExactQuantiles values;
+        for_each_number(view, column_ndx, [&](double v) { values.add(v); }); // Throws
+        for (double q_i: q)
+            result.push_back(values.quantile(q_i));
+    }
+    else {
+        QuantileDigest digest;
+        for_each_number(view, column_ndx, [&](double v) { digest.add(v); }); // Throws
+        for (double q_i: q)
+            result.push_back(digest.quantile(q_i)); // Throws
+    }
+    return result;
+}
+
+inline double Statistics::quantile(const TableViewBase& view, std::size_t column_ndx, double q,
+                                   Mode mode, std::size_t* resultcount)
+{
+    if (mode == mode_exact) {
+        ExactQuantiles values;
+        for_each_number(view, column_ndx, [&](double v) { values.add(v); }); // Throws
+        if (resultcount)
+            *resultcount = values.count();
+        return values.quantile(q);
+    }
+    QuantileDigest digest;
+    for_each_number(view, column_ndx, [&](double v) { digest.add(v); }); // Throws
+    if (resultcount)
+        *resultcount = digest.count();
+    return digest.quantile(q); // Throws
+}
+
+inline std::size_t Statistics::count_distinct(const TableViewBase& view, std::size_t column_ndx, Mode mode)
+{
+    const Table& table = *view.m_table;
+    if (table.get_column_type(column_ndx) == type_String) {
+        std::unordered_set<std::string> exact;
+        std::unique_ptr<HyperLogLog> sketch;
+        if (mode == mode_approximate)
+            sketch.reset(new HyperLogLog); // Throws
+        std::size_t n = view.size();
+        for (std::size_t i = 0; i < n; ++i) {
+            std::size_t row_ndx = view.get_source_ndx(i);
+            if (row_ndx == detached_ref)
+                continue;
+            StringData v = table.get_string(column_ndx, row_ndx);
+            if (v.is_null())
+                continue;
+            if (sketch) {
+                sketch->add(v);
+            }
+            else {
+                exact.insert(std::string(v.data(), v.size())); // Throws
+            }
+        }
+        return sketch ? std::size_t(std::round(sketch->estimate())) : exact.size();
+    }
+
+    check_column_type(table, column_ndx); // Throws
+    DataType type = table.get_column_type(column_ndx);
+    bool is_integer = type == type_Int || type == type_Bool || type == type_DateTime;
+    if (mode == mode_exact) {
+        if (is_integer) {
+            std::unordered_set<int64_t> exact;
+            for_each_integer(view, column_ndx, [&](int64_t v) { exact.insert(v); }); // Throws
+            return exact.size();
+        }
+        std::unordered_set<uint64_t> exact;
+        for_each_number(view, column_ndx, [&](double v) { exact.insert(canonical_bits(v)); }); // Throws
+        return exact.size();
+    }
+    HyperLogLog sketch; // Throws
+    if (is_integer) {
+        for_each_integer(view, column_ndx, [&](int64_t v) { sketch.add(v); });
+    }
+    else {
+        for_each_number(view, column_ndx, [&](double v) { sketch.add(v); });
+    }
+    return std::size_t(std::round(sketch.estimate()));
+}
+
+inline double Statistics::variance(Query& query, std::size_t column_ndx, std::size_t* resultcount)
+{
+    TableView view = query.find_all(); // Throws
+    return variance(view, column_ndx, resultcount);
+}
+
+inline double Statistics::stddev(Query& query, std::size_t column_ndx, std::size_t* resultcount)
+{
+    TableView view = query.find_all(); // Throws
+    return stddev(view, column_ndx, resultcount);
+}
+
+inline double Statistics::quantile(Query& query, std::size_t column_ndx, double q, Mode mode,
+                                   std::size_t* resultcount)
+{
+    TableView view = query.find_all(); // Throws
+    return quantile(view, column_ndx, q, mode, resultcount); // Throws
+}
+
+inline std::vector<double> Statistics::quantiles(Query& query, std::size_t column_ndx,
+                                                 const std::vector<double>& q, Mode mode)
+{
+    TableView view = query.find_all(); // Throws
+    return quantiles(view, column_ndx, q, mode); // Throws
+}
+
+inline std::size_t Statistics::count_distinct(Query& query, std::size_t column_ndx, Mode mode)
+{
+    TableView view = query.find_all(); // Throws
+    return count_distinct(view, column_ndx, mode); // Throws
+}
+
+} // namespace realm
+
+#endif // REALM_AGGREGATE_SKETCH_HPP
@@ -0,0 +1,587 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_ASYNC_QUERY_EXECUTOR_HPP
+#define REALM_ASYNC_QUERY_EXECUTOR_HPP
+
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <realm/util/bind_ptr.hpp>
+#include <realm/util/thread.hpp>
+#include <realm/group_shared.hpp>
+#include <realm/lang_bind_helper.hpp>
+#include <realm/commit_log.hpp>
+#include <realm/query.hpp>
+#include <realm/table_view.hpp>
+#include <realm/handover_batch.hpp>
+
+namespace realm {
+
+/// Runs queries on background threads, and delivers their results as table
+/// views that are ready to be imported by the submitting thread.
+///
+/// The executor owns a pool of worker threads, each with its own read-only
+/// SharedGroup. A query is handed over from the submitting shared group
+/// (without payload), brought to the latest version on a worker, and run
+/// there. The resulting table view is handed back, with payload, in a
+/// HandoverBatch tied to the version it was computed at. The callback is
+/// invoked on the worker thread, and would typically pass the result on to
+/// the submitting thread, which imports it with a single advance:
+///
+///     AsyncQueryExecutor executor(path, 2);
+///     executor.subscribe(sg, query, [&](AsyncQueryExecutor::Result r) {
+///         post_to_ui_thread(std::move(r));
+///     });
+///
+///     // On the UI thread
+///     std::unique_ptr<TableView> tv = r.import(sg, history); // Throws r.error
+///
+/// Each result holds a read transaction on the version it was computed at,
+/// until it is imported or destroyed, so that import() can advance to that
+/// version even after newer versions have been committed. If the importing
+/// shared group has already moved past that version, import() brings the
+/// table view forward to the version of the shared group instead, and reruns
+/// the query there, on the importing thread. Results that will
+/// not be imported should be dropped promptly, since a held version keeps
+/// the space it uses in the file from being reused. Likewise, a submitted
+/// query holds the version it was submitted from until a worker has picked
+/// it up, so the submitting thread does not have to stay in its read
+/// transaction.
+///
+/// Subscribed queries are rerun whenever the workers find a new version,
+/// which they look for when notify() is called, when new queries are
+/// submitted, and every `poll_interval` milliseconds while there are
+/// subscriptions (SharedGroup::has_changed()). Call notify() after
+/// committing, so that the results do not lag behind by up to a poll
+/// interval.
+///
+/// Callbacks must not throw, and must not call back into the executor
+/// synchronously, except for cancel(). Errors are delivered through
+/// Result::error. That includes failure of a worker to advance its own read
+/// transaction, which is reported to every subscribed and newly submitted
+/// query of that worker. Newly submitted queries are then dropped, while
+/// subscribed queries are tried again at the next version.
+class AsyncQueryExecutor {
+public:
+    struct Result {
+        /// The token returned by submit() or subscribe().
+        uint_fast64_t token;
+
+        /// Holds the table view, unless the query failed.
+        HandoverBatch batch;
+        HandoverBatch::Ticket<TableView> ticket;
+
+        /// Set if the query failed.
+        std::exception_ptr error;
+
+        /// Import the table view into the shared group, which must be in a
+        /// read transaction. It is advanced to the version of the result if
+        /// it views an older one. If it views a newer one, the table view is
+        /// brought forward to that version instead. Throws the error of a
+        /// failed query.
+        std::unique_ptr<TableView> import(SharedGroup&, History&);
+    };
+
+    /// How often workers look for new versions while there are subscribed
+    /// queries, in milliseconds.
+    static const int poll_interval = 100;
+
+    typedef std::function<void(Result)> Callback;
+
+    /// Start \a num_workers threads, each with a SharedGroup on the
+    /// specified file. The durability level must match that of the other
+    /// shared groups on the file.
+    AsyncQueryExecutor(const std::string& path, std::size_t num_workers = 1,
+                       SharedGroup::DurabilityLevel = SharedGroup::durability_Full,
+                       const char* encryption_key = 0);
+
+    /// Stops and joins the workers. Pending queries are dropped.
+    ~AsyncQueryExecutor() REALM_NOEXCEPT;
+
+    /// Run a query once, at the latest version. The shared group must be in
+    /// a read transaction, which the query belongs to. Returns a token that
+    /// identifies the query.
+    uint_fast64_t submit(SharedGroup&, const Query&, Callback);
+
+    /// Like submit(), but rerun the query, and invoke the callback again, on
+    /// every new version, until cancelled.
+    uint_fast64_t subscribe(SharedGroup&, const Query&, Callback);
+
+    /// Stop running a query. The callback may still be invoked once, if the
+    /// query is running at the time of the call.
+    void cancel(uint_fast64_t token);
+
+    /// Tell the workers to look for a new version, and rerun the subscribed
+    /// queries if there is one.
+    void notify();
+
+private:
+    struct PinSlot {
+        std::unique_ptr<ClientHistory> history;
+        std::unique_ptr<SharedGroup> shared_group;
+    };
+
+    // Idle shared groups for PinnedVersion. Outlives the executor for as
+    // long as results pin versions.
+    struct PinPool: util::AtomicRefCountBase {
+        std::string path;
+        SharedGroup::DurabilityLevel durability;
+        std::string encryption_key; // Empty if none
+        util::Mutex mutex;
+        std::vector<PinSlot> slots;
+
+        const char* get_encryption_key() const REALM_NOEXCEPT
+        {
+            return encryption_key.empty() ? 0 : encryption_key.data();
+        }
+    };
+
+    // A read transaction on a version, which ends when the last reference
+    // goes away
+    class PinnedVersion: public util::AtomicRefCountBase {
+    public:
+        PinnedVersion(const util::bind_ptr<PinPool>&, SharedGroup::VersionID);
+        ~PinnedVersion() REALM_NOEXCEPT;
+
+        SharedGroup& get_shared_group() REALM_NOEXCEPT { return *m_slot.shared_group; }
+        History& get_history() REALM_NOEXCEPT { return *m_slot.history; }
+        const util::bind_ptr<PinPool>& get_pool() const REALM_NOEXCEPT { return m_pool; }
+
+    private:
+        util::bind_ptr<PinPool> m_pool;
+        PinSlot m_slot;
+    };
+
+    struct ResultPin: HandoverBatch::Pin {
+        util::bind_ptr<PinnedVersion> version;
+    };
+
+    struct Task {
+        uint_fast64_t token;
+        std::unique_ptr<SharedGroup::Handover<Query>> handover;
+        util::bind_ptr<PinnedVersion> source; // Holds the version of the handover
+        Callback callback;
+        bool rerun;
+    };
+
+    struct Subscription {
+        uint_fast64_t token;
+        std::unique_ptr<Query> query;
+        Callback callback;
+    };
+
+    struct Worker {
+        // Owned by the worker thread
+        std::unique_ptr<ClientHistory> history;
+        std::unique_ptr<SharedGroup> shared_group;
+
+        util::bind_ptr<PinPool> pins;
+
+        std::vector<Subscription> subscriptions;
+
+        // Protected by mutex
+        util::Mutex mutex;
+        util::CondVar cond;
+        std::deque<Task> tasks;
+        std::vector<uint_fast64_t> cancelled;
+        bool notified = false;
+        bool stop = false;
+
+        util::Thread thread;
+    };
+
+    util::bind_ptr<PinPool> m_pins;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    util::Mutex m_mutex;
+    uint_fast64_t m_next_token = 0;
+
+    uint_fast64_t add(SharedGroup&, const Query&, Callback, bool rerun);
+    Worker& get_worker(uint_fast64_t token) REALM_NOEXCEPT;
+    void stop() REALM_NOEXCEPT;
+    static void run(Worker&);
+    static void wait(Worker&, util::LockGuard&);
+    static void fail(const Callback&, uint_fast64_t token, std::exception_ptr) REALM_NOEXCEPT;
+    static std::unique_ptr<Query> import_query(Worker&, Task&, SharedGroup::VersionID);
+    static void execute(Worker&, util::bind_ptr<PinnedVersion>&, uint_fast64_t token, Query&,
+                        const Callback&);
+};
+
+
+
+
+// Implementation:
+
+inline AsyncQueryExecutor::AsyncQueryExecutor(const std::string& path, std::size_t num_workers,
+                                              SharedGroup::DurabilityLevel durability,
+                                              const char* encryption_key)
+{
+    REALM_ASSERT(num_workers != 0);
+    m_pins.reset(new PinPool); // Throws
+    m_pins->path = path; // Throws
+    m_pins->durability = durability;
+    if (encryption_key)
+        m_pins->encryption_key.assign(encryption_key, 64); // Throws
+    try {
+        for (std::size_t i = 0; i < num_workers; ++i) {
+            std::unique_ptr<Worker> worker(new Worker); // Throws
+            worker->history = make_client_history(path, encryption_key); // Throws
+            worker->shared_group.reset(new SharedGroup(*worker->history, durability,
+                                                       encryption_key)); // Throws
+            worker->pins = m_pins;
+            Worker* w = worker.get();
+            m_workers.push_back(std::move(worker)); // Throws
+            w->thread.start([w] { run(*w); }); // Throws
+        }
+    }
+    catch (...) {
+        stop();
+        throw;
+    }
+}
+
+inline AsyncQueryExecutor::~AsyncQueryExecutor() REALM_NOEXCEPT
+{
+    stop();
+}
+
+inline void AsyncQueryExecutor::stop() REALM_NOEXCEPT
+{
+    typedef std::vector<std::unique_ptr<Worker>>::iterator iter;
+    for (iter i = m_workers.begin(), end = m_workers.end(); i != end; ++i) {
+        Worker& w = **i;
+        {
+            util::LockGuard lg(w.mutex);
+            w.stop = true;
+            w.cond.notify();
+        }
+        if (w.thread.joinable())
+            w.thread.join();
+    }
+    m_workers.clear();
+}
+
+inline uint_fast64_t AsyncQueryExecutor::submit(SharedGroup& sg, const Query& query, Callback callback)
+{
+    bool rerun = false;
+    return add(sg, query, std::move(callback), rerun); // Throws
+}
+
+inline uint_fast64_t AsyncQueryExecutor::subscribe(SharedGroup& sg, const Query& query,
+                                                   Callback callback)
+{
+    bool rerun = true;
+    return add(sg, query, std::move(callback), rerun); // Throws
+}
+
+inline uint_fast64_t AsyncQueryExecutor::add(SharedGroup& sg, const Query& query, Callback callback,
+                                             bool rerun)
+{
+    Task task;
+    task.handover = sg.export_for_handover(query, ConstSourcePayload::Stay); // Throws
+    task.source.reset(new PinnedVersion(m_pins, task.handover->version)); // Throws
+    task.callback = std::move(callback);
+    task.rerun = rerun;
+    {
+        util::LockGuard lg(m_mutex);
+        task.token = m_next_token++;
+    }
+    uint_fast64_t token = task.token;
+    Worker& w = get_worker(token);
+    util::LockGuard lg(w.mutex);
+    w.tasks.push_back(std::move(task)); // Throws
+    w.cond.notify();
+    return token;
+}
+
+inline void AsyncQueryExecutor::cancel(uint_fast64_t token)
+{
+    Worker& w = get_worker(token);
+    util::LockGuard lg(w.mutex);
+    w.cancelled.push_back(token); // Throws
+    w.cond.notify();
+}
+
+inline void AsyncQueryExecutor::notify()
+{
+    typedef std::vector<std::unique_ptr<Worker>>::iterator iter;
+    for (iter i = m_workers.begin(), end = m_workers.end(); i != end; ++i) {
+        Worker& w = **i;
+        util::LockGuard lg(w.mutex);
+        w.notified = true;
+        w.cond.notify();
+    }
+}
+
+inline AsyncQueryExecutor::Worker& AsyncQueryExecutor::get_worker(uint_fast64_t token) REALM_NOEXCEPT
+{
+    return *m_workers[std::size_t(token % m_workers.size())];
+}
+
+inline void AsyncQueryExecutor::run(Worker& w)
+{
+    SharedGroup& sg = *w.shared_group;
+    bool is_reading = false;
+    SharedGroup::VersionID last_version;
+    for (;;) {
+        std::deque<Task> tasks;
+        std::vector<uint_fast64_t> cancelled;
+        {
+            util::LockGuard lg(w.mutex);
+            while (!w.stop && !w.notified && w.tasks.empty() && w.cancelled.empty())
+                wait(w, lg);
+            if (w.stop)
+                break;
+            tasks.swap(w.tasks);
+            cancelled.swap(w.cancelled);
+            w.notified = false;
+        }
+
+        typedef std::vector<uint_fast64_t>::const_iterator cancel_iter;
+        for (cancel_iter i = cancelled.begin(), end = cancelled.end(); i != end; ++i) {
+            typedef std::vector<Subscription>::iterator sub_iter;
+            for (sub_iter j = w.subscriptions.begin(); j != w.subscriptions.end(); ++j) {
+                if (j->token == *i) {
+                    w.subscriptions.erase(j);
+                    break;
+                }
+            }
+            typedef std::deque<Task>::iterator task_iter;
+            for (task_iter j = tasks.begin(); j != tasks.end(); ++j) {
+                if (j->token == *i) {
+                    tasks.erase(j);
+                    break;
+                }
+            }
+        }
+
+        // Bring every new query to the latest version, and run the
+        // subscribed queries again if the version changed
+        std::size_t num_old_subscriptions = w.subscriptions.size();
+        try {
+            if (is_reading) {
+                LangBindHelper::advance_read(sg, *w.history); // Throws
+            }
+            else {
+                sg.begin_read(); // Throws
+                is_reading = true;
+            }
+        }
+        catch (...) {
+            std::exception_ptr error = std::current_exception();
+            typedef std::deque<Task>::iterator task_iter;
+            for (task_iter i = tasks.begin(), end = tasks.end(); i != end; ++i)
+                fail(i->callback, i->token, error);
+            typedef std::vector<Subscription>::iterator sub_iter;
+            for (sub_iter i = w.subscriptions.begin(), end = w.subscriptions.end(); i != end; ++i)
+                fail(i->callback, i->token, error);
+            continue;
+        }
+        SharedGroup::VersionID version = sg.get_version_of_current_transaction();
+        bool rerun = version != last_version;
+        last_version.version = version.version;
+        last_version.index = version.index;
+        std::vector<Subscription> one_shots;
+        typedef std::deque<Task>::iterator task_iter;
+        for (task_iter i = tasks.begin(), end = tasks.end(); i != end; ++i) {
+            Subscription s;
+            s.token = i->token;
+            try {
+                s.query = import_query(w, *i, version); // Throws
+            }
+            catch (...) {
+                fail(i->callback, i->token, std::current_exception());
+                continue;
+            }
+            s.callback = std::move(i->callback);
+            if (i->rerun) {
+                w.subscriptions.push_back(std::move(s)); // Throws
+            }
+            else {
+                one_shots.push_back(std::move(s)); // Throws
+            }
+        }
+
+        // Shared by the results of this version
+        util::bind_ptr<PinnedVersion> pin;
+        for (std::size_t i = 0; i < w.subscriptions.size(); ++i) {
+            if (rerun || i >= num_old_subscriptions)
+                execute(w, pin, w.subscriptions[i].token, *w.subscriptions[i].query,
+                        w.subscriptions[i].callback); // Throws
+        }
+        typedef std::vector<Subscription>::iterator sub_iter;
+        for (sub_iter i = one_shots.begin(), end = one_shots.end(); i != end; ++i)
+            execute(w, pin, i->token, *i->query, i->callback); // Throws
+    }
+    w.subscriptions.clear();
+    if (is_reading)
+        sg.end_read();
+}
+
+inline void AsyncQueryExecutor::wait(Worker& w, util::LockGuard& lg)
+{
+    if (w.subscriptions.empty()) {
+        w.cond.wait(lg);
+        return;
+    }
+
+    // Changes by other processes, or by threads that do not call notify(),
+    // are only found by looking for them now and then
+    std::chrono::system_clock::time_point deadline =
+        std::chrono::system_clock::now() + std::chrono::milliseconds(poll_interval);
+    std::chrono::nanoseconds since_epoch = deadline.time_since_epoch();
+    struct timespec ts;
+    ts.tv_sec = time_t(std::chrono::duration_cast<std::chrono::seconds>(since_epoch).count());
+    ts.tv_nsec = long((since_epoch - std::chrono::seconds(ts.tv_sec)).count());
+    w.cond.wait(lg, &ts);
+    try {
+        if (!w.notified && w.shared_group->has_changed()) // Throws
+            w.notified = true;
+    }
+    catch (...) {
+        // Let the advance report it
+        w.notified = true;
+    }
+}
+
+inline void AsyncQueryExecutor::fail(const Callback& callback, uint_fast64_t token,
+                                     std::exception_ptr error) REALM_NOEXCEPT
+{
+    Result result;
+    result.token = token;
+    result.error = error;
+    callback(std::move(result));
+}
+
+inline std::unique_ptr<Query>
+AsyncQueryExecutor::import_query(Worker& w, Task& task, SharedGroup::VersionID version)
+{
+    std::unique_ptr<SharedGroup::Handover<Query>> h = std::move(task.handover);
+    util::bind_ptr<PinnedVersion> source = std::move(task.source);
+
+    // The query was exported from the version of the submitting thread,
+    // which may be older than the version of the worker. That version is
+    // still held by the source pin, so the query is imported there, advanced,
+    // and exported again at the version of the worker.
+    if (h->version != version) {
+        SharedGroup& ssg = source->get_shared_group();
+        std::unique_ptr<Query> query = ssg.import_from_handover(std::move(h)); // Throws
+        LangBindHelper::advance_read(ssg, source->get_history(), version); // Throws
+        h = ssg.export_for_handover(*query, ConstSourcePayload::Stay); // Throws
+    }
+    return w.shared_group->import_from_handover(std::move(h)); // Throws
+}
+
+inline void AsyncQueryExecutor::execute(Worker& w, util::bind_ptr<PinnedVersion>& pin,
+                                        uint_fast64_t token, Query& query, const Callback& callback)
+{
+    SharedGroup& sg = *w.shared_group;
+    Result result;
+    result.token = token;
+    try {
+        TableView tv = query.find_all(); // Throws
+        HandoverBatch::Exporter exporter(result.batch, sg); // Throws
+        result.ticket = exporter.add(tv, MutableSourcePayload::Move); // Throws
+
+        // The worker moves on to newer versions, so the result holds its own
+        // read transaction on this one
+        if (!pin)
+            pin.reset(new PinnedVersion(w.pins, sg.get_version_of_current_transaction())); // Throws
+        std::unique_ptr<ResultPin> result_pin(new ResultPin); // Throws
+        result_pin->version = pin;
+        result.batch.set_pin(std::move(result_pin));
+    }
+    catch (...) {
+        result.error = std::current_exception();
+    }
+    callback(std::move(result));
+}
+
+
+inline std::unique_ptr<TableView> AsyncQueryExecutor::Result::import(SharedGroup& sg,
+                                                                     History& history)
+{
+    if (error)
+        std::rethrow_exception(error);
+    using sgf = _impl::SharedGroupFriend;
+    if (!sgf::is_reading(sg))
+        throw LogicError(LogicError::wrong_transact_state);
+    SharedGroup::VersionID version = sg.get_version_of_current_transaction();
+    if (version <= batch.get_version()) {
+        batch.import(sg, &history); // Throws
+        return batch.take(ticket);
+    }
+
+    // The importing shared group has moved past the version of the result,
+    // which the pin of the batch still holds. Import the table view at that
+    // version on a shared group of its own, and advance it from there.
+    const ResultPin* pin = dynamic_cast<const ResultPin*>(batch.get_pin());
+    REALM_ASSERT(pin);
+    util::bind_ptr<PinnedVersion> source(new PinnedVersion(pin->version->get_pool(),
+                                                           batch.get_version())); // Throws
+    SharedGroup& ssg = source->get_shared_group();
+    batch.import(ssg); // Throws
+    std::unique_ptr<TableView> tv = batch.take(ticket);
+    LangBindHelper::advance_read(ssg, source->get_history(), version); // Throws
+    tv->sync_if_needed(); // Throws
+    std::unique_ptr<SharedGroup::Handover<TableView>> h =
+        ssg.export_for_handover(*tv, MutableSourcePayload::Move); // Throws
+    return sg.import_from_handover(std::move(h)); // Throws
+}
+
+
+inline AsyncQueryExecutor::PinnedVersion::PinnedVersion(const util::bind_ptr<PinPool>& pool,
+                                                        SharedGroup::VersionID version):
+    m_pool(pool)
+{
+    {
+        util::LockGuard lg(pool->mutex);
+        if (!pool->slots.empty()) {
+            m_slot = std::move(pool->slots.back());
+            pool->slots.pop_back();
+        }
+    }
+    if (!m_slot.shared_group) {
+        m_slot.history = make_client_history(pool->path, pool->get_encryption_key()); // Throws
+        m_slot.shared_group.reset(new SharedGroup(*m_slot.history, pool->durability,
+                                                  pool->get_encryption_key())); // Throws
+    }
+    m_slot.shared_group->begin_read(version); // Throws
+}
+
+inline AsyncQueryExecutor::PinnedVersion::~PinnedVersion() REALM_NOEXCEPT
+{
+    m_slot.shared_group->end_read();
+    try {
+        util::LockGuard lg(m_pool->mutex);
+        m_pool->slots.push_back(std::move(m_slot)); // Throws
+    }
+    catch (...) {
+        // Closed instead of reused
+    }
+}
+
+} // namespace realm
+
+#endif // REALM_ASYNC_QUERY_EXECUTOR_HPP
@@ -0,0 +1,306 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_BATCH_READER_HPP
+#define REALM_BATCH_READER_HPP
+
+#include <algorithm>
+
+#include <realm/column.hpp>
+#include <realm/column_basic.hpp>
+#include <realm/column_string.hpp>
+#include <realm/column_string_enum.hpp>
+#include <realm/table.hpp>
+#include <realm/table_view.hpp>
+#include <realm/query_engine.hpp>
+
+namespace realm {
+
+/// Read the values of many rows of a column at once.
+///
+/// Table::get_int() and friends descend the B+-tree of the column for every
+/// value. The functions below keep the current leaf (see SequentialGetter)
+/// and only descend again when a row falls outside of it:
+///
+///  - The *_range() functions read the rows [begin, end) of a table. Each
+///    leaf is visited once, and bit-packed integer leaves are decoded eight
+///    values at a time (Array::get_chunk()).
+///
+///  - The gather_*() functions read the rows at a list of row indexes, or
+///    the rows of a table view. Rows that are close together, as in a view
+///    that is in table order, share leaf lookups. Detached rows of a view
+///    produce a default value (0 or null).
+///
+/// get_int_range() and gather_int() also accept Bool and DateTime columns,
+/// producing the stored integer. Nullable integer columns produce 0 for
+/// null.
+class BatchReader {
+public:
+    static void get_int_range(const Table&, std::size_t column_ndx,
+                              std::size_t begin, std::size_t end, int64_t* out);
+    static void get_float_range(const Table&, std::size_t column_ndx,
+                                std::size_t begin, std::size_t end, float* out);
+    static void get_double_range(const Table&, std::size_t column_ndx,
+                                 std::size_t begin, std::size_t end, double* out);
+    static void get_string_range(const Table&, std::size_t column_ndx,
+                                 std::size_t begin, std::size_t end, StringData* out);
+
+    static void gather_int(const Table&, std::size_t column_ndx,
+                           const std::size_t* rows, std::size_t num_rows, int64_t* out);
+    static void gather_float(const Table&, std::size_t column_ndx,
+                             const std::size_t* rows, std::size_t num_rows, float* out);
+    static void gather_double(const Table&, std::size_t column_ndx,
+                              const std::size_t* rows, std::size_t num_rows, double* out);
+    static void gather_string(const Table&, std::size_t column_ndx,
+                              const std::size_t* rows, std::size_t num_rows, StringData* out);
+
+    /// Read the rows at positions [begin, end) of the view.
+    static void gather_int(const TableViewBase&, std::size_t column_ndx,
+                           std::size_t begin, std::size_t end, int64_t* out);
+    static void gather_float(const TableViewBase&, std::size_t column_ndx,
+                             std::size_t begin, std::size_t end, float* out);
+    static void gather_double(const TableViewBase&, std::size_t column_ndx,
+                              std::size_t begin, std::size_t end, double* out);
+    static void gather_string(const TableViewBase&, std::size_t column_ndx,
+                              std::size_t begin, std::size_t end, StringData* out);
+
+private:
+    template<class C> static const C* get_column(const Table&, std::size_t column_ndx) REALM_NOEXCEPT;
+
+    static void copy_from_leaf(const ArrayInteger&, std::size_t begin, std::size_t end, int64_t* out);
+    template<class T>
+    static void copy_from_leaf(const BasicArray<T>&, std::size_t begin, std::size_t end, T* out);
+
+    /// Leaf by leaf copy of [begin, end).
+    template<class C, class T>
+    static void read_range(const C&, std::size_t begin, std::size_t end, T* out);
+
+    /// Copy the rows row_at(0) ... row_at(n-1), through a leaf cache.
+    template<class C, class T, class R>
+    static void gather(const C&, R row_at, std::size_t n, T* out);
+
+    template<class R>
+    static void gather_int_rows(const Table&, std::size_t column_ndx, R row_at, std::size_t n, int64_t* out);
+    template<class R>
+    static void gather_string_rows(const Table&, std::size_t column_ndx, R row_at, std::size_t n, StringData* out);
+};
+
+
+
+
+// Implementation:
+
+template<class C>
+inline const C* BatchReader::get_column(const Table& table, std::size_t column_ndx) REALM_NOEXCEPT
+{
+    return dynamic_cast<const C*>(&_impl::TableFriend::get_column(table, column_ndx));
+}
+
+inline void BatchReader::copy_from_leaf(const ArrayInteger& leaf, std::size_t begin, std::size_t end,
+                                        int64_t* out)
+{
+    std::size_t i = begin;
+    // Decode whole chunks, then the rest one at a time
+    for (; i + 8 <= end; i += 8)
+        leaf.get_chunk(i, out + (i - begin));
+    for (; i < end; ++i)
+        out[i - begin] = leaf.get(i);
+}
+
+template<class T>
+inline void BatchReader::copy_from_leaf(const BasicArray<T>& leaf, std::size_t begin, std::size_t end, T* out)
+{
+    for (std::size_t i = begin; i < end; ++i)
+        out[i - begin] = leaf.get(i);
+}
+
+template<class C, class T>
+void BatchReader::read_range(const C& column, std::size_t begin, std::size_t end, T* out)
+{
+    REALM_ASSERT_3(begin, <=, end);
+    REALM_ASSERT_3(end, <=, column.size());
+    SequentialGetter<C> getter(&column);
+    std::size_t i = begin;
+    while (i < end) {
+        getter.cache_next(i);
+        std::size_t leaf_end = std::min(end, getter.m_leaf_end);
+        copy_from_leaf(*getter.m_leaf_ptr, i - getter.m_leaf_start, leaf_end - getter.m_leaf_start, out);
+        out += leaf_end - i;
+        i = leaf_end;
+    }
+}
+
+template<class C, class T, class R>
+void BatchReader::gather(const C& column, R row_at, std::size_t n, T* out)
+{
+    SequentialGetter<C> getter(&column);
+    for (std::size_t i = 0; i < n; ++i) {
+        std::size_t row_ndx = row_at(i);
+        out[i] = row_ndx == detached_ref ? T() : T(getter.get_next(row_ndx));
+    }
+}
+
+inline void BatchReader::get_int_range(const Table& table, std::size_t column_ndx,
+                                       std::size_t begin, std::size_t end, int64_t* out)
+{
+    if (const IntegerColumn* column = get_column<IntegerColumn>(table, column_ndx)) {
+        read_range(*column, begin, end, out);
+        return;
+    }
+    // Nullable integers
+    gather_int_rows(table, column_ndx, [begin](std::size_t i) { return begin + i; }, end - begin, out);
+}
+
+inline void BatchReader::get_float_range(const Table& table, std::size_t column_ndx,
+                                         std::size_t begin, std::size_t end, float* out)
+{
+    const FloatColumn* column = get_column<FloatColumn>(table, column_ndx);
+    REALM_ASSERT(column);
+    read_range(*column, begin, end, out);
+}
+
+inline void BatchReader::get_double_range(const Table& table, std::size_t column_ndx,
+                                          std::size_t begin, std::size_t end, double* out)
+{
+    const DoubleColumn* column = get_column<DoubleColumn>(table, column_ndx);
+    REALM_ASSERT(column);
+    read_range(*column, begin, end, out);
+}
+
+inline void BatchReader::get_string_range(const Table& table, std::size_t column_ndx,
+                                          std::size_t begin, std::size_t end, StringData* out)
+{
+    gather_string_rows(table, column_ndx, [begin](std::size_t i) { return begin + i; }, end - begin, out);
+}
+
+template<class R>
+void BatchReader::gather_int_rows(const Table& table, std::size_t column_ndx, R row_at, std::size_t n, int64_t* out)
+{
+    if (const IntegerColumn* column = get_column<IntegerColumn>(table, column_ndx)) {
+        gather(*column, row_at, n, out);
+        return;
+    }
+    const IntNullColumn* column = get_column<IntNullColumn>(table, column_ndx);
+    REALM_ASSERT(column);
+    for (std::size_t i = 0; i < n; ++i) {
+        std::size_t row_ndx = row_at(i);
+        out[i] = row_ndx == detached_ref || column->is_null(row_ndx) ? 0 : table.get_int(column_ndx, row_ndx);
+    }
+}
+
+template<class R>
+void BatchReader::gather_string_rows(const Table& table, std::size_t column_ndx, R row_at, std::size_t n,
+                                     StringData* out)
+{
+    if (const StringEnumColumn* column = get_column<StringEnumColumn>(table, column_ndx)) {
+        // Gather the key indexes through the integer leaves, then look up
+        // each distinct key once
+        const StringColumn& keys = column->get_keys();
+        const IntegerColumn& key_indexes = *column;
+        SequentialGetter<IntegerColumn> getter(&key_indexes);
+        std::size_t last_key_ndx = npos;
+        StringData last_key;
+        for (std::size_t i = 0; i < n; ++i) {
+            std::size_t row_ndx = row_at(i);
+            if (row_ndx == detached_ref) {
+                out[i] = StringData();
+                continue;
+            }
+            std::size_t key_ndx = std::size_t(getter.get_next(row_ndx));
+            if (key_ndx != last_key_ndx) {
+                last_key = keys.get(key_ndx);
+                last_key_ndx = key_ndx;
+            }
+            out[i] = last_key;
+        }
+        return;
+    }
+    // String leaves come in three formats (short, long and big blobs), so
+    // these are read one row at a time
+    for (std::size_t i = 0; i < n; ++i) {
+        std::size_t row_ndx = row_at(i);
+        out[i] = row_ndx == detached_ref ? StringData() : table.get_string(column_ndx, row_ndx);
+    }
+}
+
+inline void BatchReader::gather_int(const Table& table, std::size_t column_ndx,
+                                    const std::size_t* rows, std::size_t num_rows, int64_t* out)
+{
+    gather_int_rows(table, column_ndx, [rows](std::size_t i) { return rows[i]; }, num_rows, out);
+}
+
+inline void BatchReader::gather_float(const Table& table, std::size_t column_ndx,
+                                      const std::size_t* rows, std::size_t num_rows, float* out)
+{
+    const FloatColumn* column = get_column<FloatColumn>(table, column_ndx);
+    REALM_ASSERT(column);
+    gather(*column, [rows](std::size_t i) { return rows[i]; }, num_rows, out);
+}
+
+inline void BatchReader::gather_double(const Table& table, std::size_t column_ndx,
+                                       const std::size_t* rows, std::size_t num_rows, double* out)
+{
+    const DoubleColumn* column = get_column<DoubleColumn>(table, column_ndx);
+    REALM_ASSERT(column);
+    gather(*column, [rows](std::size_t i) { return rows[i]; }, num_rows, out);
+}
+
+inline void BatchReader::gather_string(const Table& table, std::size_t column_ndx,
+                                       const std::size_t* rows, std::size_t num_rows, StringData* out)
+{
+    gather_string_rows(table, column_ndx, [rows](std::size_t i) { return rows[i]; }, num_rows, out);
+}
+
+inline void BatchReader::gather_int(const TableViewBase& view, std::size_t column_ndx,
+                                    std::size_t begin, std::size_t end, int64_t* out)
+{
+    REALM_ASSERT_3(end, <=, view.size());
+    gather_int_rows(*view.m_table, column_ndx,
+                    [&view, begin](std::size_t i) { return view.get_source_ndx(begin + i); }, end - begin, out);
+}
+
+inline void BatchReader::gather_float(const TableViewBase& view, std::size_t column_ndx,
+                                      std::size_t begin, std::size_t end, float* out)
+{
+    REALM_ASSERT_3(end, <=, view.size());
+    const FloatColumn* column = get_column<FloatColumn>(*view.m_table, column_ndx);
+    REALM_ASSERT(column);
+    gather(*column, [&view, begin](std::size_t i) { return view.get_source_ndx(begin + i); }, end - begin, out);
+}
+
+inline void BatchReader::gather_double(const TableViewBase& view, std::size_t column_ndx,
+                                       std::size_t begin, std::size_t end, double* out)
+{
+    REALM_ASSERT_3(end, <=, view.size());
+    const DoubleColumn* column = get_column<DoubleColumn>(*view.m_table, column_ndx);
+    REALM_ASSERT(column);
+    gather(*column, [&view, begin](std::size_t i) { return view.get_source_ndx(begin + i); }, end - begin, out);
+}
+
+inline void BatchReader::gather_string(const TableViewBase& view, std::size_t column_ndx,
+                                       std::size_t begin, std::size_t end, StringData* out)
+{
+    REALM_ASSERT_3(end, <=, view.size());
+    gather_string_rows(*view.m_table, column_ndx,
+                       [&view, begin](std::size_t i) { return view.get_source_ndx(begin + i); }, end - begin, out);
+}
+
+} // namespace realm
+
+#endif // REALM_BATCH_READER_HPP
@@ -0,0 +1,742 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_CHANGE_SET_HPP
+#define REALM_CHANGE_SET_HPP
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <realm/impl/transact_log.hpp>
+#include <realm/group_shared.hpp>
+#include <realm/lang_bind_helper.hpp>
+
+namespace realm {
+
+/// A set of row indexes, stored as a sorted list of disjoint ranges.
+class IndexSet {
+public:
+    typedef std::pair<std::size_t, std::size_t> Range; // [first, second)
+    typedef std::vector<Range>::const_iterator const_iterator;
+
+    /// Add an index, which must be greater than every index already in the
+    /// set.
+    void push_back(std::size_t ndx);
+
+    /// Add the indexes [begin, end), which must be greater than every index
+    /// already in the set.
+    void push_back(std::size_t begin, std::size_t end);
+
+    bool contains(std::size_t ndx) const REALM_NOEXCEPT;
+
+    /// The number of indexes in the set.
+    std::size_t count() const REALM_NOEXCEPT;
+
+    bool empty() const REALM_NOEXCEPT { return m_ranges.empty(); }
+
+    const_iterator begin() const REALM_NOEXCEPT { return m_ranges.begin(); }
+    const_iterator end() const REALM_NOEXCEPT { return m_ranges.end(); }
+
+private:
+    std::vector<Range> m_ranges;
+};
+
+
+/// The changes to the rows of one group-level table between two versions.
+///
+/// Deletions refer to row indexes in the old version, and insertions and
+/// modifications to row indexes in the new version. Applying the deletions
+/// in descending order, then the insertions in ascending order, and finally
+/// the moves, turns the rows of the old version into those of the new
+/// version, which is how list views (UITableView and the like) expect their
+/// updates.
+struct TableChangeSet {
+    /// The index of the table in the new version.
+    std::size_t table_ndx = 0;
+
+    /// All rows of the old version were removed (Table::clear()). The
+    /// deletions are not listed individually in that case.
+    bool cleared = false;
+
+    /// Columns were inserted, removed, renamed, or indexed.
+    bool schema_changed = false;
+
+    IndexSet deletions;
+    IndexSet insertions;
+
+    /// Rows that exist in both versions, and had a value modified. Changes
+    /// inside subtables and link lists count as modifications of the row
+    /// that holds them.
+    IndexSet modifications;
+
+    /// Rows that exist in both versions, but whose relative order changed
+    /// (Table::move_last_over()), as pairs of old and new row index. Index
+    /// shifts that follow from deletions and insertions are not moves.
+    std::vector<std::pair<std::size_t, std::size_t>> moves;
+
+    /// Columns, by index in the new version, with modified values. Row
+    /// insertion and removal is not reflected here.
+    std::vector<bool> columns;
+
+    bool is_column_modified(std::size_t col_ndx) const REALM_NOEXCEPT;
+};
+
+
+/// The changes to all group-level tables between two versions.
+struct ChangeSet {
+    /// The tables that changed, by increasing table index.
+    std::vector<TableChangeSet> tables;
+
+    /// Group-level tables were inserted or removed, so the table indexes of
+    /// the two versions may differ. Table indexes in \a tables are those of
+    /// the new version.
+    bool table_set_changed = false;
+
+    /// Returns null if the table did not change.
+    const TableChangeSet* get_table(std::size_t table_ndx) const REALM_NOEXCEPT;
+};
+
+
+/// Folds transaction logs into a ChangeSet.
+///
+/// The builder is fed through its observer, which can be passed to
+/// LangBindHelper::advance_read(), promote_to_write(), or
+/// rollback_and_continue_as_read(). Rows moved by move_last_over(), and row
+/// indexes shifted by insertion and removal, are followed across any
+/// number of instructions and transactions, so every row is reported at
+/// most once, in the terms of the old and new version.
+///
+/// The row mapping of a table is only materialized when rows are inserted
+/// in the middle of, or removed from, the table. It then takes space
+/// proportional to the number of rows in the table. Modifications and
+/// appends at the end are tracked without it.
+///
+///     ChangeSet changes = ChangeSetBuilder::advance_read(sg, history);
+///     if (const TableChangeSet* c = changes.get_table(table_ndx))
+///         update_list_view(*c);
+class ChangeSetBuilder {
+public:
+    class Observer;
+
+    Observer observer() REALM_NOEXCEPT;
+
+    /// Return the changes recorded so far, and reset the builder.
+    ChangeSet finish();
+
+    /// Advance the read transaction of the shared group to the specified
+    /// version (the latest by default), and return the changes.
+    static ChangeSet advance_read(SharedGroup&, History&,
+                                  SharedGroup::VersionID = SharedGroup::VersionID());
+
+    /// Return the changes between two versions, using a read transaction on
+    /// the shared group, which must not be in a transaction. Both versions
+    /// must be bound, that is, still be held by a read transaction
+    /// elsewhere.
+    ///
+    /// \throw SharedGroup::BadVersion If either version is not bound.
+    static ChangeSet compute(SharedGroup&, History&, SharedGroup::VersionID from,
+                             SharedGroup::VersionID to);
+
+private:
+    class TableBuilder {
+    public:
+        TableBuilder() REALM_NOEXCEPT {}
+
+        void insert_rows(std::size_t row_ndx, std::size_t num_rows, std::size_t prior_num_rows,
+                         bool unordered);
+        void erase_rows(std::size_t row_ndx, std::size_t num_rows, std::size_t prior_num_rows,
+                        bool unordered);
+        void clear();
+        void modify(std::size_t row_ndx, std::size_t col_ndx);
+        void insert_column(std::size_t col_ndx);
+        void erase_column(std::size_t col_ndx);
+        void mark_schema() REALM_NOEXCEPT { m_schema_changed = true; }
+
+        void finish(TableChangeSet&) const;
+
+    private:
+        // Until m_is_mapped is set, rows of the old version keep their
+        // index, and the rows at or above m_num_old_rows (when known) were
+        // appended
+        bool m_is_mapped = false;
+        std::size_t m_num_old_rows = npos;
+        std::size_t m_num_appended = 0;
+        std::vector<std::size_t> m_modified_rows; // Unsorted, may have duplicates
+
+        // When m_is_mapped is set, the old index of each current row, or
+        // npos for inserted rows, and whether it was modified
+        std::vector<std::size_t> m_old_ndx;
+        std::vector<bool> m_modified;
+
+        std::vector<std::size_t> m_deleted; // Old indexes
+        std::vector<bool> m_columns;
+        bool m_cleared = false;
+        bool m_schema_changed = false;
+
+        void map_rows(std::size_t num_rows);
+        static void find_moves(const std::vector<std::size_t>& old_ndx, TableChangeSet&);
+    };
+
+    // By current table index
+    std::map<std::size_t, TableBuilder> m_tables;
+    bool m_table_set_changed = false;
+
+    TableBuilder& get(std::size_t table_ndx);
+    void insert_table(std::size_t table_ndx);
+    void erase_table(std::size_t table_ndx);
+};
+
+
+/// Transaction log handler that records the changes in a ChangeSetBuilder.
+class ChangeSetBuilder::Observer: public _impl::NullInstructionObserver {
+public:
+    explicit Observer(ChangeSetBuilder&) REALM_NOEXCEPT;
+
+    bool select_table(std::size_t group_level_ndx, std::size_t levels, const std::size_t* path);
+    bool select_descriptor(std::size_t levels, const std::size_t*);
+    bool select_link_list(std::size_t col_ndx, std::size_t row_ndx);
+    bool insert_group_level_table(std::size_t table_ndx, std::size_t, StringData);
+    bool erase_group_level_table(std::size_t table_ndx, std::size_t);
+
+    bool insert_empty_rows(std::size_t row_ndx, std::size_t num_rows, std::size_t prior_num_rows,
+                           bool unordered);
+    bool erase_rows(std::size_t row_ndx, std::size_t num_rows, std::size_t prior_num_rows,
+                    bool unordered);
+    bool clear_table();
+
+    bool set_int(std::size_t col_ndx, std::size_t row_ndx, int_fast64_t) { return modify(col_ndx, row_ndx); }
+    bool set_bool(std::size_t col_ndx, std::size_t row_ndx, bool) { return modify(col_ndx, row_ndx); }
+    bool set_float(std::size_t col_ndx, std::size_t row_ndx, float) { return modify(col_ndx, row_ndx); }
+    bool set_double(std::size_t col_ndx, std::size_t row_ndx, double) { return modify(col_ndx, row_ndx); }
+    bool set_string(std::size_t col_ndx, std::size_t row_ndx, StringData) { return modify(col_ndx, row_ndx); }
+    bool set_binary(std::size_t col_ndx, std::size_t row_ndx, BinaryData) { return modify(col_ndx, row_ndx); }
+    bool set_date_time(std::size_t col_ndx, std::size_t row_ndx, DateTime) { return modify(col_ndx, row_ndx); }
+    bool set_table(std::size_t col_ndx, std::size_t row_ndx) { return modify(col_ndx, row_ndx); }
+    bool set_mixed(std::size_t col_ndx, std::size_t row_ndx, const Mixed&) { return modify(col_ndx, row_ndx); }
+    bool set_link(std::size_t col_ndx, std::size_t row_ndx, std::size_t) { return modify(col_ndx, row_ndx); }
+    bool set_null(std::size_t col_ndx, std::size_t row_ndx) { return modify(col_ndx, row_ndx); }
+    bool nullify_link(std::size_t col_ndx, std::size_t row_ndx) { return modify(col_ndx, row_ndx); }
+
+    bool insert_link_column(std::size_t col_ndx, DataType, StringData, std::size_t, std::size_t)
+    {
+        return insert_column(col_ndx);
+    }
+    bool insert_column(std::size_t col_ndx, DataType, StringData, bool) { return insert_column(col_ndx); }
+    bool erase_link_column(std::size_t col_ndx, std::size_t, std::size_t) { return erase_column(col_ndx); }
+    bool erase_column(std::size_t col_ndx);
+    bool rename_column(std::size_t, StringData) { return schema(); }
+    bool add_search_index(std::size_t) { return schema(); }
+    bool remove_search_index(std::size_t) { return schema(); }
+    bool add_primary_key(std::size_t) { return schema(); }
+    bool remove_primary_key() { return schema(); }
+    bool set_link_type(std::size_t, LinkType) { return schema(); }
+
+    bool link_list_set(std::size_t, std::size_t) { return link_list(); }
+    bool link_list_insert(std::size_t, std::size_t) { return link_list(); }
+    bool link_list_move(std::size_t, std::size_t) { return link_list(); }
+    bool link_list_swap(std::size_t, std::size_t) { return link_list(); }
+    bool link_list_erase(std::size_t) { return link_list(); }
+    bool link_list_nullify(std::size_t) { return link_list(); }
+    bool link_list_clear(std::size_t) { return link_list(); }
+
+private:
+    ChangeSetBuilder& m_builder;
+    TableBuilder* m_table = nullptr; // Null if no group-level table is selected
+    std::size_t m_table_ndx = npos;
+
+    // When a subtable is selected, every change is a modification of this
+    // row and column of the group-level table
+    std::size_t m_subtable_col_ndx = npos;
+    std::size_t m_subtable_row_ndx = npos;
+
+    std::size_t m_link_list_col_ndx = npos;
+    std::size_t m_link_list_row_ndx = npos;
+    bool m_is_subdescriptor = false;
+
+    TableBuilder* table();
+    bool modify(std::size_t col_ndx, std::size_t row_ndx);
+    bool insert_column(std::size_t col_ndx);
+    bool schema();
+    bool link_list();
+    bool in_subtable() const REALM_NOEXCEPT { return m_subtable_col_ndx != npos; }
+};
+
+
+
+
+// Implementation:
+
+inline void IndexSet::push_back(std::size_t ndx)
+{
+    push_back(ndx, ndx + 1); // Throws
+}
+
+inline void IndexSet::push_back(std::size_t begin, std::size_t end)
+{
+    REALM_ASSERT_3(begin, <, end);
+    if (!m_ranges.empty()) {
+        REALM_ASSERT_3(m_ranges.back().second, <=, begin);
+        if (m_ranges.back().second == begin) {
+            m_ranges.back().second = end;
+            return;
+        }
+    }
+    m_ranges.push_back(Range(begin, end)); // Throws
+}
+
+inline bool IndexSet::contains(std::size_t ndx) const REALM_NOEXCEPT
+{
+    // Find the first range that ends after ndx
+    const_iterator i = std::upper_bound(m_ranges.begin(), m_ranges.end(), ndx,
+                                        [](std::size_t n, const Range& r) { return n < r.second; });
+    return i != m_ranges.end() && i->first <= ndx;
+}
+
+inline std::size_t IndexSet::count() const REALM_NOEXCEPT
+{
+    std::size_t n = 0;
+    for (const_iterator i = m_ranges.begin(), end = m_ranges.end(); i != end; ++i)
+        n += i->second - i->first;
+    return n;
+}
+
+inline bool TableChangeSet::is_column_modified(std::size_t col_ndx) const REALM_NOEXCEPT
+{
+    return col_ndx < columns.size() && columns[col_ndx];
+}
+
+inline const TableChangeSet* ChangeSet::get_table(std::size_t table_ndx) const REALM_NOEXCEPT
+{
+    typedef std::vector<TableChangeSet>::const_iterator iter;
+    iter i = std::lower_bound(tables.begin(), tables.end(), table_ndx,
+                              [](const TableChangeSet& t, std::size_t n) { return t.table_ndx < n; });
+    if (i != tables.end() && i->table_ndx == table_ndx)
+        return &*i;
+    return nullptr;
+}
+
+
+inline ChangeSetBuilder::Observer ChangeSetBuilder::observer() REALM_NOEXCEPT
+{
+    return Observer(*this);
+}
+
+inline ChangeSet ChangeSetBuilder::finish()
+{
+    ChangeSet changes;
+    changes.table_set_changed = m_table_set_changed;
+    changes.tables.resize(m_tables.size()); // Throws
+    std::size_t i = 0;
+    typedef std::map<std::size_t, TableBuilder>::const_iterator iter;
+    for (iter j = m_tables.begin(), end = m_tables.end(); j != end; ++j, ++i) {
+        changes.tables[i].table_ndx = j->first;
+        j->second.finish(changes.tables[i]); // Throws
+    }
+    m_tables.clear();
+    m_table_set_changed = false;
+    return changes;
+}
+
+inline ChangeSet ChangeSetBuilder::advance_read(SharedGroup& sg, History& history,
+                                                SharedGroup::VersionID version)
+{
+    ChangeSetBuilder builder;
+    LangBindHelper::advance_read(sg, history, builder.observer(), version); // Throws
+    return builder.finish(); // Throws
+}
+
+inline ChangeSet ChangeSetBuilder::compute(SharedGroup& sg, History& history,
+                                           SharedGroup::VersionID from, SharedGroup::VersionID to)
+{
+    sg.begin_read(from); // Throws
+    try {
+        ChangeSet changes = advance_read(sg, history, to); // Throws
+        sg.end_read();
+        return changes;
+    }
+    catch (...) {
+        sg.end_read();
+        throw;
+    }
+}
+
+inline ChangeSetBuilder::TableBuilder& ChangeSetBuilder::get(std::size_t table_ndx)
+{
+    return m_tables[table_ndx]; // Throws
+}
+
+inline void ChangeSetBuilder::insert_table(std::size_t table_ndx)
+{
+    m_table_set_changed = true;
+    std::map<std::size_t, TableBuilder> tables;
+    typedef std::map<std::size_t, TableBuilder>::iterator iter;
+    for (iter i = m_tables.begin(), end = m_tables.end(); i != end; ++i) {
+        std::size_t ndx = i->first < table_ndx ? i->first : i->first + 1;
+        tables[ndx] = std::move(i->second); // Throws
+    }
+    m_tables.swap(tables);
+}
+
+inline void ChangeSetBuilder::erase_table(std::size_t table_ndx)
+{
+    m_table_set_changed = true;
+    std::map<std::size_t, TableBuilder> tables;
+    typedef std::map<std::size_t, TableBuilder>::iterator iter;
+    for (iter i = m_tables.begin(), end = m_tables.end(); i != end; ++i) {
+        if (i->first == table_ndx)
+            continue;
+        std::size_t ndx = i->first < table_ndx ? i->first : i->first - 1;
+        tables[ndx] = std::move(i->second); // Throws
+    }
+    m_tables.swap(tables);
+}
+
+
+inline void ChangeSetBuilder::TableBuilder::map_rows(std::size_t num_rows)
+{
+    REALM_ASSERT(!m_is_mapped);
+    std::size_t num_old_rows = num_rows - m_num_appended;
+    REALM_ASSERT(m_num_old_rows == npos || m_num_old_rows == num_old_rows);
+    m_old_ndx.resize(num_rows); // Throws
+    m_modified.resize(num_rows); // Throws
+    for (std::size_t i = 0; i < num_old_rows; ++i)
+        m_old_ndx[i] = i;
+    for (std::size_t i = num_old_rows; i < num_rows; ++i)
+        m_old_ndx[i] = npos;
+    typedef std::vector<std::size_t>::const_iterator iter;
+    for (iter i = m_modified_rows.begin(), end = m_modified_rows.end(); i != end; ++i)
+        m_modified[*i] = true;
+    m_modified_rows.clear();
+    m_num_old_rows = num_old_rows;
+    m_is_mapped = true;
+}
+
+inline void ChangeSetBuilder::TableBuilder::insert_rows(std::size_t row_ndx, std::size_t num_rows,
+                                                        std::size_t prior_num_rows, bool unordered)
+{
+    if (!m_is_mapped) {
+        if (row_ndx == prior_num_rows) {
+            if (m_num_old_rows == npos)
+                m_num_old_rows = prior_num_rows;
+            m_num_appended += num_rows;
+            return;
+        }
+        map_rows(prior_num_rows); // Throws
+    }
+    REALM_ASSERT_3(prior_num_rows, ==, m_old_ndx.size());
+    if (unordered) {
+        // The inverse of move_last_over(): the rows that were at row_ndx
+        // are moved to the end to make room
+        m_old_ndx.resize(prior_num_rows + num_rows, npos); // Throws
+        m_modified.resize(prior_num_rows + num_rows); // Throws
+        std::size_t num_moved = std::min(num_rows, prior_num_rows - row_ndx);
+        for (std::size_t i = 0; i < num_moved; ++i) {
+            m_old_ndx[prior_num_rows + i] = m_old_ndx[row_ndx + i];
+            m_modified[prior_num_rows + i] = m_modified[row_ndx + i];
+            m_old_ndx[row_ndx + i] = npos;
+            m_modified[row_ndx + i] = false;
+        }
+        return;
+    }
+    m_old_ndx.insert(m_old_ndx.begin() + row_ndx, num_rows, npos); // Throws
+    m_modified.insert(m_modified.begin() + row_ndx, num_rows, false); // Throws
+}
+
+inline void ChangeSetBuilder::TableBuilder::erase_rows(std::size_t row_ndx, std::size_t num_rows,
+                                                       std::size_t prior_num_rows, bool unordered)
+{
+    if (!m_is_mapped)
+        map_rows(prior_num_rows); // Throws
+    REALM_ASSERT_3(prior_num_rows, ==, m_old_ndx.size());
+    for (std::size_t i = row_ndx; i < row_ndx + num_rows; ++i) {
+        if (m_old_ndx[i] != npos)
+            m_deleted.push_back(m_old_ndx[i]); // Throws
+    }
+    if (unordered) {
+        REALM_ASSERT_3(num_rows, ==, 1);
+        std::size_t last_row_ndx = prior_num_rows - 1;
+        m_old_ndx[row_ndx] = m_old_ndx[last_row_ndx];
+        m_modified[row_ndx] = m_modified[last_row_ndx];
+        m_old_ndx.pop_back();
+        m_modified.pop_back();
+        return;
+    }
+    m_old_ndx.erase(m_old_ndx.begin() + row_ndx, m_old_ndx.begin() + row_ndx + num_rows);
+    m_modified.erase(m_modified.begin() + row_ndx, m_modified.begin() + row_ndx + num_rows);
+}
+
+inline void ChangeSetBuilder::TableBuilder::clear()
+{
+    m_cleared = true;
+    m_deleted.clear();
+    m_modified_rows.clear();
+    m_old_ndx.clear();
+    m_modified.clear();
+    m_num_appended = 0;
+    m_num_old_rows = 0;
+    m_is_mapped = true;
+}
+
+inline void ChangeSetBuilder::TableBuilder::modify(std::size_t row_ndx, std::size_t col_ndx)
+{
+    if (col_ndx >= m_columns.size())
+        m_columns.resize(col_ndx + 1); // Throws
+    m_columns[col_ndx] = true;
+    if (m_is_mapped) {
+        m_modified[row_ndx] = true;
+        return;
+    }
+    // Modifications of appended rows are part of their insertion
+    if (m_num_old_rows == npos || row_ndx < m_num_old_rows)
+        m_modified_rows.push_back(row_ndx); // Throws
+}
+
+inline void ChangeSetBuilder::TableBuilder::insert_column(std::size_t col_ndx)
+{
+    m_schema_changed = true;
+    if (col_ndx < m_columns.size())
+        m_columns.insert(m_columns.begin() + col_ndx, false); // Throws
+}
+
+inline void ChangeSetBuilder::TableBuilder::erase_column(std::size_t col_ndx)
+{
+    m_schema_changed = true;
+    if (col_ndx < m_columns.size())
+        m_columns.erase(m_columns.begin() + col_ndx);
+}
+
+inline void ChangeSetBuilder::TableBuilder::finish(TableChangeSet& changes) const
+{
+    changes.cleared = m_cleared;
+    changes.schema_changed = m_schema_changed;
+    changes.columns = m_columns; // Throws
+
+    if (!m_cleared && !m_deleted.empty()) {
+        std::vector<std::size_t> deleted = m_deleted; // Throws
+        std::sort(deleted.begin(), deleted.end());
+        typedef std::vector<std::size_t>::const_iterator iter;
+        for (iter i = deleted.begin(), end = deleted.end(); i != end; ++i)
+            changes.deletions.push_back(*i); // Throws
+    }
+
+    if (!m_is_mapped) {
+        if (m_num_appended != 0)
+            changes.insertions.push_back(m_num_old_rows, m_num_old_rows + m_num_appended); // Throws
+        std::vector<std::size_t> modified = m_modified_rows; // Throws
+        std::sort(modified.begin(), modified.end());
+        modified.erase(std::unique(modified.begin(), modified.end()), modified.end());
+        typedef std::vector<std::size_t>::const_iterator iter;
+        for (iter i = modified.begin(), end = modified.end(); i != end; ++i)
+            changes.modifications.push_back(*i); // Throws
+        return;
+    }
+
+    for (std::size_t i = 0; i < m_old_ndx.size(); ++i) {
+        if (m_old_ndx[i] == npos) {
+            changes.insertions.push_back(i); // Throws
+        }
+        else if (m_modified[i]) {
+            changes.modifications.push_back(i); // Throws
+        }
+    }
+    find_moves(m_old_ndx, changes); // Throws
+}
+
+inline void ChangeSetBuilder::TableBuilder::find_moves(const std::vector<std::size_t>& old_ndx,
+                                                       TableChangeSet& changes)
+{
+    // The rows that kept their relative order are those on a longest
+    // increasing subsequence of old indexes, taken in new order, and the
+    // remaining rows moved. In the common case, nothing moved.
+    std::vector<std::size_t> rows; // New indexes of the rows that exist in both versions
+    bool is_ordered = true;
+    std::size_t prev = 0;
+    for (std::size_t i = 0; i < old_ndx.size(); ++i) {
+        if (old_ndx[i] == npos)
+            continue;
+        if (!rows.empty() && old_ndx[i] < prev)
+            is_ordered = false;
+        prev = old_ndx[i];
+        rows.push_back(i); // Throws
+    }
+    if (is_ordered)
+        return;
+
+    // tails[k] is the position in `rows` of the smallest tail of an
+    // increasing subsequence of length k+1
+    std::vector<std::size_t> tails;
+    std::vector<std::size_t> preds(rows.size()); // Throws
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        std::size_t v = old_ndx[rows[i]];
+        std::vector<std::size_t>::iterator j =
+            std::lower_bound(tails.begin(), tails.end(), v,
+                             [&](std::size_t t, std::size_t w) { return old_ndx[rows[t]] < w; });
+        preds[i] = j == tails.begin() ? npos : *(j - 1);
+        if (j == tails.end()) {
+            tails.push_back(i); // Throws
+        }
+        else {
+            *j = i;
+        }
+    }
+    std::vector<bool> in_order(rows.size()); // Throws
+    for (std::size_t i = tails.back(); i != npos; i = preds[i])
+        in_order[i] = true;
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        if (!in_order[i])
+            changes.moves.push_back(std::make_pair(old_ndx[rows[i]], rows[i])); // Throws
+    }
+}
+
+
+inline ChangeSetBuilder::Observer::Observer(ChangeSetBuilder& builder) REALM_NOEXCEPT:
+    m_builder(builder)
+{
+}
+
+inline ChangeSetBuilder::TableBuilder* ChangeSetBuilder::Observer::table()
+{
+    if (!m_table && m_table_ndx != npos)
+        m_table = &m_builder.get(m_table_ndx); // Throws
+    return m_table;
+}
+
+inline bool ChangeSetBuilder::Observer::select_table(std::size_t group_level_ndx, std::size_t levels,
+                                                     const std::size_t* path)
+{
+    m_table = nullptr;
+    m_table_ndx = group_level_ndx;
+    m_subtable_col_ndx = levels == 0 ? npos : path[0];
+    m_subtable_row_ndx = levels == 0 ? npos : path[1];
+    m_link_list_col_ndx = npos;
+    m_is_subdescriptor = false;
+    return true;
+}
+
+inline bool ChangeSetBuilder::Observer::select_descriptor(std::size_t levels, const std::size_t*)
+{
+    m_is_subdescriptor = levels != 0;
+    return true;
+}
+
+inline bool ChangeSetBuilder::Observer::select_link_list(std::size_t col_ndx, std::size_t row_ndx)
+{
+    m_link_list_col_ndx = col_ndx;
+    m_link_list_row_ndx = row_ndx;
+    return true;
+}
+
+inline bool ChangeSetBuilder::Observer::insert_group_level_table(std::size_t table_ndx, std::size_t,
+                                                                 StringData)
+{
+    m_builder.insert_table(table_ndx); // Throws
+    m_table = nullptr;
+    if (m_table_ndx != npos && m_table_ndx >= table_ndx)
+        ++m_table_ndx;
+    return true;
+}
+
+inline bool ChangeSetBuilder::Observer::erase_group_level_table(std::size_t table_ndx, std::size_t)
+{
+    m_builder.erase_table(table_ndx);
+    m_table = nullptr;
+    if (m_table_ndx == table_ndx) {
+        m_table_ndx = npos;
+    }
+    else if (m_table_ndx != npos && m_table_ndx > table_ndx) {
+        --m_table_ndx;
+    }
+    return true;
+}
+
+inline bool ChangeSetBuilder::Observer::insert_empty_rows(std::size_t row_ndx, std::size_t num_rows,
+                                                          std::size_t prior_num_rows, bool unordered)
+{
+    if (in_subtable())
+        return modify(m_subtable_col_ndx, m_subtable_row_ndx); // Throws
+    if (TableBuilder* t = table()) // Throws
+        t->insert_rows(row_ndx, num_rows, prior_num_rows, unordered); // Throws
+    return true;
+}
+
+inline bool ChangeSetBuilder::Observer::erase_rows(std::size_t row_ndx, std::size_t num_rows,
+                                                   std::size_t prior_num_rows, bool unordered)
+{
+    if (in_subtable())
+        return modify(m_subtable_col_ndx, m_subtable_row_ndx); // Throws
+    if (TableBuilder* t = table()) // Throws
+        t->erase_rows(row_ndx, num_rows, prior_num_rows, unordered); // Throws
+    return true;
+}
+
+inline bool ChangeSetBuilder::Observer::clear_table()
+{
+    if (in_subtable())
+        return modify(m_subtable_col_ndx, m_subtable_row_ndx); // Throws
+    if (TableBuilder* t = table()) // Throws
+        t->clear();
+    return true;
+}
+
+inline bool ChangeSetBuilder::Observer::modify(std::size_t col_ndx, std::size_t row_ndx)
+{
+    if (in_subtable()) {
+        col_ndx = m_subtable_col_ndx;
+        row_ndx = m_subtable_row_ndx;
+    }
+    if (TableBuilder* t = table()) // Throws
+        t->modify(row_ndx, col_ndx); // Throws
+    return true;
+}
+
+inline bool ChangeSetBuilder::Observer::insert_column(std::size_t col_ndx)
+{
+    if (in_subtable() || m_is_subdescriptor)
+        return schema(); // Throws
+    if (TableBuilder* t = table()) // Throws
+        t->insert_column(col_ndx); // Throws
+    return true;
+}
+
+inline bool ChangeSetBuilder::Observer::erase_column(std::size_t col_ndx)
+{
+    if (in_subtable() || m_is_subdescriptor)
+        return schema(); // Throws
+    if (TableBuilder* t = table()) // Throws
+        t->erase_column(col_ndx);
+    return true;
+}
+
+inline bool ChangeSetBuilder::Observer::schema()
+{
+    if (TableBuilder* t = table()) // Throws
+        t->mark_schema();
+    return true;
+}
+
+inline bool ChangeSetBuilder::Observer::link_list()
+{
+    return modify(m_link_list_col_ndx, m_link_list_row_ndx); // Throws
+}
+
+} // namespace realm
+
+#endif // REALM_CHANGE_SET_HPP
@@ -0,0 +1,164 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_COLLATION_KEY_HPP
+#define REALM_COLLATION_KEY_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <realm/unicode.hpp>
+
+namespace realm {
+
+/// Binary comparable sort keys for strings.
+///
+/// With the core string compare method (STRING_COMPARE_CORE, see
+/// set_string_compare_method()), utf8_compare() decodes both strings one
+/// character at a time, and orders the first pair of differing characters by
+/// the collation table if both are in the range 0...591 (up to 'Latin
+/// Extended 2'), and by their Unicode value otherwise. A string that is a
+/// prefix of another one comes first.
+///
+/// A collation key encodes each character of a string as a 3-byte big-endian
+/// weight: its rank in the collation table for characters up to 591, and the
+/// Unicode value itself for characters above. Ranks are below 592, so this
+/// reproduces both cases of the comparison above, and comparing two keys with
+/// compare_collation_keys() (memcmp(), then length) gives the same result as
+/// utf8_compare() on the original strings. Sorting by keys built once per row
+/// therefore avoids decoding UTF-8 on every comparison.
+///
+/// The weights are derived once per process by ordering the characters of the
+/// table range with utf8_compare() itself, so they always agree with the
+/// table compiled into the core library.
+///
+/// Keys are only meaningful with STRING_COMPARE_CORE, because the other
+/// methods delegate to the platform or to a callback. Check
+/// collation_keys_available() before relying on them.
+bool collation_keys_available() REALM_NOEXCEPT;
+
+/// Append the collation key of \a value to \a key.
+void append_collation_key(StringData value, std::string& key);
+
+/// Returns true if the string whose key is \a a sorts before the string
+/// whose key is \a b.
+bool compare_collation_keys(const char* a, std::size_t a_size,
+                            const char* b, std::size_t b_size) REALM_NOEXCEPT;
+
+
+
+
+// Implementation:
+
+namespace _impl {
+
+class CollationWeights {
+public:
+    // Last character covered by the collation table of utf8_compare()
+    static const uint32_t last_table_char = 591;
+
+    static const CollationWeights& get()
+    {
+        static const CollationWeights weights; // Throws
+        return weights;
+    }
+
+    uint32_t weight(uint32_t c) const REALM_NOEXCEPT
+    {
+        return c <= last_table_char ? m_rank[c] : c;
+    }
+
+private:
+    uint32_t m_rank[last_table_char + 1];
+
+    static std::size_t encode(uint32_t c, char* buf) REALM_NOEXCEPT
+    {
+        if (c < 0x80) {
+            buf[0] = char(c);
+            return 1;
+        }
+        buf[0] = char(0xC0 | (c >> 6));
+        buf[1] = char(0x80 | (c & 0x3F));
+        return 2;
+    }
+
+    CollationWeights()
+    {
+        std::vector<uint32_t> chars(last_table_char + 1);
+        for (uint32_t c = 0; c <= last_table_char; ++c)
+            chars[c] = c;
+        auto less = [](uint32_t a, uint32_t b) {
+            char buf_a[2], buf_b[2];
+            StringData s_a(buf_a, encode(a, buf_a));
+            StringData s_b(buf_b, encode(b, buf_b));
+            return utf8_compare(s_a, s_b);
+        };
+        std::stable_sort(chars.begin(), chars.end(), less);
+
+        // Characters that compare equal share a rank
+        uint32_t rank = 0;
+        for (std::size_t i = 0; i < chars.size(); ++i) {
+            if (i > 0 && less(chars[i - 1], chars[i]))
+                ++rank;
+            m_rank[chars[i]] = rank;
+        }
+    }
+};
+
+} // namespace _impl
+
+inline bool collation_keys_available() REALM_NOEXCEPT
+{
+    return string_compare_method == STRING_COMPARE_CORE;
+}
+
+inline void append_collation_key(StringData value, std::string& key)
+{
+    const _impl::CollationWeights& weights = _impl::CollationWeights::get(); // Throws
+    const char* p = value.data();
+    const char* end = p + value.size();
+    while (p < end) {
+        std::size_t n = sequence_length(*p);
+        uint32_t w;
+        if (n == 0 || n > std::size_t(end - p)) {
+            // Invalid or truncated UTF-8, weigh the byte itself
+            w = static_cast<unsigned char>(*p);
+            n = 1;
+        }
+        else {
+            w = weights.weight(utf8value(p));
+        }
+        char buf[3] = { char(w >> 16), char(w >> 8), char(w) };
+        key.append(buf, 3); // Throws
+        p += n;
+    }
+}
+
+inline bool compare_collation_keys(const char* a, std::size_t a_size,
+                                   const char* b, std::size_t b_size) REALM_NOEXCEPT
+{
+    int c = std::memcmp(a, b, std::min(a_size, b_size));
+    return c < 0 || (c == 0 && a_size < b_size);
+}
+
+} // namespace realm
+
+#endif // REALM_COLLATION_KEY_HPP
@@ -0,0 +1,148 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_DISTINCT_FILTER_HPP
+#define REALM_DISTINCT_FILTER_HPP
+
+#include <thread>
+#include <vector>
+
+#include <realm/group_by.hpp>
+#include <realm/table.hpp>
+#include <realm/table_view.hpp>
+#include <realm/query.hpp>
+
+namespace realm {
+
+/// Reduce a table view to one row per distinct combination of values in a
+/// set of columns.
+///
+/// Table::get_distinct_view() and TableViewBase::sync_distinct_view() handle
+/// a single column, and require a search index on it. This filter handles
+/// any number of columns of the types supported as GroupBy keys (Int, Bool,
+/// DateTime, Float, Double, String and Link), without an index, by hashing
+/// the values of each row (see GroupBy):
+///
+///     DistinctFilter distinct({source_col, external_id_col});
+///     TableView view = distinct.find_all(table->where().equal(kind_col, 2));
+///     ...
+///     distinct.sync_if_needed(view);
+///
+/// Of each set of equal rows, the one that comes first in the view is kept,
+/// and the view keeps its order. A view that is sorted (also by SortEngine,
+/// which records its criteria on the view) therefore keeps the first row in
+/// sort order. Detached rows are removed.
+///
+/// The result is an ordinary table view, but TableViewBase::sync_if_needed()
+/// only re-runs the query and re-sorts. Use sync_if_needed() below to also
+/// reapply the filter.
+class DistinctFilter {
+public:
+    explicit DistinctFilter(std::vector<std::size_t> columns);
+
+    /// Number of threads used for views of at least
+    /// GroupBy::parallel_threshold rows. Defaults to the number of hardware
+    /// threads.
+    void set_num_threads(std::size_t num_threads) REALM_NOEXCEPT;
+
+    /// Remove the rows of the view whose values equal those of an earlier
+    /// row.
+    void apply(TableViewBase& view) const;
+
+    /// Bring the view in sync with its table (see
+    /// TableViewBase::sync_if_needed()), and reapply the filter if anything
+    /// changed. Returns true if the view was out of sync.
+    bool sync_if_needed(TableViewBase& view) const;
+
+    /// Distinct rows of the table, in table order.
+    TableView find_all(Table& table) const;
+
+    /// Distinct rows among the matches of the query.
+    TableView find_all(Query& query) const;
+
+private:
+    std::vector<std::size_t> m_columns;
+    std::size_t m_num_threads;
+};
+
+
+
+
+// Implementation:
+
+inline DistinctFilter::DistinctFilter(std::vector<std::size_t> columns):
+    m_columns(std::move(columns)),
+    m_num_threads(std::max(1u, std::thread::hardware_concurrency()))
+{
+    REALM_ASSERT(!m_columns.empty());
+}
+
+inline void DistinctFilter::set_num_threads(std::size_t num_threads) REALM_NOEXCEPT
+{
+    m_num_threads = std::max(std::size_t(1), num_threads);
+}
+
+inline void DistinctFilter::apply(TableViewBase& view) const
+{
+    if (!view.is_attached() || view.is_empty())
+        return;
+
+    GroupBy group_by(*view.m_table);
+    for (std::size_t column_ndx: m_columns)
+        group_by.add_key(column_ndx); // Throws
+    group_by.set_num_threads(m_num_threads);
+
+    // Groups are reported in order of their first row in the view
+    GroupByResult groups = group_by.run(view); // Throws
+    std::vector<std::size_t> rows(groups.size()); // Throws
+    for (std::size_t i = 0; i < groups.size(); ++i)
+        rows[i] = groups.get_first_row(i);
+
+    view.m_row_indexes.clear(); // Throws
+    for (std::size_t row_ndx: rows)
+        view.m_row_indexes.add(row_ndx); // Throws
+    view.m_num_detached_refs = 0;
+}
+
+inline bool DistinctFilter::sync_if_needed(TableViewBase& view) const
+{
+    if (view.is_in_sync())
+        return false;
+    view.sync_if_needed(); // Throws
+    apply(view); // Throws
+    return true;
+}
+
+inline TableView DistinctFilter::find_all(Table& table) const
+{
+    TableView view = table.where().find_all(); // Throws
+    apply(view); // Throws
+    return view;
+}
+
+inline TableView DistinctFilter::find_all(Query& query) const
+{
+    TableView view = query.find_all(); // Throws
+    apply(view); // Throws
+    return view;
+}
+
+} // namespace realm
+
+#endif // REALM_DISTINCT_FILTER_HPP
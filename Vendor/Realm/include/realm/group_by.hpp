@@ -0,0 +1,817 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_GROUP_BY_HPP
+#define REALM_GROUP_BY_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <thread>
+#include <vector>
+
+#include <realm/util/hash.hpp>
+#include <realm/util/thread.hpp>
+#include <realm/column_string_enum.hpp>
+#include <realm/mixed.hpp>
+#include <realm/table.hpp>
+#include <realm/table_view.hpp>
+#include <realm/query.hpp>
+
+namespace realm {
+
+class GroupByResult;
+
+
+/// Hash based GROUP BY over a table, a table view, or the result of a query.
+///
+/// Table::aggregate() groups by a single column and computes a single
+/// aggregate into a new table. This engine groups by any number of key
+/// columns, and computes any number of aggregates in the same pass:
+///
+///     GroupBy group_by(table);
+///     group_by.add_key(country_col);
+///     group_by.add_key(owner_col, owner_city_col); // Via link
+///     std::size_t total = group_by.add_aggregate(Table::aggr_sum, amount_col);
+///     std::size_t num = group_by.add_aggregate(Table::aggr_count);
+///     GroupByResult result = group_by.run(query);
+///
+/// A key is either a column of the table (Int, Bool, DateTime, Float, Double,
+/// String or Link), or a column of the target table of a link column, in
+/// which case rows with a null link form their own group. Each key value is
+/// reduced to a 64-bit code: strings of an enumerated column (see
+/// StringEnumColumn) use their index into the key list, which needs no
+/// verification, other strings use util::hash_bytes(), and groups whose
+/// hashes match are confirmed by comparing the strings. Groups live in an
+/// open addressing hash table with linear probing, keyed on the combined
+/// codes.
+///
+/// Inputs of at least parallel_threshold rows are split into slices which
+/// are aggregated by separate threads into partial results. The partial
+/// results are then merged in slice order, so groups are always reported in
+/// the order of their first row, whatever the number of threads.
+///
+/// Worker threads only read from the table, and from link target tables
+/// whose accessors are obtained before the threads start. The table must not
+/// be modified while run() is in progress, and the result refers to its rows.
+class GroupBy {
+public:
+    typedef Table::AggrType AggrType;
+
+    explicit GroupBy(const Table& table);
+
+    const Table& get_table() const REALM_NOEXCEPT { return *m_table; }
+
+    /// Group by the specified column. Returns the index of the key in the
+    /// result. Throws LogicError::type_mismatch if the column is not of one
+    /// of the key types listed above.
+    std::size_t add_key(std::size_t column_ndx);
+
+    /// Group by the value of \a target_column_ndx in the row that the link
+    /// column \a link_column_ndx points to. Throws LogicError::type_mismatch
+    /// if \a link_column_ndx is not a link column, or if the target column
+    /// is not of one of the key types.
+    std::size_t add_key(std::size_t link_column_ndx, std::size_t target_column_ndx);
+
+    /// Compute \a type over the specified column for every group. The column
+    /// may be omitted for aggr_count, which counts rows. Returns the index of
+    /// the aggregate in the result. Throws LogicError::type_mismatch if the
+    /// column is omitted for another aggregate, or if the aggregate cannot
+    /// be computed over its type (Int, DateTime, Float and Double, and Bool
+    /// for aggr_count).
+    std::size_t add_aggregate(AggrType type, std::size_t column_ndx = npos);
+
+    /// Number of threads used for inputs of at least parallel_threshold
+    /// rows. Defaults to the number of hardware threads.
+    void set_num_threads(std::size_t num_threads) REALM_NOEXCEPT;
+
+    static const std::size_t parallel_threshold = 1 << 16;
+
+    /// Null masks have two bits per key, one for a null value and one for a
+    /// null link.
+    static const std::size_t max_keys = 32;
+
+    /// Group all rows of the table.
+    GroupByResult run() const;
+
+    /// Group the rows of the view. Detached rows are skipped.
+    GroupByResult run(const TableViewBase& view) const;
+
+    /// Group the rows that match the query.
+    GroupByResult run(Query& query) const;
+
+private:
+    struct KeySpec {
+        std::size_t link_column_ndx; // npos if not through a link
+        std::size_t column_ndx;
+    };
+    struct AggrSpec {
+        AggrType type;
+        std::size_t column_ndx; // npos for a row count
+    };
+
+    // Key specification resolved against the current accessors
+    struct KeySource {
+        const Table* origin; // Grouped table
+        const Table* table; // Table that holds the value
+        std::size_t link_column_ndx;
+        std::size_t column_ndx;
+        DataType type;
+        bool is_nullable; // For types other than String and Link
+        const StringEnumColumn* enum_column;
+    };
+    struct AggrSource {
+        const Table* origin;
+        AggrType type;
+        std::size_t column_ndx;
+        DataType type_of_column;
+    };
+
+    struct AggrState {
+        int64_t count; // Number of values seen
+        int64_t int_value;
+        double value;
+    };
+
+    // Groups found in one slice of the input, in order of their first row
+    struct Partial {
+        std::size_t num_keys;
+        std::size_t num_aggregates;
+        std::vector<uint64_t> codes; // num_keys per group
+        std::vector<uint64_t> null_masks;
+        std::vector<uint64_t> hashes;
+        std::vector<std::size_t> first_rows;
+        std::vector<AggrState> states; // num_aggregates per group
+        std::vector<std::size_t> slots; // Open addressing, npos if empty
+
+        std::size_t size() const REALM_NOEXCEPT { return first_rows.size(); }
+        std::size_t add_group(const uint64_t* codes, uint64_t null_mask, uint64_t hash, std::size_t row_ndx);
+        void grow();
+    };
+
+    const Table* m_table;
+    std::vector<KeySpec> m_keys;
+    std::vector<AggrSpec> m_aggregates;
+    std::size_t m_num_threads;
+
+    std::vector<KeySource> resolve_keys() const;
+    std::vector<AggrSource> resolve_aggregates() const;
+
+    static bool is_key_type(DataType) REALM_NOEXCEPT;
+    static bool is_aggregate_type(AggrType, DataType type_of_column) REALM_NOEXCEPT;
+    static uint64_t hash_group(const uint64_t* codes, std::size_t num_keys, uint64_t null_mask) REALM_NOEXCEPT;
+    /// Translate a row of the grouped table to the row that holds the key
+    /// value. Returns false if the key is reached through a null link.
+    static bool get_value_row(const KeySource&, std::size_t& row_ndx) REALM_NOEXCEPT;
+    static bool same_strings(const std::vector<KeySource>&, std::size_t row_1, std::size_t row_2) REALM_NOEXCEPT;
+
+    /// Compute the key codes of the specified row. Returns the null mask.
+    static uint64_t get_codes(const std::vector<KeySource>&, std::size_t row_ndx, uint64_t* codes) REALM_NOEXCEPT;
+
+    /// Find the group of the specified key in \a partial, or add it.
+    static std::size_t find_or_add(Partial& partial, const std::vector<KeySource>&, const uint64_t* codes,
+                                   uint64_t null_mask, uint64_t hash, std::size_t row_ndx);
+
+    static void accumulate(const std::vector<AggrSource>&, std::size_t row_ndx, AggrState* states);
+    static void merge_states(const std::vector<AggrSource>&, const AggrState* from, AggrState* to) REALM_NOEXCEPT;
+
+    template<class R>
+    void aggregate_slice(const std::vector<KeySource>&, const std::vector<AggrSource>&,
+                         R row_at, std::size_t begin, std::size_t end, Partial& partial) const;
+
+    /// Aggregate the rows row_at(0) ... row_at(n-1).
+    template<class R> GroupByResult aggregate(R row_at, std::size_t n) const;
+
+    friend class GroupByResult;
+};
+
+
+/// The groups produced by GroupBy::run(), in the order of their first row.
+/// Key values are read from the table, so the result is only valid until the
+/// table is modified.
+class GroupByResult {
+public:
+    std::size_t size() const REALM_NOEXCEPT { return m_partial.size(); }
+    bool is_empty() const REALM_NOEXCEPT { return size() == 0; }
+
+    std::size_t get_num_keys() const REALM_NOEXCEPT { return m_keys.size(); }
+    std::size_t get_num_aggregates() const REALM_NOEXCEPT { return m_aggregates.size(); }
+
+    /// Index of the first row (in the table) that belongs to the group.
+    std::size_t get_first_row(std::size_t group_ndx) const REALM_NOEXCEPT;
+
+    /// Whether the key is null for the group, either because the value is
+    /// null, or because the key is reached through a null link.
+    bool is_null(std::size_t key_ndx, std::size_t group_ndx) const REALM_NOEXCEPT;
+
+    /// Whether the key is reached through a null link for the group. Rows
+    /// with a null link form a group of their own, apart from rows that link
+    /// to a row with a null value.
+    bool is_null_link(std::size_t key_ndx, std::size_t group_ndx) const REALM_NOEXCEPT;
+
+    /// Value of the key for the group. Link keys produce the index of the
+    /// target row. Null keys produce Mixed().
+    Mixed get_key(std::size_t key_ndx, std::size_t group_ndx) const REALM_NOEXCEPT;
+
+    /// Value of the aggregate for the group. Counts produce an int. Sums
+    /// produce an int for integer columns and a double otherwise, averages
+    /// always produce a double, and minimum and maximum have the type of the
+    /// column. An aggregate over no values produces 0.
+    Mixed get_aggregate(std::size_t aggr_ndx, std::size_t group_ndx) const REALM_NOEXCEPT;
+
+    /// Number of values that the aggregate is computed from.
+    std::size_t get_count(std::size_t aggr_ndx, std::size_t group_ndx) const REALM_NOEXCEPT;
+
+private:
+    std::vector<GroupBy::KeySource> m_keys;
+    std::vector<GroupBy::AggrSource> m_aggregates;
+    GroupBy::Partial m_partial;
+
+    const GroupBy::AggrState& get_state(std::size_t aggr_ndx, std::size_t group_ndx) const REALM_NOEXCEPT;
+
+    friend class GroupBy;
+};
+
+
+
+
+// Implementation:
+
+inline GroupBy::GroupBy(const Table& table):
+    m_table(&table),
+    m_num_threads(std::max(1u, std::thread::hardware_concurrency()))
+{
+}
+
+inline bool GroupBy::is_key_type(DataType type) REALM_NOEXCEPT
+{
+    return type == type_Int || type == type_Bool || type == type_DateTime || type == type_Float ||
+        type == type_Double || type == type_String || type == type_Link;
+}
+
+inline bool GroupBy::is_aggregate_type(AggrType type, DataType type_of_column) REALM_NOEXCEPT
+{
+    return type_of_column == type_Int || type_of_column == type_DateTime ||
+        type_of_column == type_Float || type_of_column == type_Double ||
+        (type_of_column == type_Bool && type == Table::aggr_count);
+}
+
+inline std::size_t GroupBy::add_key(std::size_t column_ndx)
+{
+    REALM_ASSERT_3(column_ndx, <, m_table->get_column_count());
+    REALM_ASSERT_3(m_keys.size(), <, max_keys);
+    if (!is_key_type(m_table->get_column_type(column_ndx)))
+        throw LogicError(LogicError::type_mismatch);
+    KeySpec key = { npos, column_ndx };
+    m_keys.push_back(key); // Throws
+    return m_keys.size() - 1;
+}
+
+inline std::size_t GroupBy::add_key(std::size_t link_column_ndx, std::size_t target_column_ndx)
+{
+    REALM_ASSERT_3(link_column_ndx, <, m_table->get_column_count());
+    REALM_ASSERT_3(m_keys.size(), <, max_keys);
+    if (m_table->get_column_type(link_column_ndx) != type_Link)
+        throw LogicError(LogicError::type_mismatch);
+    ConstTableRef target = m_table->get_link_target(link_column_ndx);
+    REALM_ASSERT_3(target_column_ndx, <, target->get_column_count());
+    if (!is_key_type(target->get_column_type(target_column_ndx)))
+        throw LogicError(LogicError::type_mismatch);
+    KeySpec key = { link_column_ndx, target_column_ndx };
+    m_keys.push_back(key); // Throws
+    return m_keys.size() - 1;
+}
+
+inline std::size_t GroupBy::add_aggregate(AggrType type, std::size_t column_ndx)
+{
+    if (column_ndx == npos) {
+        if (type != Table::aggr_count)
+            throw LogicError(LogicError::type_mismatch);
+    }
+    else {
+        REALM_ASSERT_3(column_ndx, <, m_table->get_column_count());
+        if (!is_aggregate_type(type, m_table->get_column_type(column_ndx)))
+            throw LogicError(LogicError::type_mismatch);
+    }
+    AggrSpec aggr = { type, column_ndx };
+    m_aggregates.push_back(aggr); // Throws
+    return m_aggregates.size() - 1;
+}
+
+inline void GroupBy::set_num_threads(std::size_t num_threads) REALM_NOEXCEPT
+{
+    m_num_threads = std::max(std::size_t(1), num_threads);
+}
+
+inline std::vector<GroupBy::KeySource> GroupBy::resolve_keys() const
+{
+    std::vector<KeySource> keys;
+    for (const KeySpec& spec: m_keys) {
+        KeySource key;
+        key.origin = m_table;
+        key.table = m_table;
+        if (spec.link_column_ndx != npos)
+            key.table = _impl::TableFriend::get_link_target_table_accessor(*m_table, spec.link_column_ndx);
+        key.link_column_ndx = spec.link_column_ndx;
+        key.column_ndx = spec.column_ndx;
+        key.type = key.table->get_column_type(spec.column_ndx);
+        REALM_ASSERT(is_key_type(key.type));
+        key.is_nullable = false;
+        key.enum_column = nullptr;
+        if (key.type == type_String) {
+            const ColumnBase& column = _impl::TableFriend::get_column(*key.table, spec.column_ndx);
+            key.enum_column = dynamic_cast<const StringEnumColumn*>(&column);
+        }
+        else if (key.type != type_Link) {
+            key.is_nullable = key.table->is_nullable(spec.column_ndx);
+        }
+        keys.push_back(key); // Throws
+    }
+    return keys;
+}
+
+inline std::vector<GroupBy::AggrSource> GroupBy::resolve_aggregates() const
+{
+    std::vector<AggrSource> aggregates;
+    for (const AggrSpec& spec: m_aggregates) {
+        AggrSource aggr;
+        aggr.origin = m_table;
+        aggr.type = spec.type;
+        aggr.column_ndx = spec.column_ndx;
+        aggr.type_of_column = type_Int;
+        if (spec.column_ndx != npos) {
+            aggr.type_of_column = m_table->get_column_type(spec.column_ndx);
+            REALM_ASSERT(is_aggregate_type(spec.type, aggr.type_of_column));
+        }
+        aggregates.push_back(aggr); // Throws
+    }
+    return aggregates;
+}
+
+inline uint64_t GroupBy::hash_group(const uint64_t* codes, std::size_t num_keys,
+                                    uint64_t null_mask) REALM_NOEXCEPT
+{
+    uint64_t h = util::hash_mix(null_mask);
+    for (std::size_t i = 0; i < num_keys; ++i)
+        h = util::hash_combine(h, codes[i]);
+    return h;
+}
+
+inline bool GroupBy::get_value_row(const KeySource& key, std::size_t& row_ndx) REALM_NOEXCEPT
+{
+    if (key.link_column_ndx == npos)
+        return true;
+    if (key.origin->is_null_link(key.link_column_ndx, row_ndx))
+        return false;
+    row_ndx = key.origin->get_link(key.link_column_ndx, row_ndx);
+    return true;
+}
+
+inline uint64_t GroupBy::get_codes(const std::vector<KeySource>& keys, std::size_t row_ndx,
+                                   uint64_t* codes) REALM_NOEXCEPT
+{
+    uint64_t null_mask = 0;
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        const KeySource& key = keys[i];
+        std::size_t ndx = row_ndx;
+        codes[i] = 0;
+        if (!get_value_row(key, ndx)) {
+            null_mask |= (uint64_t(1) << i) | (uint64_t(1) << (max_keys + i)); // Null link
+            continue;
+        }
+        if (key.is_nullable && key.table->is_null(key.column_ndx, ndx)) {
+            null_mask |= uint64_t(1) << i;
+            continue;
+        }
+        switch (key.type) {
+            case type_Int:
+                codes[i] = uint64_t(key.table->get_int(key.column_ndx, ndx));
+                break;
+            case type_Bool:
+                codes[i] = key.table->get_bool(key.column_ndx, ndx);
+                break;
+            case type_DateTime:
+                codes[i] = uint64_t(key.table->get_datetime(key.column_ndx, ndx).get_datetime());
+                break;
+            case type_Float: {
+                float v = key.table->get_float(key.column_ndx, ndx);
+                uint32_t bits = 0;
+                if (v != 0) // Same code for 0.0 and -0.0
+                    std::memcpy(&bits, &v, sizeof bits);
+                codes[i] = bits;
+                break;
+            }
+            case type_Double: {
+                double v = key.table->get_double(key.column_ndx, ndx);
+                uint64_t bits = 0;
+                if (v != 0)
+                    std::memcpy(&bits, &v, sizeof bits);
+                codes[i] = bits;
+                break;
+            }
+            case type_Link:
+                if (key.table->is_null_link(key.column_ndx, ndx)) {
+                    null_mask |= uint64_t(1) << i;
+                }
+                else {
+                    codes[i] = key.table->get_link(key.column_ndx, ndx);
+                }
+                break;
+            case type_String:
+                if (key.enum_column) {
+                    // Index into the key list, which is unique per distinct
+                    // string
+                    codes[i] = uint64_t(key.enum_column->IntegerColumn::get(ndx));
+                    if (key.enum_column->is_null(ndx))
+                        null_mask |= uint64_t(1) << i;
+                }
+                else {
+                    StringData v = key.table->get_string(key.column_ndx, ndx);
+                    if (v.is_null()) {
+                        null_mask |= uint64_t(1) << i;
+                    }
+                    else {
+                        codes[i] = util::hash_bytes(v.data(), v.size());
+                    }
+                }
+                break;
+            default:
+                REALM_ASSERT(false);
+        }
+    }
+    return null_mask;
+}
+
+inline bool GroupBy::same_strings(const std::vector<KeySource>& keys, std::size_t row_1,
+                                  std::size_t row_2) REALM_NOEXCEPT
+{
+    // Only called for rows with equal codes and null masks, so either both
+    // links are null or neither is
+    for (const KeySource& key: keys) {
+        if (key.type != type_String || key.enum_column)
+            continue;
+        std::size_t ndx_1 = row_1, ndx_2 = row_2;
+        if (!get_value_row(key, ndx_1) || !get_value_row(key, ndx_2))
+            continue;
+        if (key.table->get_string(key.column_ndx, ndx_1) != key.table->get_string(key.column_ndx, ndx_2))
+            return false;
+    }
+    return true;
+}
+
+inline std::size_t GroupBy::Partial::add_group(const uint64_t* group_codes, uint64_t null_mask,
+                                               uint64_t hash, std::size_t row_ndx)
+{
+    codes.insert(codes.end(), group_codes, group_codes + num_keys); // Throws
+    null_masks.push_back(null_mask); // Throws
+    hashes.push_back(hash); // Throws
+    first_rows.push_back(row_ndx); // Throws
+    AggrState state = { 0, 0, 0 };
+    states.insert(states.end(), num_aggregates, state); // Throws
+    return first_rows.size() - 1;
+}
+
+inline void GroupBy::Partial::grow()
+{
+    // Keep the load factor at or below 1/2
+    std::size_t capacity = std::max(std::size_t(16), slots.size() * 2);
+    slots.assign(capacity, npos); // Throws
+    std::size_t mask = capacity - 1;
+    for (std::size_t group_ndx = 0; group_ndx < size(); ++group_ndx) {
+        std::size_t i = std::size_t(hashes[group_ndx]) & mask;
+        while (slots[i] != npos)
+            i = (i + 1) & mask;
+        slots[i] = group_ndx;
+    }
+}
+
+inline std::size_t GroupBy::find_or_add(Partial& partial, const std::vector<KeySource>& keys,
+                                        const uint64_t* codes, uint64_t null_mask, uint64_t hash,
+                                        std::size_t row_ndx)
+{
+    std::size_t num_keys = partial.num_keys;
+    if (partial.size() * 2 >= partial.slots.size())
+        partial.grow(); // Throws
+    std::size_t mask = partial.slots.size() - 1;
+    std::size_t i = std::size_t(hash) & mask;
+    for (;;) {
+        std::size_t group_ndx = partial.slots[i];
+        if (group_ndx == npos)
+            break;
+        if (partial.hashes[group_ndx] == hash && partial.null_masks[group_ndx] == null_mask &&
+            std::equal(codes, codes + num_keys, partial.codes.begin() + group_ndx * num_keys) &&
+            same_strings(keys, partial.first_rows[group_ndx], row_ndx))
+            return group_ndx;
+        i = (i + 1) & mask;
+    }
+    std::size_t group_ndx = partial.add_group(codes, null_mask, hash, row_ndx); // Throws
+    partial.slots[i] = group_ndx;
+    return group_ndx;
+}
+
+inline void GroupBy::accumulate(const std::vector<AggrSource>& aggregates, std::size_t row_ndx,
+                                AggrState* states)
+{
+    const Table* table = nullptr;
+    for (std::size_t i = 0; i < aggregates.size(); ++i) {
+        const AggrSource& aggr = aggregates[i];
+        AggrState& state = states[i];
+        if (aggr.column_ndx == npos) {
+            ++state.count;
+            continue;
+        }
+        if (!table)
+            table = aggr.origin;
+        if (table->is_null(aggr.column_ndx, row_ndx))
+            continue;
+        bool is_first = state.count++ == 0;
+        if (aggr.type == Table::aggr_count)
+            continue;
+        if (aggr.type_of_column == type_Int || aggr.type_of_column == type_DateTime) {
+            int64_t v = aggr.type_of_column == type_Int ? table->get_int(aggr.column_ndx, row_ndx) :
+                int64_t(table->get_datetime(aggr.column_ndx, row_ndx).get_datetime());
+            switch (aggr.type) {
+                case Table::aggr_sum:
+                case Table::aggr_avg:
+                    state.int_value += v;
+                    break;
+                case Table::aggr_min:
+                    if (is_first || v < state.int_value)
+                        state.int_value = v;
+                    break;
+                case Table::aggr_max:
+                    if (is_first || v > state.int_value)
+                        state.int_value = v;
+                    break;
+                case Table::aggr_count:
+                    break;
+            }
+        }
+        else {
+            double v = aggr.type_of_column == type_Float ? double(table->get_float(aggr.column_ndx, row_ndx)) :
+                table->get_double(aggr.column_ndx, row_ndx);
+            switch (aggr.type) {
+                case Table::aggr_sum:
+                case Table::aggr_avg:
+                    state.value += v;
+                    break;
+                case Table::aggr_min:
+                    if (is_first || v < state.value)
+                        state.value = v;
+                    break;
+                case Table::aggr_max:
+                    if (is_first || v > state.value)
+                        state.value = v;
+                    break;
+                case Table::aggr_count:
+                    break;
+            }
+        }
+    }
+}
+
+inline void GroupBy::merge_states(const std::vector<AggrSource>& aggregates, const AggrState* from,
+                                  AggrState* to) REALM_NOEXCEPT
+{
+    for (std::size_t i = 0; i < aggregates.size(); ++i) {
+        const AggrState& a = from[i];
+        AggrState& b = to[i];
+        if (a.count == 0)
+            continue;
+        bool is_first = b.count == 0;
+        b.count += a.count;
+        switch (aggregates[i].type) {
+            case Table::aggr_count:
+                break;
+            case Table::aggr_sum:
+            case Table::aggr_avg:
+                b.int_value += a.int_value;
+                b.value += a.value;
+                break;
+            case Table::aggr_min:
+                if (is_first || a.int_value < b.int_value)
+                    b.int_value = a.int_value;
+                if (is_first || a.value < b.value)
+                    b.value = a.value;
+                break;
+            case Table::aggr_max:
+                if (is_first || a.int_value > b.int_value)
+                    b.int_value = a.int_value;
+                if (is_first || a.value > b.value)
+                    b.value = a.value;
+                break;
+        }
+    }
+}
+
+template<class R>
+void GroupBy::aggregate_slice(const std::vector<KeySource>& keys, const std::vector<AggrSource>& aggregates,
+                              R row_at, std::size_t begin, std::size_t end, Partial& partial) const
+{
+    std::size_t num_keys = keys.size();
+    std::size_t num_aggregates = aggregates.size();
+    partial.num_keys = num_keys;
+    partial.num_aggregates = num_aggregates;
+    std::vector<uint64_t> codes(std::max(num_keys, std::size_t(1))); // Throws
+    for (std::size_t i = begin; i < end; ++i) {
+        std::size_t row_ndx = row_at(i);
+        if (row_ndx == detached_ref)
+            continue;
+        uint64_t null_mask = get_codes(keys, row_ndx, codes.data());
+        uint64_t hash = hash_group(codes.data(), num_keys, null_mask);
+        std::size_t group_ndx = find_or_add(partial, keys, codes.data(), null_mask, hash, row_ndx); // Throws
+        accumulate(aggregates, row_ndx, partial.states.data() + group_ndx * num_aggregates);
+    }
+}
+
+template<class R> GroupByResult GroupBy::aggregate(R row_at, std::size_t n) const
+{
+    GroupByResult result;
+    result.m_keys = resolve_keys(); // Throws
+    result.m_aggregates = resolve_aggregates(); // Throws
+    const std::vector<KeySource>& keys = result.m_keys;
+    const std::vector<AggrSource>& aggregates = result.m_aggregates;
+
+    std::size_t num_slices = std::min(m_num_threads, n / (parallel_threshold / 4) + 1);
+    if (n < parallel_threshold || num_slices < 2) {
+        aggregate_slice(keys, aggregates, row_at, 0, n, result.m_partial); // Throws
+        return result;
+    }
+
+    // Partial aggregation, one slice per thread. Exceptions are carried back
+    // to this thread.
+    std::vector<Partial> partials(num_slices); // Throws
+    std::vector<std::exception_ptr> errors(num_slices); // Throws
+    {
+        std::vector<util::Thread> threads(num_slices - 1);
+        for (std::size_t i = 0; i < num_slices; ++i) {
+            std::size_t begin = n * i / num_slices;
+            std::size_t end = n * (i + 1) / num_slices;
+            Partial* partial = &partials[i];
+            std::exception_ptr* error = &errors[i];
+            auto work = [=, &keys, &aggregates] {
+                try {
+                    aggregate_slice(keys, aggregates, row_at, begin, end, *partial); // Throws
+                }
+                catch (...) {
+                    *error = std::current_exception();
+                }
+            };
+            if (i == 0) {
+                work();
+            }
+            else {
+                threads[i - 1].start(work);
+            }
+        }
+        for (util::Thread& t: threads)
+            t.join();
+    }
+    for (const std::exception_ptr& error: errors) {
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    // Merge in slice order, so that groups keep the order of their first row
+    Partial& merged = result.m_partial;
+    merged = std::move(partials[0]);
+    std::size_t num_keys = keys.size();
+    std::size_t num_aggregates = aggregates.size();
+    for (std::size_t i = 1; i < num_slices; ++i) {
+        const Partial& partial = partials[i];
+        for (std::size_t j = 0; j < partial.size(); ++j) {
+            const uint64_t* codes = partial.codes.data() + j * num_keys;
+            std::size_t group_ndx = find_or_add(merged, keys, codes, partial.null_masks[j],
+                                                partial.hashes[j], partial.first_rows[j]); // Throws
+            merge_states(aggregates, partial.states.data() + j * num_aggregates,
+                         merged.states.data() + group_ndx * num_aggregates);
+        }
+    }
+    return result;
+}
+
+inline GroupByResult GroupBy::run() const
+{
+    return aggregate([](std::size_t i) { return i; }, m_table->size()); // Throws
+}
+
+inline GroupByResult GroupBy::run(const TableViewBase& view) const
+{
+    REALM_ASSERT(view.m_table.get() == m_table);
+    return aggregate([&view](std::size_t i) { return view.get_source_ndx(i); }, view.size()); // Throws
+}
+
+inline GroupByResult GroupBy::run(Query& query) const
+{
+    TableView view = query.find_all(); // Throws
+    return run(view); // Throws
+}
+
+
+inline std::size_t GroupByResult::get_first_row(std::size_t group_ndx) const REALM_NOEXCEPT
+{
+    REALM_ASSERT_3(group_ndx, <, size());
+    return m_partial.first_rows[group_ndx];
+}
+
+inline bool GroupByResult::is_null(std::size_t key_ndx, std::size_t group_ndx) const REALM_NOEXCEPT
+{
+    REALM_ASSERT_3(key_ndx, <, m_keys.size());
+    REALM_ASSERT_3(group_ndx, <, size());
+    return (m_partial.null_masks[group_ndx] >> key_ndx) & 1;
+}
+
+inline bool GroupByResult::is_null_link(std::size_t key_ndx, std::size_t group_ndx) const REALM_NOEXCEPT
+{
+    REALM_ASSERT_3(key_ndx, <, m_keys.size());
+    REALM_ASSERT_3(group_ndx, <, size());
+    return (m_partial.null_masks[group_ndx] >> (GroupBy::max_keys + key_ndx)) & 1;
+}
+
+inline Mixed GroupByResult::get_key(std::size_t key_ndx, std::size_t group_ndx) const REALM_NOEXCEPT
+{
+    if (is_null(key_ndx, group_ndx))
+        return Mixed();
+    const GroupBy::KeySource& key = m_keys[key_ndx];
+    std::size_t row_ndx = get_first_row(group_ndx);
+    GroupBy::get_value_row(key, row_ndx);
+    switch (key.type) {
+        case type_Int:
+            return Mixed(key.table->get_int(key.column_ndx, row_ndx));
+        case type_Bool:
+            return Mixed(key.table->get_bool(key.column_ndx, row_ndx));
+        case type_DateTime:
+            return Mixed(key.table->get_datetime(key.column_ndx, row_ndx));
+        case type_Float:
+            return Mixed(key.table->get_float(key.column_ndx, row_ndx));
+        case type_Double:
+            return Mixed(key.table->get_double(key.column_ndx, row_ndx));
+        case type_Link:
+            return Mixed(int64_t(key.table->get_link(key.column_ndx, row_ndx)));
+        case type_String:
+            return Mixed(key.table->get_string(key.column_ndx, row_ndx));
+        default:
+            break;
+    }
+    REALM_ASSERT(false);
+    return Mixed();
+}
+
+inline const GroupBy::AggrState& GroupByResult::get_state(std::size_t aggr_ndx,
+                                                          std::size_t group_ndx) const REALM_NOEXCEPT
+{
+    REALM_ASSERT_3(aggr_ndx, <, m_aggregates.size());
+    REALM_ASSERT_3(group_ndx, <, size());
+    return m_partial.states[group_ndx * m_aggregates.size() + aggr_ndx];
+}
+
+inline std::size_t GroupByResult::get_count(std::size_t aggr_ndx, std::size_t group_ndx) const REALM_NOEXCEPT
+{
+    return std::size_t(get_state(aggr_ndx, group_ndx).count);
+}
+
+inline Mixed GroupByResult::get_aggregate(std::size_t aggr_ndx, std::size_t group_ndx) const REALM_NOEXCEPT
+{
+    const GroupBy::AggrState& state = get_state(aggr_ndx, group_ndx);
+    const GroupBy::AggrSource& aggr = m_aggregates[aggr_ndx];
+    bool is_int = aggr.type_of_column == type_Int || aggr.type_of_column == type_DateTime;
+    switch (aggr.type) {
+        case Table::aggr_count:
+            return Mixed(state.count);
+        case Table::aggr_avg:
+            if (state.count == 0)
+                return Mixed(0.0);
+            return Mixed((is_int ? double(state.int_value) : state.value) / state.count);
+        case Table::aggr_sum:
+            return is_int ? Mixed(state.int_value) : Mixed(state.value);
+        case Table::aggr_min:
+        case Table::aggr_max:
+            if (aggr.type_of_column == type_DateTime)
+                return Mixed(DateTime(state.int_value));
+            if (aggr.type_of_column == type_Float)
+                return Mixed(float(state.value));
+            return is_int ? Mixed(state.int_value) : Mixed(state.value);
+    }
+    REALM_ASSERT(false);
+    return Mixed();
+}
+
+} // namespace realm
+
+#endif // REALM_GROUP_BY_HPP
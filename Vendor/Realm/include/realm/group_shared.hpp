@@ -994,6 +994,27 @@ public:
         return sg.m_group;
     }
 
+    static bool is_reading(const SharedGroup& sg) REALM_NOEXCEPT
+    {
+        return sg.m_transact_stage == SharedGroup::transact_Reading;
+    }
+
+    static util::Mutex& get_handover_lock(SharedGroup& sg) REALM_NOEXCEPT
+    {
+        return sg.m_handover_lock;
+    }
+
+    /// The version and file size of the snapshot bound by the current read
+    /// transaction.
+    static SharedGroup::version_type get_read_version(const SharedGroup& sg) REALM_NOEXCEPT
+    {
+        return sg.m_readlock.m_version;
+    }
+    static std::size_t get_read_file_size(const SharedGroup& sg) REALM_NOEXCEPT
+    {
+        return sg.m_readlock.m_file_size;
+    }
+
     template<class O>
     static void advance_read(SharedGroup& sg, History& hist, O* obs, SharedGroup::VersionID ver)
     {
@@ -0,0 +1,277 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_HANDOVER_BATCH_HPP
+#define REALM_HANDOVER_BATCH_HPP
+
+#include <memory>
+#include <vector>
+
+#include <realm/util/thread.hpp>
+#include <realm/handover_defs.hpp>
+#include <realm/link_view.hpp>
+#include <realm/group_shared.hpp>
+#include <realm/lang_bind_helper.hpp>
+
+namespace realm {
+
+/// Hands over many accessors (table views, queries, link views, rows)
+/// between shared groups in one step.
+///
+/// SharedGroup::export_for_handover() takes the handover lock and looks up
+/// the version for each accessor, and every Handover must be imported on its
+/// own, by a shared group that already views exactly that version. A batch
+/// is exported under a single lock and tied to a single version, and it is
+/// imported in one step, which first advances the importing shared group to
+/// that version when a history is given:
+///
+///     // Background thread
+///     HandoverBatch batch;
+///     std::vector<HandoverBatch::Ticket<TableView>> tickets;
+///     {
+///         HandoverBatch::Exporter exporter(batch, sg);
+///         for (TableView& tv : results)
+///             tickets.push_back(exporter.add(tv, MutableSourcePayload::Move));
+///     }
+///     // ... pass batch and tickets to the UI thread ...
+///
+///     // UI thread
+///     batch.import(ui_sg, &ui_history);
+///     for (auto& ticket : tickets)
+///         show(batch.take(ticket));
+///
+/// The version of the batch must still be available when the batch is
+/// imported, or the advance throws SharedGroup::BadVersion. Either the
+/// exporting shared group stays in its read transaction until the batch has
+/// been imported, or the batch is given a pin that holds a read lock on the
+/// version instead (see set_pin()).
+///
+/// The same transitivity and payload rules as for
+/// SharedGroup::export_for_handover() apply to each accessor.
+class HandoverBatch {
+public:
+    /// Identifies an accessor in the batch, and its type.
+    template<class T> class Ticket {
+    public:
+        Ticket() REALM_NOEXCEPT {}
+    private:
+        std::size_t m_ndx = npos;
+        explicit Ticket(std::size_t ndx) REALM_NOEXCEPT: m_ndx(ndx) {}
+        friend class HandoverBatch;
+    };
+
+    class Exporter;
+
+    /// Keeps the version of a batch available, typically by holding a read
+    /// transaction on it.
+    class Pin {
+    public:
+        virtual ~Pin() REALM_NOEXCEPT {}
+    };
+
+    HandoverBatch() REALM_NOEXCEPT {}
+    HandoverBatch(HandoverBatch&&) = default;
+    HandoverBatch& operator=(HandoverBatch&&) = default;
+
+    std::size_t size() const REALM_NOEXCEPT { return m_entries.size(); }
+    bool empty() const REALM_NOEXCEPT { return m_entries.empty(); }
+
+    /// The version that the accessors were exported from.
+    SharedGroup::VersionID get_version() const REALM_NOEXCEPT { return m_version; }
+
+    /// Attach every accessor in the batch to the importing shared group,
+    /// which must be in a read transaction. If it views an older version
+    /// than the batch, and a history is given, it is advanced to the version
+    /// of the batch first, once for the whole batch.
+    ///
+    /// \throw SharedGroup::BadVersion If the shared group views a different
+    /// version than the batch, and cannot be advanced to it.
+    void import(SharedGroup&, History* = nullptr);
+
+    /// Hold \a pin until the batch has been imported, or is destroyed.
+    void set_pin(std::unique_ptr<Pin> pin) REALM_NOEXCEPT { m_pin = std::move(pin); }
+    const Pin* get_pin() const REALM_NOEXCEPT { return m_pin.get(); }
+
+    /// Take an imported accessor out of the batch. Each accessor can be
+    /// taken once.
+    template<class T> std::unique_ptr<T> take(Ticket<T>);
+    LinkViewRef take(Ticket<LinkView>);
+
+private:
+    struct Entry {
+        virtual ~Entry() REALM_NOEXCEPT {}
+        virtual void apply(Group&) = 0;
+    };
+    template<class T> struct TypedEntry: Entry {
+        std::unique_ptr<typename T::Handover_patch> patch;
+        std::unique_ptr<T> clone;
+        void apply(Group& group) override
+        {
+            clone->apply_and_consume_patch(patch, group); // Throws
+        }
+    };
+
+    struct LinkViewEntry: Entry {
+        std::unique_ptr<LinkView::Handover_patch> patch;
+        LinkViewRef link_view;
+        void apply(Group& group) override
+        {
+            link_view = LinkView::create_from_and_consume_patch(patch, group); // Throws
+        }
+    };
+
+    std::vector<std::unique_ptr<Entry>> m_entries;
+    SharedGroup::VersionID m_version;
+    bool m_is_imported = false;
+    std::unique_ptr<Pin> m_pin;
+
+    template<class T, class E> Ticket<T> add(std::unique_ptr<E>);
+};
+
+
+/// Exports accessors into a batch. The handover lock of the shared group is
+/// held for the lifetime of the exporter, so advance_read(),
+/// promote_to_write(), and friends block until it is destroyed.
+class HandoverBatch::Exporter {
+public:
+    /// The shared group must be in a read transaction, and the batch must be
+    /// empty, or hold accessors exported from the same version.
+    Exporter(HandoverBatch&, SharedGroup&);
+    ~Exporter() REALM_NOEXCEPT {}
+
+    /// Export with payload copy or without payload.
+    template<class T> Ticket<T> add(const T& accessor, ConstSourcePayload);
+
+    /// Export with payload move.
+    template<class T> Ticket<T> add(T& accessor, MutableSourcePayload);
+
+    /// Export a row accessor.
+    template<class T> Ticket<BasicRow<T>> add(const BasicRow<T>& accessor);
+
+    /// Export a link view accessor.
+    Ticket<LinkView> add(const LinkViewRef& accessor);
+
+private:
+    HandoverBatch& m_batch;
+    util::LockGuard m_lock;
+};
+
+
+
+
+// Implementation:
+
+inline void HandoverBatch::import(SharedGroup& sg, History* history)
+{
+    using sgf = _impl::SharedGroupFriend;
+    REALM_ASSERT(!m_is_imported);
+    if (!sgf::is_reading(sg))
+        throw LogicError(LogicError::wrong_transact_state);
+    if (!m_entries.empty()) {
+        SharedGroup::VersionID version = sg.get_version_of_current_transaction();
+        if (version != m_version) {
+            if (!history || version > m_version)
+                throw SharedGroup::BadVersion();
+            LangBindHelper::advance_read(sg, *history, m_version); // Throws
+        }
+        Group& group = sgf::get_group(sg);
+        typedef std::vector<std::unique_ptr<Entry>>::iterator iter;
+        for (iter i = m_entries.begin(), end = m_entries.end(); i != end; ++i)
+            (*i)->apply(group); // Throws
+    }
+    m_is_imported = true;
+    m_pin.reset();
+}
+
+template<class T> inline std::unique_ptr<T> HandoverBatch::take(Ticket<T> ticket)
+{
+    REALM_ASSERT(m_is_imported);
+    REALM_ASSERT_3(ticket.m_ndx, <, m_entries.size());
+    TypedEntry<T>& entry = static_cast<TypedEntry<T>&>(*m_entries[ticket.m_ndx]);
+    REALM_ASSERT(entry.clone);
+    return std::move(entry.clone);
+}
+
+inline LinkViewRef HandoverBatch::take(Ticket<LinkView> ticket)
+{
+    REALM_ASSERT(m_is_imported);
+    REALM_ASSERT_3(ticket.m_ndx, <, m_entries.size());
+    LinkViewEntry& entry = static_cast<LinkViewEntry&>(*m_entries[ticket.m_ndx]);
+    return std::move(entry.link_view);
+}
+
+template<class T, class E>
+inline HandoverBatch::Ticket<T> HandoverBatch::add(std::unique_ptr<E> entry)
+{
+    REALM_ASSERT(!m_is_imported);
+    std::size_t ndx = m_entries.size();
+    m_entries.push_back(std::move(entry)); // Throws
+    return Ticket<T>(ndx);
+}
+
+
+inline HandoverBatch::Exporter::Exporter(HandoverBatch& batch, SharedGroup& sg):
+    m_batch(batch),
+    m_lock(_impl::SharedGroupFriend::get_handover_lock(sg))
+{
+    using sgf = _impl::SharedGroupFriend;
+    if (!sgf::is_reading(sg))
+        throw LogicError(LogicError::wrong_transact_state);
+    SharedGroup::VersionID version = sg.get_version_of_current_transaction();
+    if (!batch.empty() && version != batch.m_version)
+        throw SharedGroup::BadVersion();
+    batch.m_version.version = version.version;
+    batch.m_version.index = version.index;
+}
+
+template<class T>
+inline HandoverBatch::Ticket<T> HandoverBatch::Exporter::add(const T& accessor, ConstSourcePayload mode)
+{
+    std::unique_ptr<TypedEntry<T>> entry(new TypedEntry<T>); // Throws
+    // See implementation note in SharedGroup::export_for_handover()
+    entry->clone.reset(dynamic_cast<T*>(accessor.clone_for_handover(entry->patch, mode).release())); // Throws
+    return m_batch.add<T>(std::move(entry)); // Throws
+}
+
+template<class T>
+inline HandoverBatch::Ticket<T> HandoverBatch::Exporter::add(T& accessor, MutableSourcePayload mode)
+{
+    std::unique_ptr<TypedEntry<T>> entry(new TypedEntry<T>); // Throws
+    entry->clone.reset(dynamic_cast<T*>(accessor.clone_for_handover(entry->patch, mode).release())); // Throws
+    return m_batch.add<T>(std::move(entry)); // Throws
+}
+
+template<class T>
+inline HandoverBatch::Ticket<BasicRow<T>> HandoverBatch::Exporter::add(const BasicRow<T>& accessor)
+{
+    std::unique_ptr<TypedEntry<BasicRow<T>>> entry(new TypedEntry<BasicRow<T>>); // Throws
+    entry->clone.reset(dynamic_cast<BasicRow<T>*>(accessor.clone_for_handover(entry->patch).release())); // Throws
+    return m_batch.add<BasicRow<T>>(std::move(entry)); // Throws
+}
+
+inline HandoverBatch::Ticket<LinkView> HandoverBatch::Exporter::add(const LinkViewRef& accessor)
+{
+    std::unique_ptr<LinkViewEntry> entry(new LinkViewEntry); // Throws
+    LinkView::generate_patch(accessor, entry->patch); // Throws
+    return m_batch.add<LinkView>(std::move(entry)); // Throws
+}
+
+} // namespace realm
+
+#endif // REALM_HANDOVER_BATCH_HPP
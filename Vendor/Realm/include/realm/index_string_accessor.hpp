@@ -0,0 +1,560 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_INDEX_STRING_ACCESSOR_HPP
+#define REALM_INDEX_STRING_ACCESSOR_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <realm/impl/transact_log.hpp>
+#include <realm/table.hpp>
+
+namespace realm {
+
+/// Base class of the accessor-side string indexes (CaseFoldedStringIndex,
+/// TrigramStringIndex and HashedStringIndex).
+///
+/// Unlike StringIndex, these indexes are not stored in the file. An index
+/// is bound to a column of a table, and holds a reference to the table
+/// accessor, which keeps it alive. It remembers the version of the table it
+/// was built against (see _impl::TableFriend::get_version()). When the
+/// table changes, the index is either maintained incrementally through
+/// insert(), set(), erase(), update_ref() and clear(), which have the same
+/// meaning as the corresponding StringIndex functions, or rebuilt by
+/// sync_if_needed().
+///
+/// The version of a table is that of its latest change, so an unreported
+/// change cannot be detected once a later change is reported. Incremental
+/// maintenance therefore only keeps the index in sync if every change is
+/// reported, each one bracketed by begin_change():
+///
+///     index.begin_change();
+///     table.set_string(col_ndx, row_ndx, new_value);
+///     index.set(row_ndx, old_value, new_value);
+///
+/// If the index was not in sync when the change began, it is left stale,
+/// and is rebuilt on next use. Changes to other columns of the table must be
+/// reported too, through other_column_changed().
+///
+/// Changes made by other transactions are reported by passing observer() to
+/// LangBindHelper::advance_read() or promote_to_write(). The observer must
+/// not be passed to rollback_and_continue_as_read(), whose log carries the
+/// values that are rolled back rather than those that are restored; the
+/// index is rebuilt after a rollback.
+class AccessorStringIndex {
+public:
+    class Observer;
+
+    virtual ~AccessorStringIndex() REALM_NOEXCEPT {}
+
+    const Table& get_table() const REALM_NOEXCEPT { return *m_table; }
+    std::size_t get_column_ndx() const REALM_NOEXCEPT { return m_column_ndx; }
+
+    //@{
+    /// Maintenance, same semantics as StringIndex. Call begin_change()
+    /// before applying a change to the table, and the corresponding function
+    /// after.
+    void begin_change() REALM_NOEXCEPT;
+    virtual void insert(std::size_t row_ndx, StringData value, std::size_t num_rows, bool is_append) = 0;
+    virtual void set(std::size_t row_ndx, StringData old_value, StringData new_value) = 0;
+    virtual void erase(std::size_t row_ndx, StringData value, bool is_last) = 0;
+    virtual void update_ref(StringData value, std::size_t old_row_ndx, std::size_t new_row_ndx) = 0;
+    virtual void clear() = 0;
+    void other_column_changed() REALM_NOEXCEPT;
+    //@}
+
+    /// A transaction log observer that applies the changes to the indexed
+    /// column, and the row insertions and removals of the table, to this
+    /// index.
+    Observer observer();
+
+    bool is_in_sync() const REALM_NOEXCEPT;
+
+    /// Rebuild the index if the table has changed in a way that was not
+    /// reported through the maintenance functions. Returns true if a rebuild
+    /// took place.
+    bool sync_if_needed() const;
+
+protected:
+    ConstTableRef m_table;
+    std::size_t m_column_ndx;
+
+    AccessorStringIndex(const Table& table, std::size_t column_ndx);
+
+    /// Build the index from the column, and stamp() it.
+    virtual void rebuild() const = 0;
+
+    /// Mark the index as being in sync with the current version of the
+    /// table.
+    void stamp() const REALM_NOEXCEPT;
+
+    /// Called first by each maintenance function. Returns false, leaving
+    /// the index stale, if the change was not bracketed by begin_change()
+    /// while the index was in sync, in which case the change must not be
+    /// applied.
+    bool end_change() REALM_NOEXCEPT;
+
+private:
+    mutable uint_fast64_t m_version;
+    bool m_change_is_tracked = false;
+
+    // Set when an observer has brought the index up to date with a
+    // transaction log. The table accessor is only advanced after the log has
+    // been parsed, so the new version is adopted on next use.
+    mutable bool m_is_advancing = false;
+
+    void invalidate() REALM_NOEXCEPT;
+};
+
+
+/// The table accessor still shows the old version while the log is parsed,
+/// so the observer reads the value that a change replaces from the table,
+/// unless it was set earlier in the same log. Rows are translated to their
+/// position in the old version by undoing the row insertions and removals
+/// seen so far, so a log with many of them is not applied, and the index is
+/// rebuilt instead.
+class AccessorStringIndex::Observer: public _impl::NullInstructionObserver {
+public:
+    explicit Observer(AccessorStringIndex&);
+
+    bool select_table(std::size_t group_level_ndx, std::size_t levels, const std::size_t*);
+    bool select_descriptor(std::size_t levels, const std::size_t*);
+    bool insert_group_level_table(std::size_t table_ndx, std::size_t num_tables, StringData);
+    bool erase_group_level_table(std::size_t table_ndx, std::size_t num_tables);
+    bool insert_empty_rows(std::size_t row_ndx, std::size_t num_rows, std::size_t prior_num_rows,
+                           bool unordered);
+    bool erase_rows(std::size_t row_ndx, std::size_t num_rows, std::size_t prior_num_rows,
+                    bool unordered);
+    bool clear_table();
+    bool set_string(std::size_t col_ndx, std::size_t row_ndx, StringData);
+    bool set_null(std::size_t col_ndx, std::size_t row_ndx);
+    bool insert_link_column(std::size_t col_ndx, DataType, StringData, std::size_t, std::size_t);
+    bool insert_column(std::size_t col_ndx, DataType, StringData, bool);
+    bool erase_link_column(std::size_t col_ndx, std::size_t, std::size_t);
+    bool erase_column(std::size_t col_ndx);
+    void parse_complete();
+
+private:
+    enum OpType {
+        op_Insert,          // Insert num_rows rows at row_ndx
+        op_InsertUnordered, // Move [row_ndx, row_ndx+num_rows) to last_row_ndx...
+        op_Erase,           // Erase [row_ndx, row_ndx+num_rows)
+        op_MoveLastOver,    // Erase row_ndx, move last_row_ndx there
+        op_Clear            // Erase all
+    };
+
+    struct Op {
+        OpType type;
+        std::size_t row_ndx;
+        std::size_t num_rows;
+        std::size_t last_row_ndx;
+    };
+
+    struct Value {
+        bool is_null;
+        std::string str;
+        StringData get() const REALM_NOEXCEPT { return is_null ? StringData() : StringData(str); }
+    };
+
+    typedef std::map<std::size_t, Value> value_map;
+
+    static const std::size_t max_num_ops = 256;
+
+    AccessorStringIndex& m_index;
+    std::size_t m_table_ndx;
+    bool m_is_tracked;
+    bool m_is_selected = false;
+    bool m_is_descriptor_selected = false;
+    std::vector<Op> m_ops;     // Row insertions and removals seen so far
+    value_map m_values;        // Values set or inserted so far, by current row
+
+    StringData get_value(std::size_t row_ndx) const;
+    Value get_default_value() const;
+    void set_value(std::size_t row_ndx, StringData);
+    void record(const Op&);
+    void stop() REALM_NOEXCEPT;
+};
+
+
+
+
+// Implementation:
+
+inline AccessorStringIndex::AccessorStringIndex(const Table& table, std::size_t column_ndx):
+    m_table(table.get_table_ref()),
+    m_column_ndx(column_ndx),
+    m_version(0)
+{
+    REALM_ASSERT_3(column_ndx, <, table.get_column_count());
+    REALM_ASSERT_3(table.get_column_type(column_ndx), ==, type_String);
+}
+
+inline bool AccessorStringIndex::is_in_sync() const REALM_NOEXCEPT
+{
+    if (!m_table->is_attached())
+        return false;
+    uint_fast64_t version = _impl::TableFriend::get_version(*m_table);
+    if (m_is_advancing) {
+        m_version = version;
+        m_is_advancing = false;
+    }
+    return m_version == version;
+}
+
+inline bool AccessorStringIndex::sync_if_needed() const
+{
+    if (is_in_sync())
+        return false;
+    rebuild(); // Throws
+    return true;
+}
+
+inline void AccessorStringIndex::stamp() const REALM_NOEXCEPT
+{
+    m_version = _impl::TableFriend::get_version(*m_table);
+}
+
+inline void AccessorStringIndex::begin_change() REALM_NOEXCEPT
+{
+    m_change_is_tracked = is_in_sync();
+}
+
+inline bool AccessorStringIndex::end_change() REALM_NOEXCEPT
+{
+    bool is_tracked = m_change_is_tracked;
+    m_change_is_tracked = false;
+    if (!is_tracked)
+        invalidate();
+    return is_tracked;
+}
+
+inline void AccessorStringIndex::other_column_changed() REALM_NOEXCEPT
+{
+    if (end_change())
+        stamp();
+}
+
+inline void AccessorStringIndex::invalidate() REALM_NOEXCEPT
+{
+    m_version = uint_fast64_t(-1); // Never a table version
+    m_is_advancing = false;
+}
+
+inline AccessorStringIndex::Observer AccessorStringIndex::observer()
+{
+    return Observer(*this);
+}
+
+
+inline AccessorStringIndex::Observer::Observer(AccessorStringIndex& index):
+    m_index(index),
+    m_table_ndx(index.m_table->get_index_in_group()),
+    m_is_tracked(index.is_in_sync())
+{
+    // Subtables are not tracked
+    if (m_table_ndx == npos)
+        stop();
+}
+
+inline bool AccessorStringIndex::Observer::select_table(std::size_t group_level_ndx,
+                                                        std::size_t levels, const std::size_t*)
+{
+    m_is_selected = levels == 0 && group_level_ndx == m_table_ndx;
+    m_is_descriptor_selected = false;
+    return true;
+}
+
+inline bool AccessorStringIndex::Observer::select_descriptor(std::size_t levels, const std::size_t*)
+{
+    m_is_descriptor_selected = m_is_selected && levels == 0;
+    return true;
+}
+
+inline bool AccessorStringIndex::Observer::insert_group_level_table(std::size_t table_ndx,
+                                                                    std::size_t, StringData)
+{
+    if (m_is_tracked && table_ndx <= m_table_ndx)
+        ++m_table_ndx;
+    return true;
+}
+
+inline bool AccessorStringIndex::Observer::erase_group_level_table(std::size_t table_ndx,
+                                                                   std::size_t)
+{
+    if (!m_is_tracked)
+        return true;
+    if (table_ndx == m_table_ndx) {
+        stop();
+    }
+    else if (table_ndx < m_table_ndx) {
+        --m_table_ndx;
+    }
+    return true;
+}
+
+inline bool AccessorStringIndex::Observer::insert_empty_rows(std::size_t row_ndx,
+                                                             std::size_t num_rows,
+                                                             std::size_t prior_num_rows,
+                                                             bool unordered)
+{
+    if (!m_is_tracked || !m_is_selected)
+        return true;
+    Value value = get_default_value(); // Throws
+    if (unordered) {
+        // The inverse of move_last_over(): the rows that were at row_ndx
+        // are moved to the end to make room. Append the new rows, then swap
+        // the moved rows with them.
+        std::size_t num_moved = std::min(num_rows, prior_num_rows - row_ndx);
+        std::vector<Value> moved;
+        for (std::size_t i = 0; i < num_moved; ++i) {
+            StringData v = get_value(row_ndx + i); // Throws
+            moved.push_back(Value{v.is_null(), v}); // Throws
+        }
+        m_index.begin_change();
+        m_index.insert(prior_num_rows, value.get(), num_rows, true); // Throws
+        for (std::size_t i = 0; i < num_moved; ++i) {
+            m_index.begin_change();
+            m_index.set(row_ndx + i, moved[i].get(), value.get()); // Throws
+            m_index.begin_change();
+            m_index.set(prior_num_rows + i, value.get(), moved[i].get()); // Throws
+        }
+        record(Op{op_InsertUnordered, row_ndx, num_moved, prior_num_rows}); // Throws
+        for (std::size_t i = 0; i < num_moved; ++i)
+            m_values[row_ndx + i] = value; // Throws
+        for (std::size_t i = num_moved; i < num_rows; ++i)
+            m_values[prior_num_rows + i] = value; // Throws
+        return true;
+    }
+    m_index.begin_change();
+    m_index.insert(row_ndx, value.get(), num_rows, row_ndx == prior_num_rows); // Throws
+    record(Op{op_Insert, row_ndx, num_rows, 0}); // Throws
+    for (std::size_t i = 0; i < num_rows; ++i)
+        m_values[row_ndx + i] = value; // Throws
+    return true;
+}
+
+inline bool AccessorStringIndex::Observer::erase_rows(std::size_t row_ndx, std::size_t num_rows,
+                                                      std::size_t prior_num_rows, bool unordered)
+{
+    if (!m_is_tracked || !m_is_selected)
+        return true;
+    if (unordered) {
+        REALM_ASSERT_3(num_rows, ==, 1);
+        std::size_t last_row_ndx = prior_num_rows - 1;
+        StringData value = get_value(row_ndx); // Throws
+        m_index.begin_change();
+        m_index.erase(row_ndx, value, true); // Throws
+        if (row_ndx != last_row_ndx) {
+            StringData last_value = get_value(last_row_ndx); // Throws
+            m_index.begin_change();
+            m_index.update_ref(last_value, last_row_ndx, row_ndx); // Throws
+        }
+        record(Op{op_MoveLastOver, row_ndx, 1, last_row_ndx}); // Throws
+        return true;
+    }
+    bool is_last = row_ndx + num_rows == prior_num_rows;
+    for (std::size_t i = num_rows; i > 0; --i) {
+        StringData value = get_value(row_ndx + i - 1); // Throws
+        m_index.begin_change();
+        m_index.erase(row_ndx + i - 1, value, is_last); // Throws
+    }
+    record(Op{op_Erase, row_ndx, num_rows, 0}); // Throws
+    return true;
+}
+
+inline bool AccessorStringIndex::Observer::clear_table()
+{
+    if (!m_is_tracked || !m_is_selected)
+        return true;
+    m_index.begin_change();
+    m_index.clear(); // Throws
+    record(Op{op_Clear, 0, 0, 0}); // Throws
+    return true;
+}
+
+inline bool AccessorStringIndex::Observer::set_string(std::size_t col_ndx, std::size_t row_ndx,
+                                                      StringData value)
+{
+    if (m_is_tracked && m_is_selected && col_ndx == m_index.m_column_ndx)
+        set_value(row_ndx, value); // Throws
+    return true;
+}
+
+inline bool AccessorStringIndex::Observer::set_null(std::size_t col_ndx, std::size_t row_ndx)
+{
+    if (m_is_tracked && m_is_selected && col_ndx == m_index.m_column_ndx)
+        set_value(row_ndx, StringData()); // Throws
+    return true;
+}
+
+inline bool AccessorStringIndex::Observer::insert_link_column(std::size_t col_ndx, DataType type,
+                                                              StringData name, std::size_t,
+                                                              std::size_t)
+{
+    return insert_column(col_ndx, type, name, false);
+}
+
+inline bool AccessorStringIndex::Observer::insert_column(std::size_t col_ndx, DataType,
+                                                         StringData, bool)
+{
+    if (m_is_tracked && m_is_descriptor_selected && col_ndx <= m_index.m_column_ndx)
+        ++m_index.m_column_ndx;
+    return true;
+}
+
+inline bool AccessorStringIndex::Observer::erase_link_column(std::size_t col_ndx, std::size_t,
+                                                             std::size_t)
+{
+    return erase_column(col_ndx);
+}
+
+inline bool AccessorStringIndex::Observer::erase_column(std::size_t col_ndx)
+{
+    if (!m_is_tracked || !m_is_descriptor_selected)
+        return true;
+    // The index cannot be used once its column is gone
+    if (col_ndx == m_index.m_column_ndx) {
+        stop();
+    }
+    else if (col_ndx < m_index.m_column_ndx) {
+        --m_index.m_column_ndx;
+    }
+    return true;
+}
+
+inline void AccessorStringIndex::Observer::parse_complete()
+{
+    if (m_is_tracked)
+        m_index.m_is_advancing = true;
+}
+
+inline StringData AccessorStringIndex::Observer::get_value(std::size_t row_ndx) const
+{
+    value_map::const_iterator i = m_values.find(row_ndx);
+    if (i != m_values.end())
+        return i->second.get();
+
+    // Undo the row insertions and removals seen so far. Every row that was
+    // not in the old version has an entry in m_values.
+    typedef std::vector<Op>::const_reverse_iterator iter;
+    for (iter j = m_ops.rbegin(); j != m_ops.rend(); ++j) {
+        const Op& op = *j;
+        switch (op.type) {
+            case op_Insert:
+                REALM_ASSERT(row_ndx < op.row_ndx || row_ndx >= op.row_ndx + op.num_rows);
+                if (row_ndx >= op.row_ndx)
+                    row_ndx -= op.num_rows;
+                break;
+            case op_InsertUnordered:
+                if (row_ndx >= op.last_row_ndx && row_ndx < op.last_row_ndx + op.num_rows)
+                    row_ndx = op.row_ndx + (row_ndx - op.last_row_ndx);
+                break;
+            case op_Erase:
+                if (row_ndx >= op.row_ndx)
+                    row_ndx += op.num_rows;
+                break;
+            case op_MoveLastOver:
+                if (row_ndx == op.row_ndx)
+                    row_ndx = op.last_row_ndx;
+                break;
+            case op_Clear:
+                REALM_ASSERT(false);
+                break;
+        }
+    }
+    return m_index.m_table->get_string(m_index.m_column_ndx, row_ndx);
+}
+
+inline AccessorStringIndex::Observer::Value AccessorStringIndex::Observer::get_default_value() const
+{
+    if (m_index.m_table->is_nullable(m_index.m_column_ndx))
+        return Value{true, std::string()};
+    return Value{false, std::string()};
+}
+
+inline void AccessorStringIndex::Observer::set_value(std::size_t row_ndx, StringData value)
+{
+    StringData old_value = get_value(row_ndx); // Throws
+    m_index.begin_change();
+    m_index.set(row_ndx, old_value, value); // Throws
+    Value& v = m_values[row_ndx]; // Throws
+    v.is_null = value.is_null();
+    v.str.assign(value.data(), value.size()); // Throws
+}
+
+inline void AccessorStringIndex::Observer::record(const Op& op)
+{
+    // Shift the values that were set so far to their new rows
+    value_map values;
+    for (value_map::iterator i = m_values.begin(); i != m_values.end(); ++i) {
+        std::size_t row_ndx = i->first;
+        switch (op.type) {
+            case op_Insert:
+                if (row_ndx >= op.row_ndx)
+                    row_ndx += op.num_rows;
+                break;
+            case op_InsertUnordered:
+                if (row_ndx >= op.row_ndx && row_ndx < op.row_ndx + op.num_rows)
+                    row_ndx = op.last_row_ndx + (row_ndx - op.row_ndx);
+                break;
+            case op_Erase:
+                if (row_ndx >= op.row_ndx && row_ndx < op.row_ndx + op.num_rows)
+                    continue;
+                if (row_ndx >= op.row_ndx)
+                    row_ndx -= op.num_rows;
+                break;
+            case op_MoveLastOver:
+                if (row_ndx == op.row_ndx)
+                    continue;
+                if (row_ndx == op.last_row_ndx)
+                    row_ndx = op.row_ndx;
+                break;
+            case op_Clear:
+                continue;
+        }
+        values[row_ndx] = std::move(i->second); // Throws
+    }
+    m_values.swap(values);
+
+    // After a clear, every row has an entry in m_values, so the earlier
+    // operations are never undone
+    if (op.type == op_Clear) {
+        m_ops.clear();
+        return;
+    }
+    if (m_ops.size() == max_num_ops) {
+        stop();
+        return;
+    }
+    m_ops.push_back(op); // Throws
+}
+
+inline void AccessorStringIndex::Observer::stop() REALM_NOEXCEPT
+{
+    m_is_tracked = false;
+    m_ops.clear();
+    m_values.clear();
+    m_index.invalidate();
+}
+
+} // namespace realm
+
+#endif // REALM_INDEX_STRING_ACCESSOR_HPP
@@ -0,0 +1,344 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_INDEX_STRING_FOLD_HPP
+#define REALM_INDEX_STRING_FOLD_HPP
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <realm/unicode.hpp>
+#include <realm/table.hpp>
+#include <realm/index_string_accessor.hpp>
+#include <realm/query_conditions.hpp>
+#include <realm/query_engine.hpp>
+
+namespace realm {
+
+/// Case insensitive companion to StringIndex.
+///
+/// StringIndex builds its keys from the raw bytes of the values (see
+/// StringIndex::create_key()), so it cannot serve `equal(col, value, false)`
+/// or `begins_with(col, value, false)`. This index stores the case folded
+/// form of every value of a string column, using the same case mapping as
+/// the EqualIns and BeginsWithIns condition functors (case_map() in
+/// unicode.hpp), and maps each folded key to the rows holding it. Because
+/// case_map() preserves the byte length of each character, a folded prefix
+/// of a value is also a prefix of the folded value, so prefix lookups can be
+/// served by a range scan over the ordered keys.
+///
+/// Index hits are only candidates. Lookups verify every candidate against
+/// the original value in the column, so an index that is out of sync with the
+/// column can never produce wrong results, only a rebuild.
+///
+/// See AccessorStringIndex for how the index is kept in sync with the
+/// table.
+class CaseFoldedStringIndex: public AccessorStringIndex {
+public:
+    CaseFoldedStringIndex(const Table& table, std::size_t column_ndx);
+
+    /// Returns the case folded form of \a value. If \a value is not valid
+    /// UTF-8, the raw bytes are returned, which matches how the condition
+    /// functors treat such values.
+    static std::string fold(StringData value);
+
+    std::size_t find_first(StringData value) const;
+    void find_all(std::vector<std::size_t>& result, StringData value) const;
+    std::size_t count(StringData value) const;
+
+    /// Adds the rows whose value begins with \a prefix, ignoring case, to
+    /// \a result. The result is in ascending row order.
+    void find_all_begins_with(std::vector<std::size_t>& result, StringData prefix) const;
+
+    void insert(std::size_t row_ndx, StringData value, std::size_t num_rows, bool is_append) override;
+    void set(std::size_t row_ndx, StringData old_value, StringData new_value) override;
+    void erase(std::size_t row_ndx, StringData value, bool is_last) override;
+    void update_ref(StringData value, std::size_t old_row_ndx, std::size_t new_row_ndx) override;
+    void clear() override;
+
+private:
+    typedef std::vector<std::size_t> row_list;
+    typedef std::map<std::string, row_list> key_map;
+
+    mutable key_map m_keys;
+
+    void rebuild() const override;
+    void adjust_row_indexes(std::size_t min_row_ndx, int diff);
+    bool verify(std::size_t row_ndx, StringData value, const std::string& upper,
+                const std::string& lower, bool prefix) const;
+};
+
+
+/// Query condition that evaluates EqualIns or BeginsWithIns through a
+/// CaseFoldedStringIndex. Add it to a query with
+///
+///     query.expression(new CaseFoldedIndexCompare<EqualIns>(index, "foo"), true);
+///
+/// Candidates from the index are verified with the condition functor from
+/// query_conditions.hpp before they are reported as matches.
+template<class TConditionFunction> class CaseFoldedIndexCompare: public Expression {
+public:
+    CaseFoldedIndexCompare(const CaseFoldedStringIndex& index, StringData value);
+
+    std::size_t find_first(std::size_t start, std::size_t end) const override;
+    void set_table() override;
+    const Table* get_table() override { return &m_index.get_table(); }
+
+private:
+    const CaseFoldedStringIndex& m_index;
+    std::string m_value;
+    bool m_value_is_null;
+
+    StringData get_value() const REALM_NOEXCEPT
+    {
+        return m_value_is_null ? StringData() : StringData(m_value.data(), m_value.size());
+    }
+    std::string m_upper;
+    std::string m_lower;
+
+    // Sorted row indexes of the candidates, computed on first use after each
+    // call to set_table() (which is done by ExpressionNode::init()).
+    mutable std::vector<std::size_t> m_candidates;
+    mutable bool m_has_candidates;
+};
+
+
+
+
+// Implementation:
+
+inline CaseFoldedStringIndex::CaseFoldedStringIndex(const Table& table, std::size_t column_ndx):
+    AccessorStringIndex(table, column_ndx)
+{
+    rebuild(); // Throws
+}
+
+inline std::string CaseFoldedStringIndex::fold(StringData value)
+{
+    // '* 6' for the same reason as in StringNode
+    std::unique_ptr<char[]> buffer(new char[6 * value.size() + 1]); // Throws
+    if (!case_map(value, buffer.get(), false))
+        return std::string(value.data(), value.size());
+    return std::string(buffer.get(), value.size());
+}
+
+inline void CaseFoldedStringIndex::rebuild() const
+{
+    m_keys.clear();
+    std::size_t n = m_table->size();
+    for (std::size_t i = 0; i < n; ++i)
+        m_keys[fold(m_table->get_string(m_column_ndx, i))].push_back(i); // Throws
+    stamp();
+}
+
+inline bool CaseFoldedStringIndex::verify(std::size_t row_ndx, StringData value,
+                                          const std::string& upper, const std::string& lower,
+                                          bool prefix) const
+{
+    StringData v = m_table->get_string(m_column_ndx, row_ndx);
+    if (prefix)
+        return BeginsWithIns()(value, upper.data(), lower.data(), v);
+    return EqualIns()(value, upper.data(), lower.data(), v);
+}
+
+inline std::size_t CaseFoldedStringIndex::find_first(StringData value) const
+{
+    std::vector<std::size_t> rows;
+    find_all(rows, value); // Throws
+    return rows.empty() ? not_found : rows.front();
+}
+
+inline void CaseFoldedStringIndex::find_all(std::vector<std::size_t>& result, StringData value) const
+{
+    sync_if_needed(); // Throws
+    key_map::const_iterator i = m_keys.find(fold(value));
+    if (i == m_keys.end())
+        return;
+
+    std::string upper = case_map(value, true);
+    std::string lower = case_map(value, false);
+    std::size_t old_size = result.size();
+    for (std::size_t row_ndx: i->second) {
+        if (verify(row_ndx, value, upper, lower, false))
+            result.push_back(row_ndx);
+    }
+    std::sort(result.begin() + old_size, result.end());
+}
+
+inline std::size_t CaseFoldedStringIndex::count(StringData value) const
+{
+    std::vector<std::size_t> rows;
+    find_all(rows, value); // Throws
+    return rows.size();
+}
+
+inline void CaseFoldedStringIndex::find_all_begins_with(std::vector<std::size_t>& result,
+                                                        StringData prefix) const
+{
+    sync_if_needed(); // Throws
+    std::string key = fold(prefix);
+    std::string upper = case_map(prefix, true);
+    std::string lower = case_map(prefix, false);
+
+    std::size_t old_size = result.size();
+    for (key_map::const_iterator i = m_keys.lower_bound(key); i != m_keys.end(); ++i) {
+        if (i->first.compare(0, key.size(), key) != 0)
+            break;
+        for (std::size_t row_ndx: i->second) {
+            if (verify(row_ndx, prefix, upper, lower, true))
+                result.push_back(row_ndx);
+        }
+    }
+    std::sort(result.begin() + old_size, result.end());
+}
+
+inline void CaseFoldedStringIndex::adjust_row_indexes(std::size_t min_row_ndx, int diff)
+{
+    for (key_map::value_type& entry: m_keys) {
+        for (std::size_t& row_ndx: entry.second) {
+            if (row_ndx >= min_row_ndx)
+                row_ndx += diff;
+        }
+    }
+}
+
+inline void CaseFoldedStringIndex::insert(std::size_t row_ndx, StringData value,
+                                          std::size_t num_rows, bool is_append)
+{
+    if (!end_change())
+        return;
+    if (!is_append)
+        adjust_row_indexes(row_ndx, int(num_rows));
+    row_list& rows = m_keys[fold(value)]; // Throws
+    for (std::size_t i = 0; i < num_rows; ++i)
+        rows.push_back(row_ndx + i); // Throws
+    stamp();
+}
+
+inline void CaseFoldedStringIndex::set(std::size_t row_ndx, StringData old_value, StringData new_value)
+{
+    if (!end_change())
+        return;
+    std::string old_key = fold(old_value);
+    std::string new_key = fold(new_value);
+    if (old_key != new_key) {
+        key_map::iterator i = m_keys.find(old_key);
+        if (i != m_keys.end()) {
+            row_list& rows = i->second;
+            rows.erase(std::remove(rows.begin(), rows.end(), row_ndx), rows.end());
+            if (rows.empty())
+                m_keys.erase(i);
+        }
+        m_keys[new_key].push_back(row_ndx); // Throws
+    }
+    stamp();
+}
+
+inline void CaseFoldedStringIndex::erase(std::size_t row_ndx, StringData value, bool is_last)
+{
+    if (!end_change())
+        return;
+    key_map::iterator i = m_keys.find(fold(value));
+    if (i != m_keys.end()) {
+        row_list& rows = i->second;
+        rows.erase(std::remove(rows.begin(), rows.end(), row_ndx), rows.end());
+        if (rows.empty())
+            m_keys.erase(i);
+    }
+    // If it is the last row, we don't have to update refs
+    if (!is_last)
+        adjust_row_indexes(row_ndx, -1);
+    stamp();
+}
+
+inline void CaseFoldedStringIndex::update_ref(StringData value, std::size_t old_row_ndx,
+                                              std::size_t new_row_ndx)
+{
+    if (!end_change())
+        return;
+    key_map::iterator i = m_keys.find(fold(value));
+    if (i != m_keys.end())
+        std::replace(i->second.begin(), i->second.end(), old_row_ndx, new_row_ndx);
+    stamp();
+}
+
+inline void CaseFoldedStringIndex::clear()
+{
+    if (!end_change())
+        return;
+    m_keys.clear();
+    stamp();
+}
+
+
+template<class TConditionFunction>
+inline CaseFoldedIndexCompare<TConditionFunction>::CaseFoldedIndexCompare(const CaseFoldedStringIndex& index,
+                                                                          StringData value):
+    m_index(index),
+    m_value(value.data(), value.size()),
+    m_value_is_null(value.is_null()),
+    m_upper(case_map(value, true)),
+    m_lower(case_map(value, false)),
+    m_has_candidates(false)
+{
+    REALM_STATIC_ASSERT((std::is_same<TConditionFunction, EqualIns>::value ||
+                         std::is_same<TConditionFunction, BeginsWithIns>::value),
+                        "CaseFoldedStringIndex only serves EqualIns and BeginsWithIns");
+}
+
+template<class TConditionFunction>
+inline void CaseFoldedIndexCompare<TConditionFunction>::set_table()
+{
+    m_candidates.clear();
+    m_has_candidates = false;
+}
+
+template<class TConditionFunction>
+std::size_t CaseFoldedIndexCompare<TConditionFunction>::find_first(std::size_t start,
+                                                                   std::size_t end) const
+{
+    if (!m_has_candidates) {
+        StringData value = get_value();
+        if (std::is_same<TConditionFunction, EqualIns>::value)
+            m_index.find_all(m_candidates, value); // Throws
+        else
+            m_index.find_all_begins_with(m_candidates, value); // Throws
+        m_has_candidates = true;
+    }
+
+    // The index has already verified the candidates, but the table may have
+    // changed since, so they are checked again with the condition functor.
+    TConditionFunction cond;
+    const Table& table = m_index.get_table();
+    std::size_t col_ndx = m_index.get_column_ndx();
+    StringData value = get_value();
+    std::vector<std::size_t>::const_iterator i =
+        std::lower_bound(m_candidates.begin(), m_candidates.end(), start);
+    for (; i != m_candidates.end() && *i < end; ++i) {
+        if (*i < table.size() && cond(value, m_upper.data(), m_lower.data(), table.get_string(col_ndx, *i)))
+            return *i;
+    }
+    return not_found;
+}
+
+} // namespace realm
+
+#endif // REALM_INDEX_STRING_FOLD_HPP
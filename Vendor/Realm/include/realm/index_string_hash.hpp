@@ -0,0 +1,299 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_INDEX_STRING_HASH_HPP
+#define REALM_INDEX_STRING_HASH_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include <realm/util/hash.hpp>
+#include <realm/table.hpp>
+#include <realm/index_string_accessor.hpp>
+#include <realm/query_conditions.hpp>
+#include <realm/query_engine.hpp>
+
+namespace realm {
+
+/// Hashed-key alternative to StringIndex for columns whose values share long
+/// common prefixes (URLs, file paths, prefixed identifiers).
+///
+/// StringIndex::create_key() consumes values in 4-byte chunks, so values that
+/// only differ after a long prefix produce a deep chain of index nodes, and a
+/// lookup compares many chunks before the values diverge. This index instead
+/// reduces each value to a single 64-bit hash (util::hash_bytes()), and keeps
+/// one (hash, row) entry per row in a vector sorted by hash, which costs 16
+/// bytes per row regardless of value length. Rows whose values collide on the
+/// hash end up next to each other, and lookups verify every one of them
+/// against the column, so collisions only cost time, never correctness.
+///
+/// This is not a mode of StringIndex. The column keeps its own search index,
+/// if any, and neither Table::find_first_string() nor Query consult this
+/// one. It is only used through its own find_first(), find_all() and
+/// count(), which have the same meaning as the corresponding StringIndex
+/// functions, and through HashedIndexCompare. See AccessorStringIndex for
+/// how the index is kept in sync with the table. Each maintenance call moves
+/// part of the sorted vector, so it costs O(n) rather than the O(n log n)
+/// of a rebuild.
+class HashedStringIndex: public AccessorStringIndex {
+public:
+    typedef uint64_t key_type;
+
+    HashedStringIndex(const Table& table, std::size_t column_ndx);
+
+    static key_type create_key(StringData value) REALM_NOEXCEPT;
+
+    std::size_t find_first(StringData value) const;
+    void find_all(std::vector<std::size_t>& result, StringData value) const;
+    std::size_t count(StringData value) const;
+
+    void insert(std::size_t row_ndx, StringData value, std::size_t num_rows, bool is_append) override;
+    void set(std::size_t row_ndx, StringData old_value, StringData new_value) override;
+    void erase(std::size_t row_ndx, StringData value, bool is_last) override;
+    void update_ref(StringData value, std::size_t old_row_ndx, std::size_t new_row_ndx) override;
+    void clear() override;
+
+    /// Approximate number of bytes used by the index.
+    std::size_t get_byte_size() const REALM_NOEXCEPT { return m_entries.capacity() * sizeof (Entry); }
+
+private:
+    struct Entry {
+        key_type key;
+        std::size_t row_ndx;
+        bool operator<(const Entry& e) const REALM_NOEXCEPT
+        {
+            return key < e.key || (key == e.key && row_ndx < e.row_ndx);
+        }
+    };
+    typedef std::vector<Entry> entry_list;
+
+    mutable entry_list m_entries;
+
+    void rebuild() const override;
+    void add_row(std::size_t row_ndx, StringData value);
+    void remove_row(std::size_t row_ndx, StringData value);
+    void adjust_row_indexes(std::size_t min_row_ndx, int diff);
+
+    /// Calls \a handler with each row whose value equals \a value, in
+    /// ascending row order, until it returns false.
+    template<class F> void for_each_match(StringData value, F handler) const;
+};
+
+
+/// Query condition that evaluates Equal on a string column through a
+/// HashedStringIndex:
+///
+///     query.expression(new HashedIndexCompare(index, url), true);
+class HashedIndexCompare: public Expression {
+public:
+    HashedIndexCompare(const HashedStringIndex& index, StringData value);
+
+    std::size_t find_first(std::size_t start, std::size_t end) const override;
+    void set_table() override;
+    const Table* get_table() override { return &m_index.get_table(); }
+
+private:
+    const HashedStringIndex& m_index;
+    std::string m_value;
+    bool m_value_is_null;
+
+    StringData get_value() const REALM_NOEXCEPT
+    {
+        return m_value_is_null ? StringData() : StringData(m_value.data(), m_value.size());
+    }
+
+    mutable std::vector<std::size_t> m_candidates;
+    mutable bool m_has_candidates;
+};
+
+
+
+
+// Implementation:
+
+inline HashedStringIndex::HashedStringIndex(const Table& table, std::size_t column_ndx):
+    AccessorStringIndex(table, column_ndx)
+{
+    rebuild(); // Throws
+}
+
+inline HashedStringIndex::key_type HashedStringIndex::create_key(StringData value) REALM_NOEXCEPT
+{
+    return util::hash_bytes(value.data(), value.size());
+}
+
+inline void HashedStringIndex::rebuild() const
+{
+    std::size_t n = m_table->size();
+    m_entries.clear();
+    m_entries.reserve(n); // Throws
+    for (std::size_t i = 0; i < n; ++i) {
+        Entry e = { create_key(m_table->get_string(m_column_ndx, i)), i };
+        m_entries.push_back(e);
+    }
+    std::sort(m_entries.begin(), m_entries.end());
+    stamp();
+}
+
+template<class F> void HashedStringIndex::for_each_match(StringData value, F handler) const
+{
+    sync_if_needed(); // Throws
+    Entry first = { create_key(value), 0 };
+    entry_list::const_iterator i = std::lower_bound(m_entries.begin(), m_entries.end(), first);
+    // Entries with the same key are sorted by row index
+    for (; i != m_entries.end() && i->key == first.key; ++i) {
+        if (m_table->get_string(m_column_ndx, i->row_ndx) != value)
+            continue; // Hash collision
+        if (!handler(i->row_ndx))
+            return;
+    }
+}
+
+inline std::size_t HashedStringIndex::find_first(StringData value) const
+{
+    std::size_t res = not_found;
+    for_each_match(value, [&](std::size_t row_ndx) { res = row_ndx; return false; }); // Throws
+    return res;
+}
+
+inline void HashedStringIndex::find_all(std::vector<std::size_t>& result, StringData value) const
+{
+    for_each_match(value, [&](std::size_t row_ndx) { result.push_back(row_ndx); return true; }); // Throws
+}
+
+inline std::size_t HashedStringIndex::count(StringData value) const
+{
+    std::size_t n = 0;
+    for_each_match(value, [&](std::size_t) { ++n; return true; }); // Throws
+    return n;
+}
+
+inline void HashedStringIndex::add_row(std::size_t row_ndx, StringData value)
+{
+    Entry e = { create_key(value), row_ndx };
+    m_entries.insert(std::upper_bound(m_entries.begin(), m_entries.end(), e), e); // Throws
+}
+
+inline void HashedStringIndex::remove_row(std::size_t row_ndx, StringData value)
+{
+    Entry e = { create_key(value), row_ndx };
+    entry_list::iterator i = std::lower_bound(m_entries.begin(), m_entries.end(), e);
+    if (i != m_entries.end() && i->key == e.key && i->row_ndx == row_ndx)
+        m_entries.erase(i);
+}
+
+inline void HashedStringIndex::adjust_row_indexes(std::size_t min_row_ndx, int diff)
+{
+    // Entries with equal keys stay in row order, because all rows at or
+    // above min_row_ndx are moved by the same amount.
+    for (Entry& e: m_entries) {
+        if (e.row_ndx >= min_row_ndx)
+            e.row_ndx += diff;
+    }
+}
+
+inline void HashedStringIndex::insert(std::size_t row_ndx, StringData value,
+                                      std::size_t num_rows, bool is_append)
+{
+    if (!end_change())
+        return;
+    if (!is_append)
+        adjust_row_indexes(row_ndx, int(num_rows));
+    for (std::size_t i = 0; i < num_rows; ++i)
+        add_row(row_ndx + i, value); // Throws
+    stamp();
+}
+
+inline void HashedStringIndex::set(std::size_t row_ndx, StringData old_value, StringData new_value)
+{
+    if (!end_change())
+        return;
+    if (create_key(old_value) != create_key(new_value)) {
+        remove_row(row_ndx, old_value);
+        add_row(row_ndx, new_value); // Throws
+    }
+    stamp();
+}
+
+inline void HashedStringIndex::erase(std::size_t row_ndx, StringData value, bool is_last)
+{
+    if (!end_change())
+        return;
+    remove_row(row_ndx, value);
+    // If it is the last row, we don't have to update refs
+    if (!is_last)
+        adjust_row_indexes(row_ndx, -1);
+    stamp();
+}
+
+inline void HashedStringIndex::update_ref(StringData value, std::size_t old_row_ndx,
+                                          std::size_t new_row_ndx)
+{
+    if (!end_change())
+        return;
+    remove_row(old_row_ndx, value);
+    add_row(new_row_ndx, value); // Throws
+    stamp();
+}
+
+inline void HashedStringIndex::clear()
+{
+    if (!end_change())
+        return;
+    m_entries.clear();
+    stamp();
+}
+
+
+inline HashedIndexCompare::HashedIndexCompare(const HashedStringIndex& index, StringData value):
+    m_index(index),
+    m_value(value.data(), value.size()),
+    m_value_is_null(value.is_null()),
+    m_has_candidates(false)
+{
+}
+
+inline void HashedIndexCompare::set_table()
+{
+    m_candidates.clear();
+    m_has_candidates = false;
+}
+
+inline std::size_t HashedIndexCompare::find_first(std::size_t start, std::size_t end) const
+{
+    StringData value = get_value();
+    if (!m_has_candidates) {
+        m_index.find_all(m_candidates, value); // Throws
+        m_has_candidates = true;
+    }
+
+    const Table& table = m_index.get_table();
+    std::size_t col_ndx = m_index.get_column_ndx();
+    std::vector<std::size_t>::const_iterator i =
+        std::lower_bound(m_candidates.begin(), m_candidates.end(), start);
+    for (; i != m_candidates.end() && *i < end; ++i) {
+        if (*i < table.size() && table.get_string(col_ndx, *i) == value)
+            return *i;
+    }
+    return not_found;
+}
+
+} // namespace realm
+
+#endif // REALM_INDEX_STRING_HASH_HPP
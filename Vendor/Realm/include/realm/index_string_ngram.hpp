@@ -0,0 +1,382 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_INDEX_STRING_NGRAM_HPP
+#define REALM_INDEX_STRING_NGRAM_HPP
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <realm/index_string_fold.hpp>
+
+namespace realm {
+
+/// Trigram index over a string column, used as a candidate filter for
+/// substring search (Query::contains()).
+///
+/// Every value is case folded (CaseFoldedStringIndex::fold()) and split into
+/// overlapping 3-byte grams, and each gram maps to the ascending list of rows
+/// that contain it. A row can only contain the needle if it contains every
+/// gram of the folded needle, so intersecting the posting lists of those
+/// grams gives a superset of the rows matched by both Contains and
+/// ContainsIns. The final decision is always left to the condition functors
+/// in query_conditions.hpp.
+///
+/// Needles shorter than three bytes have no grams, and for those
+/// find_candidates() reports that it cannot filter. The same goes for
+/// needles that are not valid UTF-8, which cannot be case folded. Values
+/// that are not valid UTF-8 are not split into grams either, as a needle
+/// can match the valid part of such a value with a different case. They are
+/// kept in a separate list, and are candidates for every needle.
+///
+/// See AccessorStringIndex for how the index is kept in sync with the
+/// table.
+class TrigramStringIndex: public AccessorStringIndex {
+public:
+    typedef uint_fast32_t gram_type;
+    static const std::size_t gram_size = 3;
+
+    TrigramStringIndex(const Table& table, std::size_t column_ndx);
+
+    /// Replace the contents of \a result by the ascending row indexes of
+    /// the rows that may contain \a needle. Returns false, leaving \a result
+    /// empty, if the needle is too short for the index to narrow the search,
+    /// in which case every row is a candidate.
+    bool find_candidates(std::vector<std::size_t>& result, StringData needle) const;
+
+    void insert(std::size_t row_ndx, StringData value, std::size_t num_rows, bool is_append) override;
+    void set(std::size_t row_ndx, StringData old_value, StringData new_value) override;
+    void erase(std::size_t row_ndx, StringData value, bool is_last) override;
+    void update_ref(StringData value, std::size_t old_row_ndx, std::size_t new_row_ndx) override;
+    void clear() override;
+
+    /// Number of distinct grams in the index.
+    std::size_t num_grams() const REALM_NOEXCEPT { return m_postings.size(); }
+
+private:
+    typedef std::vector<std::size_t> row_list;
+    typedef std::unordered_map<gram_type, row_list> posting_map;
+
+    mutable posting_map m_postings;
+
+    mutable row_list m_unfoldable; // Rows whose values are not valid UTF-8
+
+    /// Distinct grams of the folded form of \a value, in ascending order.
+    /// Returns false, leaving \a grams empty, if \a value is not valid
+    /// UTF-8.
+    static bool get_grams(StringData value, std::vector<gram_type>& grams);
+
+    void rebuild() const override;
+    void add_row(std::size_t row_ndx, StringData value);
+    void remove_row(std::size_t row_ndx, StringData value);
+    void adjust_row_indexes(std::size_t min_row_ndx, int diff);
+};
+
+
+/// Query condition that evaluates Contains or ContainsIns, using a
+/// TrigramStringIndex to skip rows that cannot match:
+///
+///     query.expression(new TrigramIndexCompare<ContainsIns>(index, "error"), true);
+template<class TConditionFunction> class TrigramIndexCompare: public Expression {
+public:
+    TrigramIndexCompare(const TrigramStringIndex& index, StringData value);
+
+    std::size_t find_first(std::size_t start, std::size_t end) const override;
+    void set_table() override;
+    const Table* get_table() override { return &m_index.get_table(); }
+
+private:
+    const TrigramStringIndex& m_index;
+    std::string m_value;
+    bool m_value_is_null;
+
+    StringData get_value() const REALM_NOEXCEPT
+    {
+        return m_value_is_null ? StringData() : StringData(m_value.data(), m_value.size());
+    }
+    std::string m_upper;
+    std::string m_lower;
+
+    mutable std::vector<std::size_t> m_candidates;
+    mutable bool m_has_candidates;
+    mutable bool m_use_candidates;
+
+    bool matches(std::size_t row_ndx) const;
+};
+
+
+
+
+// Implementation:
+
+inline TrigramStringIndex::TrigramStringIndex(const Table& table, std::size_t column_ndx):
+    AccessorStringIndex(table, column_ndx)
+{
+    rebuild(); // Throws
+}
+
+inline bool TrigramStringIndex::get_grams(StringData value, std::vector<gram_type>& grams)
+{
+    grams.clear();
+    // '* 6' for the same reason as in StringNode
+    std::unique_ptr<char[]> folded(new char[6 * value.size() + 1]); // Throws
+    if (!case_map(value, folded.get(), false))
+        return false;
+    if (value.size() < gram_size)
+        return true;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(folded.get());
+    std::size_t n = value.size() - gram_size + 1;
+    grams.reserve(n); // Throws
+    for (std::size_t i = 0; i < n; ++i)
+        grams.push_back(gram_type(p[i]) << 16 | gram_type(p[i + 1]) << 8 | gram_type(p[i + 2]));
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+    return true;
+}
+
+inline void TrigramStringIndex::rebuild() const
+{
+    m_postings.clear();
+    m_unfoldable.clear();
+    std::vector<gram_type> grams;
+    std::size_t n = m_table->size();
+    // Rows are visited in ascending order, so the posting lists come out
+    // sorted without further work.
+    for (std::size_t i = 0; i < n; ++i) {
+        if (!get_grams(m_table->get_string(m_column_ndx, i), grams)) { // Throws
+            m_unfoldable.push_back(i); // Throws
+            continue;
+        }
+        for (gram_type g: grams)
+            m_postings[g].push_back(i); // Throws
+    }
+    stamp();
+}
+
+inline bool TrigramStringIndex::find_candidates(std::vector<std::size_t>& result, StringData needle) const
+{
+    result.clear();
+    std::vector<gram_type> grams;
+    if (!get_grams(needle, grams) || grams.empty()) // Throws
+        return false;
+
+    sync_if_needed(); // Throws
+
+    // Intersect starting from the shortest posting list
+    std::vector<const row_list*> lists;
+    lists.reserve(grams.size()); // Throws
+    for (gram_type g: grams) {
+        posting_map::const_iterator i = m_postings.find(g);
+        if (i == m_postings.end()) {
+            // Some gram occurs nowhere
+            result = m_unfoldable; // Throws
+            return true;
+        }
+        lists.push_back(&i->second);
+    }
+    std::sort(lists.begin(), lists.end(),
+              [](const row_list* a, const row_list* b) { return a->size() < b->size(); });
+
+    result = *lists[0]; // Throws
+    row_list tmp;
+    for (std::size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+        tmp.clear();
+        std::set_intersection(result.begin(), result.end(), lists[i]->begin(), lists[i]->end(),
+                              std::back_inserter(tmp)); // Throws
+        result.swap(tmp);
+    }
+    if (!m_unfoldable.empty()) {
+        tmp.clear();
+        std::set_union(result.begin(), result.end(), m_unfoldable.begin(), m_unfoldable.end(),
+                       std::back_inserter(tmp)); // Throws
+        result.swap(tmp);
+    }
+    return true;
+}
+
+inline void TrigramStringIndex::add_row(std::size_t row_ndx, StringData value)
+{
+    std::vector<gram_type> grams;
+    if (!get_grams(value, grams)) { // Throws
+        m_unfoldable.insert(std::upper_bound(m_unfoldable.begin(), m_unfoldable.end(), row_ndx),
+                            row_ndx); // Throws
+        return;
+    }
+    for (gram_type g: grams) {
+        row_list& rows = m_postings[g]; // Throws
+        rows.insert(std::upper_bound(rows.begin(), rows.end(), row_ndx), row_ndx); // Throws
+    }
+}
+
+inline void TrigramStringIndex::remove_row(std::size_t row_ndx, StringData value)
+{
+    std::vector<gram_type> grams;
+    if (!get_grams(value, grams)) { // Throws
+        row_list::iterator j = std::lower_bound(m_unfoldable.begin(), m_unfoldable.end(), row_ndx);
+        if (j != m_unfoldable.end() && *j == row_ndx)
+            m_unfoldable.erase(j);
+        return;
+    }
+    for (gram_type g: grams) {
+        posting_map::iterator i = m_postings.find(g);
+        if (i == m_postings.end())
+            continue;
+        row_list& rows = i->second;
+        row_list::iterator j = std::lower_bound(rows.begin(), rows.end(), row_ndx);
+        if (j != rows.end() && *j == row_ndx)
+            rows.erase(j);
+        if (rows.empty())
+            m_postings.erase(i);
+    }
+}
+
+inline void TrigramStringIndex::adjust_row_indexes(std::size_t min_row_ndx, int diff)
+{
+    for (posting_map::value_type& entry: m_postings) {
+        row_list& rows = entry.second;
+        for (row_list::iterator i = std::lower_bound(rows.begin(), rows.end(), min_row_ndx);
+             i != rows.end(); ++i)
+            *i += diff;
+    }
+    for (row_list::iterator i = std::lower_bound(m_unfoldable.begin(), m_unfoldable.end(),
+                                                 min_row_ndx);
+         i != m_unfoldable.end(); ++i)
+        *i += diff;
+}
+
+inline void TrigramStringIndex::insert(std::size_t row_ndx, StringData value,
+                                       std::size_t num_rows, bool is_append)
+{
+    if (!end_change())
+        return;
+    if (!is_append)
+        adjust_row_indexes(row_ndx, int(num_rows));
+    for (std::size_t i = 0; i < num_rows; ++i)
+        add_row(row_ndx + i, value); // Throws
+    stamp();
+}
+
+inline void TrigramStringIndex::set(std::size_t row_ndx, StringData old_value, StringData new_value)
+{
+    if (!end_change())
+        return;
+    remove_row(row_ndx, old_value); // Throws
+    add_row(row_ndx, new_value); // Throws
+    stamp();
+}
+
+inline void TrigramStringIndex::erase(std::size_t row_ndx, StringData value, bool is_last)
+{
+    if (!end_change())
+        return;
+    remove_row(row_ndx, value); // Throws
+    // If it is the last row, we don't have to update refs
+    if (!is_last)
+        adjust_row_indexes(row_ndx + 1, -1);
+    stamp();
+}
+
+inline void TrigramStringIndex::update_ref(StringData value, std::size_t old_row_ndx,
+                                           std::size_t new_row_ndx)
+{
+    if (!end_change())
+        return;
+    remove_row(old_row_ndx, value); // Throws
+    add_row(new_row_ndx, value); // Throws
+    stamp();
+}
+
+inline void TrigramStringIndex::clear()
+{
+    if (!end_change())
+        return;
+    m_postings.clear();
+    m_unfoldable.clear();
+    stamp();
+}
+
+
+template<class TConditionFunction>
+inline TrigramIndexCompare<TConditionFunction>::TrigramIndexCompare(const TrigramStringIndex& index,
+                                                                    StringData value):
+    m_index(index),
+    m_value(value.data(), value.size()),
+    m_value_is_null(value.is_null()),
+    m_upper(case_map(value, true)),
+    m_lower(case_map(value, false)),
+    m_has_candidates(false),
+    m_use_candidates(false)
+{
+    REALM_STATIC_ASSERT((std::is_same<TConditionFunction, Contains>::value ||
+                         std::is_same<TConditionFunction, ContainsIns>::value),
+                        "TrigramStringIndex only serves Contains and ContainsIns");
+}
+
+template<class TConditionFunction>
+inline void TrigramIndexCompare<TConditionFunction>::set_table()
+{
+    m_candidates.clear();
+    m_has_candidates = false;
+}
+
+template<class TConditionFunction>
+inline bool TrigramIndexCompare<TConditionFunction>::matches(std::size_t row_ndx) const
+{
+    TConditionFunction cond;
+    StringData value = get_value();
+    StringData v = m_index.get_table().get_string(m_index.get_column_ndx(), row_ndx);
+    return cond(value, m_upper.data(), m_lower.data(), v);
+}
+
+template<class TConditionFunction>
+std::size_t TrigramIndexCompare<TConditionFunction>::find_first(std::size_t start,
+                                                                std::size_t end) const
+{
+    if (!m_has_candidates) {
+        StringData value = get_value();
+        m_use_candidates = m_index.find_candidates(m_candidates, value); // Throws
+        m_has_candidates = true;
+    }
+
+    if (!m_use_candidates) {
+        // Needle too short to be filtered, fall back to a linear scan
+        for (std::size_t s = start; s < end; ++s) {
+            if (matches(s))
+                return s;
+        }
+        return not_found;
+    }
+
+    std::size_t size = m_index.get_table().size();
+    std::vector<std::size_t>::const_iterator i =
+        std::lower_bound(m_candidates.begin(), m_candidates.end(), start);
+    for (; i != m_candidates.end() && *i < end; ++i) {
+        if (*i < size && matches(*i))
+            return *i;
+    }
+    return not_found;
+}
+
+} // namespace realm
+
+#endif // REALM_INDEX_STRING_NGRAM_HPP
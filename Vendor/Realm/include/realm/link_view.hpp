@@ -146,6 +146,7 @@ private:
     friend class util::bind_ptr<const LinkView>;
     friend class LangBindHelper;
     friend class SharedGroup;
+    friend class HandoverBatch;
     friend class Query;
     friend class TableViewBase;
 };
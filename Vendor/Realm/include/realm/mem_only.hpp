@@ -0,0 +1,129 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_MEM_ONLY_HPP
+#define REALM_MEM_ONLY_HPP
+
+#include <exception>
+#include <string>
+
+#include <realm/util/features.h>
+#include <realm/util/file.hpp>
+#include <realm/group_shared.hpp>
+
+namespace realm {
+
+/// Thrown by MemOnly::commit_and_check_size() when a commit has grown the
+/// database file beyond its size limit. The transaction is committed, and
+/// the caller is expected to make room, for example by deleting data, which
+/// is always allowed.
+struct DatabaseSizeLimitExceeded: std::exception {
+    const char* what() const REALM_NOEXCEPT_OR_NOTHROW override
+    {
+        return "Database size limit exceeded";
+    }
+};
+
+
+/// Helpers for databases opened with SharedGroup::durability_MemOnly, when
+/// used as a cache that is shared between processes.
+///
+/// A MemOnly database is still mapped from a file, which is removed when the
+/// last SharedGroup closes it. Until then, the kernel is free to write its
+/// dirty pages back to the underlying storage, which causes stray disk I/O.
+/// Placing the file on a RAM-backed file system avoids that, while keeping
+/// the path that cooperating processes use to find the database (and its
+/// lock file):
+///
+///     std::string path = MemOnly::get_path("cache.realm", tmp_dir);
+///     SharedGroup sg(path, false, SharedGroup::durability_MemOnly);
+///     ...
+///     Group& group = sg.begin_write();
+///     ...
+///     MemOnly::commit_and_check_size(sg, 64 * 1024 * 1024); // Throws past 64 MiB
+///
+/// Only Linux has such a file system (`/dev/shm`). On Apple platforms,
+/// including iOS, get_memory_backed_dir() returns the empty string, and
+/// get_path() always places the database in the fallback directory, so
+/// there the helpers provide the size check only.
+///
+/// The size of the file after a commit is only known once the commit has
+/// been written, so the size limit is a check that reports growth past it,
+/// not a cap that prevents it. Changes are written into free space in the
+/// file first, so the file only grows once that is used up, and it never
+/// shrinks.
+class MemOnly {
+public:
+    /// The directory of a RAM-backed file system (`/dev/shm` on Linux), or
+    /// the empty string if the platform has none.
+    static std::string get_memory_backed_dir();
+
+    /// The path of the named database in the directory returned by
+    /// get_memory_backed_dir(), or in \a fallback_dir if there is none.
+    static std::string get_path(const std::string& name, const std::string& fallback_dir);
+
+    /// Commit the current write transaction of the shared group, then throw
+    /// DatabaseSizeLimitExceeded if the commit grew the database file beyond
+    /// \a max_size. Commits that do not grow the file never throw, even if
+    /// the file is already beyond the limit. A \a max_size of zero means no
+    /// limit.
+    static SharedGroup::version_type commit_and_check_size(SharedGroup&, std::size_t max_size);
+};
+
+
+
+
+// Implementation:
+
+inline std::string MemOnly::get_memory_backed_dir()
+{
+#if defined __linux__
+    if (util::File::exists("/dev/shm")) // Throws
+        return "/dev/shm"; // Throws
+#endif
+    return std::string();
+}
+
+inline std::string MemOnly::get_path(const std::string& name, const std::string& fallback_dir)
+{
+    std::string dir = get_memory_backed_dir(); // Throws
+    if (dir.empty())
+        dir = fallback_dir; // Throws
+    return dir + "/" + name; // Throws
+}
+
+inline SharedGroup::version_type MemOnly::commit_and_check_size(SharedGroup& sg,
+                                                                std::size_t max_size)
+{
+    using sgf = _impl::SharedGroupFriend;
+    // The read lock held by the write transaction gives the file size before
+    // the commit, and once continued as read, the file size after it
+    std::size_t old_file_size = sgf::get_read_file_size(sg);
+    sgf::commit_and_continue_as_read(sg); // Throws
+    SharedGroup::version_type version = sgf::get_read_version(sg);
+    std::size_t new_file_size = sgf::get_read_file_size(sg);
+    sg.end_read();
+    if (max_size != 0 && new_file_size > old_file_size && new_file_size > max_size)
+        throw DatabaseSizeLimitExceeded();
+    return version;
+}
+
+} // namespace realm
+
+#endif // REALM_MEM_ONLY_HPP
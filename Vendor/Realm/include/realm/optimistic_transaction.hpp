@@ -0,0 +1,243 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_OPTIMISTIC_TRANSACTION_HPP
+#define REALM_OPTIMISTIC_TRANSACTION_HPP
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <realm/group_shared.hpp>
+#include <realm/lang_bind_helper.hpp>
+#include <realm/change_set.hpp>
+
+namespace realm {
+
+/// A write transaction whose changes are prepared against a read snapshot,
+/// without holding the write lock, and validated at commit.
+///
+/// SharedGroup::begin_write() holds the inter-process write mutex from the
+/// start of the transaction until it is committed, including the time spent
+/// deciding what to write. An optimistic transaction instead runs on the read
+/// transaction of the shared group. The application reads the snapshot,
+/// declares what it read, and queues its mutations. commit() then takes the
+/// write lock through LangBindHelper::promote_to_write(), which advances the
+/// snapshot to the latest version, and validates the read and write sets
+/// against the changes committed in the meantime. If there is no conflict,
+/// the queued mutations are applied and committed, and the lock is held only
+/// for that. Otherwise, the transaction is rolled back and commit() returns
+/// false, with the shared group reading the latest version, so that the
+/// application can prepare its changes again:
+///
+///     for (;;) {
+///         OptimisticTransaction tr(sg, history);
+///         ConstTableRef t = tr.get_group().get_table(ndx);
+///         tr.read(ndx, row_ndx);
+///         int_fast64_t v = t->get_int(0, row_ndx) + 1;
+///         tr.write(ndx, [=](Table& t) { t.set_int(0, row_ndx, v); });
+///         if (tr.commit())
+///             break;
+///     }
+///
+/// A read of a table conflicts with any change to it, and a read of a row
+/// with modification of the row, or with any change that shifts row indexes
+/// at or below it. As mutations may refer to rows by index, a write to a
+/// table conflicts with any change that shifts the indexes of its rows
+/// (removal, reordering, and insertion other than at the end), and with
+/// schema changes. Modifications by others of rows that were not read, and
+/// rows appended by others, do not conflict, so writers that touch disjoint
+/// tables or rows no longer wait for each other. Insertion or removal of
+/// group-level tables conflicts with everything.
+///
+/// The shared group must be in a read transaction when the optimistic
+/// transaction is created, and it is again when the transaction is
+/// destroyed.
+class OptimisticTransaction {
+public:
+    typedef std::function<void(Table&)> Mutation;
+
+    OptimisticTransaction(SharedGroup&, History&) REALM_NOEXCEPT;
+
+    /// The snapshot against which the transaction is prepared.
+    const Group& get_group() const REALM_NOEXCEPT;
+
+    /// Declare that the transaction depends on the contents of a table.
+    void read(std::size_t table_ndx);
+
+    /// Declare that the transaction depends on a row of a table.
+    void read(std::size_t table_ndx, std::size_t row_ndx);
+
+    /// Queue a mutation of a table, to be applied at commit.
+    void write(std::size_t table_ndx, Mutation);
+
+    /// Validate and commit. Returns false on conflict, in which case nothing
+    /// was written, and the read transaction of the shared group was
+    /// advanced to the latest version.
+    ///
+    /// If a mutation throws, the write transaction is rolled back, and the
+    /// exception propagates.
+    bool commit();
+
+    /// After commit() returned false, the table that caused the conflict,
+    /// or npos when group-level tables were inserted or removed.
+    std::size_t get_conflict_table() const REALM_NOEXCEPT { return m_conflict_table_ndx; }
+
+private:
+    struct Read {
+        std::size_t table_ndx;
+        std::size_t row_ndx; // npos for the whole table
+    };
+    struct Write {
+        std::size_t table_ndx;
+        Mutation mutation;
+    };
+
+    SharedGroup& m_shared_group;
+    History& m_history;
+    std::vector<Read> m_reads;
+    std::vector<Write> m_writes;
+    std::size_t m_conflict_table_ndx = npos;
+
+    bool validate(const ChangeSet&);
+    static bool conflicts(const TableChangeSet&, std::size_t row_ndx) REALM_NOEXCEPT;
+    static bool is_reordered(const TableChangeSet&) REALM_NOEXCEPT;
+    static bool is_shifted(const TableChangeSet&, std::size_t num_rows) REALM_NOEXCEPT;
+};
+
+
+
+
+// Implementation:
+
+inline OptimisticTransaction::OptimisticTransaction(SharedGroup& sg, History& history) REALM_NOEXCEPT:
+    m_shared_group(sg),
+    m_history(history)
+{
+}
+
+inline const Group& OptimisticTransaction::get_group() const REALM_NOEXCEPT
+{
+    using sgf = _impl::SharedGroupFriend;
+    return sgf::get_group(m_shared_group);
+}
+
+inline void OptimisticTransaction::read(std::size_t table_ndx)
+{
+    m_reads.push_back(Read{table_ndx, npos}); // Throws
+}
+
+inline void OptimisticTransaction::read(std::size_t table_ndx, std::size_t row_ndx)
+{
+    m_reads.push_back(Read{table_ndx, row_ndx}); // Throws
+}
+
+inline void OptimisticTransaction::write(std::size_t table_ndx, Mutation mutation)
+{
+    m_writes.push_back(Write{table_ndx, std::move(mutation)}); // Throws
+}
+
+inline bool OptimisticTransaction::commit()
+{
+    using sgf = _impl::SharedGroupFriend;
+    ChangeSetBuilder builder;
+    LangBindHelper::promote_to_write(m_shared_group, m_history, builder.observer()); // Throws
+    bool is_valid;
+    try {
+        is_valid = validate(builder.finish()); // Throws
+        if (is_valid) {
+            Group& group = sgf::get_group(m_shared_group);
+            typedef std::vector<Write>::iterator iter;
+            for (iter i = m_writes.begin(), end = m_writes.end(); i != end; ++i) {
+                TableRef table = group.get_table(i->table_ndx); // Throws
+                i->mutation(*table); // Throws
+            }
+        }
+    }
+    catch (...) {
+        LangBindHelper::rollback_and_continue_as_read(m_shared_group, m_history); // Throws
+        throw;
+    }
+    if (!is_valid) {
+        LangBindHelper::rollback_and_continue_as_read(m_shared_group, m_history); // Throws
+        return false;
+    }
+    LangBindHelper::commit_and_continue_as_read(m_shared_group); // Throws
+    m_writes.clear();
+    m_reads.clear();
+    return true;
+}
+
+inline bool OptimisticTransaction::validate(const ChangeSet& changes)
+{
+    if (changes.table_set_changed) {
+        m_conflict_table_ndx = npos;
+        return false;
+    }
+    typedef std::vector<Read>::const_iterator read_iter;
+    for (read_iter i = m_reads.begin(), end = m_reads.end(); i != end; ++i) {
+        if (const TableChangeSet* t = changes.get_table(i->table_ndx)) {
+            if (i->row_ndx == npos || conflicts(*t, i->row_ndx)) {
+                m_conflict_table_ndx = i->table_ndx;
+                return false;
+            }
+        }
+    }
+    using sgf = _impl::SharedGroupFriend;
+    const Group& group = sgf::get_group(m_shared_group);
+    typedef std::vector<Write>::const_iterator write_iter;
+    for (write_iter i = m_writes.begin(), end = m_writes.end(); i != end; ++i) {
+        if (const TableChangeSet* t = changes.get_table(i->table_ndx)) {
+            if (t->schema_changed || is_reordered(*t) ||
+                is_shifted(*t, group.get_table(t->table_ndx)->size())) { // Throws
+                m_conflict_table_ndx = i->table_ndx;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+inline bool OptimisticTransaction::conflicts(const TableChangeSet& t, std::size_t row_ndx) REALM_NOEXCEPT
+{
+    if (t.schema_changed || is_reordered(t) || t.modifications.contains(row_ndx))
+        return true;
+    // Insertions at or below the row shift it
+    return !t.insertions.empty() && t.insertions.begin()->first <= row_ndx;
+}
+
+inline bool OptimisticTransaction::is_reordered(const TableChangeSet& t) REALM_NOEXCEPT
+{
+    return t.cleared || !t.deletions.empty() || !t.moves.empty();
+}
+
+inline bool OptimisticTransaction::is_shifted(const TableChangeSet& t,
+                                              std::size_t num_rows) REALM_NOEXCEPT
+{
+    // Only called if no rows were removed, so the rows of the old version
+    // keep their indexes unless rows were inserted below the old size.
+    if (t.insertions.empty())
+        return false;
+    std::size_t old_num_rows = num_rows - t.insertions.count();
+    return t.insertions.begin()->first < old_num_rows;
+}
+
+} // namespace realm
+
+#endif // REALM_OPTIMISTIC_TRANSACTION_HPP
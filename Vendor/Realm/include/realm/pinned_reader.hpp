@@ -0,0 +1,172 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_PINNED_READER_HPP
+#define REALM_PINNED_READER_HPP
+
+#include <chrono>
+
+#include <realm/group_shared.hpp>
+#include <realm/lang_bind_helper.hpp>
+
+namespace realm {
+
+/// Keeps the read lock of a SharedGroup between consecutive read
+/// transactions, for threads that run many short reads.
+///
+/// SharedGroup::begin_read() takes a reader slot in the ring buffer of the
+/// lock file, and attaches the group, and end_read() releases the slot and
+/// detaches the group along with all its table accessors. With many reader
+/// threads, the slot of the latest version is contended by all of them, and
+/// every read pays for recreating its accessors.
+///
+/// A pinned reader ends a read transaction without releasing anything. When
+/// the next one begins, it asks SharedGroup::has_changed() whether a newer
+/// version was committed in the meantime. If not, which is the common case
+/// for read-mostly workloads, the previous snapshot is still the latest, and
+/// it is reused as is, with its accessors. Otherwise the reader moves to the
+/// latest version, through LangBindHelper::advance_read() when a history is
+/// given, which keeps the accessors, and by a new begin_read() when not:
+///
+///     PinnedReader reader(sg, history);
+///     for (;;) {
+///         const Group& group = reader.begin_read();
+///         ...
+///         reader.end_read();
+///     }
+///
+/// While pinned, the reader holds on to its version, which prevents the
+/// space of versions that are later superseded from being reused. To bound
+/// that, end_read() releases the version once it has been held for longer
+/// than the maximum pin age given to the constructor. A version is
+/// otherwise held until the next begin_read(), or until release(), which
+/// threads must call before going idle, because an idle thread cannot
+/// release anything by itself.
+///
+/// This does not change how reader slots are acquired. That protocol is
+/// compiled into the core library and shared with other processes, so a
+/// reader that needs a new slot contends for it as before.
+///
+/// Like SharedGroup, a pinned reader must only be used by one thread at a
+/// time.
+class PinnedReader {
+public:
+    typedef std::chrono::steady_clock clock;
+
+    explicit PinnedReader(SharedGroup&, History* = nullptr,
+                          clock::duration max_pin_age = std::chrono::seconds(1)) REALM_NOEXCEPT;
+    ~PinnedReader() REALM_NOEXCEPT;
+
+    /// Begin a read transaction on the latest version. The returned group
+    /// remains valid until end_read().
+    const Group& begin_read();
+
+    /// End the read transaction, and keep the read lock, unless it was
+    /// taken longer than the maximum pin age ago.
+    void end_read() REALM_NOEXCEPT;
+
+    /// Release the read lock, if held. Must not be called during a read
+    /// transaction.
+    void release() REALM_NOEXCEPT;
+
+    bool is_pinned() const REALM_NOEXCEPT { return m_is_pinned; }
+
+    /// Number of read transactions that reused the pinned snapshot, and the
+    /// number that had to move to a newer version.
+    uint_fast64_t get_num_reused() const REALM_NOEXCEPT { return m_num_reused; }
+    uint_fast64_t get_num_refreshed() const REALM_NOEXCEPT { return m_num_refreshed; }
+
+private:
+    SharedGroup& m_shared_group;
+    History* m_history;
+    const clock::duration m_max_pin_age;
+    clock::time_point m_pinned_at; // When the current version was bound
+    bool m_is_pinned = false;
+    bool m_in_transaction = false;
+    uint_fast64_t m_num_reused = 0;
+    uint_fast64_t m_num_refreshed = 0;
+};
+
+
+
+
+// Implementation:
+
+inline PinnedReader::PinnedReader(SharedGroup& sg, History* history,
+                                  clock::duration max_pin_age) REALM_NOEXCEPT:
+    m_shared_group(sg),
+    m_history(history),
+    m_max_pin_age(max_pin_age)
+{
+}
+
+inline PinnedReader::~PinnedReader() REALM_NOEXCEPT
+{
+    m_in_transaction = false;
+    release();
+}
+
+inline const Group& PinnedReader::begin_read()
+{
+    REALM_ASSERT(!m_in_transaction);
+    using sgf = _impl::SharedGroupFriend;
+    if (!m_is_pinned) {
+        m_shared_group.begin_read(); // Throws
+        m_is_pinned = true;
+        m_pinned_at = clock::now();
+    }
+    else if (!m_shared_group.has_changed()) {
+        ++m_num_reused;
+    }
+    else {
+        if (m_history) {
+            LangBindHelper::advance_read(m_shared_group, *m_history); // Throws
+        }
+        else {
+            m_shared_group.end_read();
+            m_is_pinned = false;
+            m_shared_group.begin_read(); // Throws
+            m_is_pinned = true;
+        }
+        m_pinned_at = clock::now();
+        ++m_num_refreshed;
+    }
+    m_in_transaction = true;
+    return sgf::get_group(m_shared_group);
+}
+
+inline void PinnedReader::end_read() REALM_NOEXCEPT
+{
+    m_in_transaction = false;
+    if (clock::now() - m_pinned_at > m_max_pin_age)
+        release();
+}
+
+inline void PinnedReader::release() REALM_NOEXCEPT
+{
+    REALM_ASSERT(!m_in_transaction);
+    if (m_is_pinned) {
+        m_shared_group.end_read();
+        m_is_pinned = false;
+    }
+}
+
+} // namespace realm
+
+#endif // REALM_PINNED_READER_HPP
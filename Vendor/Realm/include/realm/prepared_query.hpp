@@ -0,0 +1,473 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_PREPARED_QUERY_HPP
+#define REALM_PREPARED_QUERY_HPP
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <realm/exceptions.hpp>
+#include <realm/handover_defs.hpp>
+#include <realm/unicode.hpp>
+#include <realm/table.hpp>
+#include <realm/table_view.hpp>
+#include <realm/query.hpp>
+#include <realm/query_engine.hpp>
+#include <realm/query_conditions.hpp>
+
+namespace realm {
+
+struct PreparedQuery_Handover_patch {
+    Query_Handover_patch query_patch;
+};
+
+
+/// A query whose constants can be changed between runs.
+///
+/// Every Query::equal(), greater(), etc. allocates a node, and a query that
+/// is run again with other constants must be built again. A prepared query
+/// is built once, with a parameter in place of each constant that varies,
+/// and its parameters are then bound to new values in place:
+///
+///     PreparedQuery query(table->where().equal(kind_col, 2));
+///     std::size_t id_param = query.add_condition<Equal>(id_col, int64_t(0));
+///     ...
+///     query.set_int(id_param, id);
+///     TableView view = query.get_query().find_all();
+///
+/// Parameters can be combined with the other conditions, groups and Or() of
+/// the underlying query (get_query()), in the usual order of calls.
+///
+/// Integer, float and double parameters are bound by overwriting the value
+/// of their node. String parameters reuse the buffers of their node when the
+/// new value fits. Anything derived from the values, such as search index
+/// lookups, is computed when the query is run, as for any other query.
+///
+/// A prepared query is not thread safe. Copy it, or hand it over (see
+/// SharedGroup::export_for_handover()), to use it on another thread. The
+/// copy has the same parameters.
+class PreparedQuery {
+public:
+    typedef PreparedQuery_Handover_patch Handover_patch;
+
+    /// Start with a copy of the specified query.
+    explicit PreparedQuery(const Query&);
+    PreparedQuery(const PreparedQuery&);
+    virtual ~PreparedQuery() REALM_NOEXCEPT {}
+
+    //@{
+    /// Add a condition on the specified column, with \a value as the initial
+    /// value of the parameter, and return the index of the parameter. \a Cond
+    /// is one of Equal, NotEqual, Greater, GreaterEqual, Less and LessEqual,
+    /// and for strings, Equal, NotEqual, BeginsWith, EndsWith and Contains,
+    /// or one of their case insensitive variants (EqualIns etc.).
+    ///
+    /// Throws LogicError::type_mismatch if the column does not produce a
+    /// condition node of the expected type.
+    template<class Cond> std::size_t add_condition(std::size_t column_ndx, int64_t value);
+    template<class Cond> std::size_t add_condition(std::size_t column_ndx, float value);
+    template<class Cond> std::size_t add_condition(std::size_t column_ndx, double value);
+    template<class Cond> std::size_t add_condition(std::size_t column_ndx, StringData value);
+    //@}
+
+    //@{
+    /// Bind a new value to a parameter. The type must match the type of the
+    /// value given to add_condition(). A null string binds null, as opposed
+    /// to the empty string. If set_string() throws, the previous value
+    /// remains bound.
+    void set_int(std::size_t param_ndx, int64_t value) REALM_NOEXCEPT;
+    void set_float(std::size_t param_ndx, float value) REALM_NOEXCEPT;
+    void set_double(std::size_t param_ndx, double value) REALM_NOEXCEPT;
+    void set_string(std::size_t param_ndx, StringData value);
+    //@}
+
+    std::size_t get_num_params() const REALM_NOEXCEPT { return m_params.size(); }
+
+    /// The underlying query, for adding fixed conditions and for running it.
+    Query& get_query() REALM_NOEXCEPT { return m_query; }
+
+    // Handover, see SharedGroup::export_for_handover()
+    virtual std::unique_ptr<PreparedQuery> clone_for_handover(std::unique_ptr<Handover_patch>& patch,
+                                                              ConstSourcePayload mode) const;
+    virtual std::unique_ptr<PreparedQuery> clone_for_handover(std::unique_ptr<Handover_patch>& patch,
+                                                              MutableSourcePayload mode);
+    virtual void apply_and_consume_patch(std::unique_ptr<Handover_patch>& patch, Group& group);
+
+private:
+    struct Param {
+        // Index of the node in Query::all_nodes, which copies of the query
+        // preserve
+        std::size_t node_ndx;
+        DataType type;
+        union {
+            void (*set_int)(ParentNode*, int64_t);
+            void (*set_float)(ParentNode*, float);
+            void (*set_double)(ParentNode*, double);
+            void (*set_string)(ParentNode*, StringData, std::size_t& capacity);
+        };
+        // For strings, the longest value that fits in the buffers of the node
+        std::size_t capacity;
+    };
+
+    Query m_query;
+    std::vector<Param> m_params;
+
+    PreparedQuery(const PreparedQuery& source, Handover_patch& patch, ConstSourcePayload mode);
+    PreparedQuery(PreparedQuery& source, Handover_patch& patch, MutableSourcePayload mode);
+
+    // Add the node for the condition through the corresponding Query
+    // function
+    template<class T> static void add_node(Query&, std::size_t col, T value, Equal);
+    template<class T> static void add_node(Query&, std::size_t col, T value, NotEqual);
+    template<class T> static void add_node(Query&, std::size_t col, T value, Greater);
+    template<class T> static void add_node(Query&, std::size_t col, T value, GreaterEqual);
+    template<class T> static void add_node(Query&, std::size_t col, T value, Less);
+    template<class T> static void add_node(Query&, std::size_t col, T value, LessEqual);
+    static void add_node(Query&, std::size_t col, StringData value, EqualIns);
+    static void add_node(Query&, std::size_t col, StringData value, NotEqualIns);
+    static void add_node(Query&, std::size_t col, StringData value, BeginsWith);
+    static void add_node(Query&, std::size_t col, StringData value, BeginsWithIns);
+    static void add_node(Query&, std::size_t col, StringData value, EndsWith);
+    static void add_node(Query&, std::size_t col, StringData value, EndsWithIns);
+    static void add_node(Query&, std::size_t col, StringData value, Contains);
+    static void add_node(Query&, std::size_t col, StringData value, ContainsIns);
+
+    template<class Node, class Cond, class T> Param& add_param(std::size_t column_ndx, T value, DataType);
+    ParentNode* get_node(const Param&) REALM_NOEXCEPT;
+    void reset_capacities() REALM_NOEXCEPT;
+
+    template<class Cond> static void set_int_node(ParentNode*, int64_t) REALM_NOEXCEPT;
+    template<class Cond> static void set_float_node(ParentNode*, float) REALM_NOEXCEPT;
+    template<class Cond> static void set_double_node(ParentNode*, double) REALM_NOEXCEPT;
+    template<class Cond> static void set_string_node(ParentNode*, StringData, std::size_t& capacity);
+    static void set_string_value(StringNodeBase&, StringData, std::unique_ptr<char[]>& buffer) REALM_NOEXCEPT;
+    static void set_string_cases(StringNode<Equal>&, StringData, bool) {}
+    template<class Cond> static void set_string_cases(StringNode<Cond>&, StringData, bool reuse);
+};
+
+
+
+
+// Implementation:
+
+inline PreparedQuery::PreparedQuery(const Query& query):
+    m_query(query, Query::TCopyExpressionTag())
+{
+}
+
+inline PreparedQuery::PreparedQuery(const PreparedQuery& source):
+    m_query(source.m_query, Query::TCopyExpressionTag()),
+    m_params(source.m_params)
+{
+    reset_capacities();
+}
+
+inline PreparedQuery::PreparedQuery(const PreparedQuery& source, Handover_patch& patch,
+                                    ConstSourcePayload mode):
+    m_query(source.m_query, patch.query_patch, mode),
+    m_params(source.m_params)
+{
+    reset_capacities();
+}
+
+inline PreparedQuery::PreparedQuery(PreparedQuery& source, Handover_patch& patch, MutableSourcePayload mode):
+    m_query(source.m_query, patch.query_patch, mode),
+    m_params(source.m_params)
+{
+    reset_capacities();
+}
+
+template<class T> inline void PreparedQuery::add_node(Query& q, std::size_t col, T value, Equal)
+{
+    q.equal(col, value); // Throws
+}
+
+template<class T> inline void PreparedQuery::add_node(Query& q, std::size_t col, T value, NotEqual)
+{
+    q.not_equal(col, value); // Throws
+}
+
+template<class T> inline void PreparedQuery::add_node(Query& q, std::size_t col, T value, Greater)
+{
+    q.greater(col, value); // Throws
+}
+
+template<class T> inline void PreparedQuery::add_node(Query& q, std::size_t col, T value, GreaterEqual)
+{
+    q.greater_equal(col, value); // Throws
+}
+
+template<class T> inline void PreparedQuery::add_node(Query& q, std::size_t col, T value, Less)
+{
+    q.less(col, value); // Throws
+}
+
+template<class T> inline void PreparedQuery::add_node(Query& q, std::size_t col, T value, LessEqual)
+{
+    q.less_equal(col, value); // Throws
+}
+
+inline void PreparedQuery::add_node(Query& q, std::size_t col, StringData value, EqualIns)
+{
+    q.equal(col, value, false); // Throws
+}
+
+inline void PreparedQuery::add_node(Query& q, std::size_t col, StringData value, NotEqualIns)
+{
+    q.not_equal(col, value, false); // Throws
+}
+
+inline void PreparedQuery::add_node(Query& q, std::size_t col, StringData value, BeginsWith)
+{
+    q.begins_with(col, value); // Throws
+}
+
+inline void PreparedQuery::add_node(Query& q, std::size_t col, StringData value, BeginsWithIns)
+{
+    q.begins_with(col, value, false); // Throws
+}
+
+inline void PreparedQuery::add_node(Query& q, std::size_t col, StringData value, EndsWith)
+{
+    q.ends_with(col, value); // Throws
+}
+
+inline void PreparedQuery::add_node(Query& q, std::size_t col, StringData value, EndsWithIns)
+{
+    q.ends_with(col, value, false); // Throws
+}
+
+inline void PreparedQuery::add_node(Query& q, std::size_t col, StringData value, Contains)
+{
+    q.contains(col, value); // Throws
+}
+
+inline void PreparedQuery::add_node(Query& q, std::size_t col, StringData value, ContainsIns)
+{
+    q.contains(col, value, false); // Throws
+}
+
+template<class Node, class Cond, class T>
+PreparedQuery::Param& PreparedQuery::add_param(std::size_t column_ndx, T value, DataType type)
+{
+    m_params.reserve(m_params.size() + 1); // Throws
+    std::size_t node_ndx = m_query.all_nodes.size();
+    add_node(m_query, column_ndx, value, Cond()); // Throws
+    if (m_query.all_nodes.size() != node_ndx + 1 || !dynamic_cast<Node*>(m_query.all_nodes.back()))
+        throw LogicError(LogicError::type_mismatch);
+    Param param;
+    param.node_ndx = node_ndx;
+    param.type = type;
+    param.capacity = 0;
+    m_params.push_back(param);
+    return m_params.back();
+}
+
+inline void PreparedQuery::reset_capacities() REALM_NOEXCEPT
+{
+    // The copy constructor of a string node allocates its value buffer to
+    // fit the value exactly
+    for (Param& param: m_params) {
+        if (param.type == type_String)
+            param.capacity = 0;
+    }
+}
+
+template<class Cond> std::size_t PreparedQuery::add_condition(std::size_t column_ndx, int64_t value)
+{
+    Param& param = add_param<IntegerNode<int64_t, Cond>, Cond>(column_ndx, value, type_Int); // Throws
+    param.set_int = &set_int_node<Cond>;
+    return m_params.size() - 1;
+}
+
+template<class Cond> std::size_t PreparedQuery::add_condition(std::size_t column_ndx, float value)
+{
+    Param& param = add_param<FloatDoubleNode<FloatColumn, Cond>, Cond>(column_ndx, value,
+                                                                      type_Float); // Throws
+    param.set_float = &set_float_node<Cond>;
+    return m_params.size() - 1;
+}
+
+template<class Cond> std::size_t PreparedQuery::add_condition(std::size_t column_ndx, double value)
+{
+    Param& param = add_param<FloatDoubleNode<DoubleColumn, Cond>, Cond>(column_ndx, value,
+                                                                       type_Double); // Throws
+    param.set_double = &set_double_node<Cond>;
+    return m_params.size() - 1;
+}
+
+template<class Cond> std::size_t PreparedQuery::add_condition(std::size_t column_ndx, StringData value)
+{
+    Param& param = add_param<StringNode<Cond>, Cond>(column_ndx, value, type_String); // Throws
+    param.set_string = &set_string_node<Cond>;
+    // The constructor of the node allocates room for 6 times the size of
+    // the value (for case conversion)
+    param.capacity = value.size();
+    return m_params.size() - 1;
+}
+
+inline ParentNode* PreparedQuery::get_node(const Param& param) REALM_NOEXCEPT
+{
+    return m_query.all_nodes[param.node_ndx];
+}
+
+inline void PreparedQuery::set_int(std::size_t param_ndx, int64_t value) REALM_NOEXCEPT
+{
+    const Param& param = m_params[param_ndx];
+    REALM_ASSERT_3(param.type, ==, type_Int);
+    param.set_int(get_node(param), value);
+}
+
+inline void PreparedQuery::set_float(std::size_t param_ndx, float value) REALM_NOEXCEPT
+{
+    const Param& param = m_params[param_ndx];
+    REALM_ASSERT_3(param.type, ==, type_Float);
+    param.set_float(get_node(param), value);
+}
+
+inline void PreparedQuery::set_double(std::size_t param_ndx, double value) REALM_NOEXCEPT
+{
+    const Param& param = m_params[param_ndx];
+    REALM_ASSERT_3(param.type, ==, type_Double);
+    param.set_double(get_node(param), value);
+}
+
+inline void PreparedQuery::set_string(std::size_t param_ndx, StringData value)
+{
+    Param& param = m_params[param_ndx];
+    REALM_ASSERT_3(param.type, ==, type_String);
+    param.set_string(get_node(param), value, param.capacity); // Throws
+}
+
+template<class Cond> void PreparedQuery::set_int_node(ParentNode* node, int64_t value) REALM_NOEXCEPT
+{
+    static_cast<IntegerNode<int64_t, Cond>*>(node)->m_value = value;
+}
+
+template<class Cond> void PreparedQuery::set_float_node(ParentNode* node, float value) REALM_NOEXCEPT
+{
+    static_cast<FloatDoubleNode<FloatColumn, Cond>*>(node)->m_value = value;
+}
+
+template<class Cond> void PreparedQuery::set_double_node(ParentNode* node, double value) REALM_NOEXCEPT
+{
+    static_cast<FloatDoubleNode<DoubleColumn, Cond>*>(node)->m_value = value;
+}
+
+inline void PreparedQuery::set_string_value(StringNodeBase& node, StringData value,
+                                            std::unique_ptr<char[]>& buffer) REALM_NOEXCEPT
+{
+    char* data = const_cast<char*>(node.m_value.data());
+    if (value.is_null()) {
+        delete[] data;
+        node.m_value = StringData();
+        return;
+    }
+    if (buffer) {
+        delete[] data;
+        data = buffer.release();
+    }
+    if (value.size() != 0)
+        std::memcpy(data, value.data(), value.size());
+    node.m_value = StringData(data, value.size());
+}
+
+template<class Cond>
+void PreparedQuery::set_string_cases(StringNode<Cond>& node, StringData value, bool reuse)
+{
+    // Nodes other than StringNode<Equal> keep upper and lower case versions
+    // of the value, in buffers of 6 times the size of the value, which the
+    // copy constructor relies on
+    std::unique_ptr<char[]> upper, lower;
+    if (!reuse) {
+        std::size_t buffer_size = 6 * value.size(); // FIXME: Arithmetic is prone to overflow
+        upper.reset(new char[buffer_size]); // Throws
+        lower.reset(new char[buffer_size]); // Throws
+    }
+    // Make room for the error message up front, so that nothing throws once
+    // the node is modified
+    const char prefix[] = "Malformed UTF-8: ";
+    node.error_code.reserve(sizeof prefix - 1 + value.size()); // Throws
+    char* upper_data = reuse ? const_cast<char*>(node.m_ucase) : upper.get();
+    char* lower_data = reuse ? const_cast<char*>(node.m_lcase) : lower.get();
+    bool b1 = case_map(value, lower_data, false);
+    bool b2 = case_map(value, upper_data, true);
+    if (!reuse) {
+        delete[] node.m_ucase;
+        delete[] node.m_lcase;
+        node.m_ucase = upper.release();
+        node.m_lcase = lower.release();
+    }
+    if (!b1 || !b2) {
+        node.error_code.assign(prefix);
+        node.error_code.append(value.data(), value.size());
+    }
+    else {
+        node.error_code.clear();
+    }
+}
+
+template<class Cond>
+void PreparedQuery::set_string_node(ParentNode* node, StringData value, std::size_t& capacity)
+{
+    StringNode<Cond>& string_node = static_cast<StringNode<Cond>&>(*node);
+    bool reuse = value.size() <= capacity && string_node.m_value.data();
+
+    // Allocate before anything is modified. A null value has no buffer, so
+    // the next value cannot reuse it.
+    std::unique_ptr<char[]> buffer;
+    if (!reuse && !value.is_null())
+        buffer.reset(new char[6 * value.size()]); // Throws
+    set_string_cases(string_node, value, reuse); // Throws
+    set_string_value(string_node, value, buffer);
+    if (value.is_null()) {
+        capacity = 0;
+    }
+    else if (!reuse) {
+        capacity = value.size();
+    }
+}
+
+inline std::unique_ptr<PreparedQuery>
+PreparedQuery::clone_for_handover(std::unique_ptr<Handover_patch>& patch, ConstSourcePayload mode) const
+{
+    patch.reset(new Handover_patch);
+    std::unique_ptr<PreparedQuery> retval(new PreparedQuery(*this, *patch, mode));
+    return retval;
+}
+
+inline std::unique_ptr<PreparedQuery>
+PreparedQuery::clone_for_handover(std::unique_ptr<Handover_patch>& patch, MutableSourcePayload mode)
+{
+    patch.reset(new Handover_patch);
+    std::unique_ptr<PreparedQuery> retval(new PreparedQuery(*this, *patch, mode));
+    return retval;
+}
+
+inline void PreparedQuery::apply_and_consume_patch(std::unique_ptr<Handover_patch>& patch, Group& group)
+{
+    m_query.apply_patch(patch->query_patch, group);
+    patch.reset();
+}
+
+} // namespace realm
+
+#endif // REALM_PREPARED_QUERY_HPP
@@ -0,0 +1,279 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_QUERY_CURSOR_HPP
+#define REALM_QUERY_CURSOR_HPP
+
+#include <memory>
+#include <vector>
+
+#include <realm/exceptions.hpp>
+#include <realm/handover_defs.hpp>
+#include <realm/table.hpp>
+#include <realm/table_view.hpp>
+#include <realm/query.hpp>
+
+namespace realm {
+
+struct QueryCursor_Handover_patch {
+    Query_Handover_patch query_patch;
+    std::size_t position;
+    std::size_t num_yielded;
+    bool is_at_end;
+};
+
+
+/// Streaming alternative to Query::find_all() for results that are consumed
+/// a page at a time.
+///
+/// find_all() collects every match into the row index column of a TableView
+/// before the first one can be read, which costs 8 bytes per match, and a
+/// full scan of the table, even if the caller only shows the first few rows.
+/// A cursor instead holds a copy of the query (its node chain) and the table
+/// row at which to resume, and runs the query only as far as needed for the
+/// next batch:
+///
+///     QueryCursor cursor(table->where().greater(age_col, 30));
+///     std::vector<std::size_t> rows;
+///     while (cursor.next_batch(rows) != 0) {
+///         ...
+///         rows.clear();
+///     }
+///
+/// Matches are produced in table order, in batches of at most batch_size
+/// rows (by default the size of a B+-tree leaf), so memory use is bounded by
+/// the batch size rather than by the number of matches.
+///
+/// Row indexes refer to the version of the table at which the cursor was
+/// created or last reset. Once the table is modified, is_in_sync() returns
+/// false, and the cursor must be reset() before the next batch, because the
+/// resume position may no longer be meaningful.
+///
+/// Cursors can be handed over to another thread through
+/// SharedGroup::export_for_handover() and import_from_handover(), like
+/// queries and table views. The imported cursor resumes where the exported
+/// one left off.
+///
+/// Queries that are restricted by a table view or a link view are not
+/// supported, because their matches are not found in table order. The
+/// constructor throws LogicError::illegal_combination for those.
+class QueryCursor {
+public:
+    typedef QueryCursor_Handover_patch Handover_patch;
+
+    explicit QueryCursor(const Query& query, std::size_t batch_size = REALM_MAX_BPNODE_SIZE);
+    virtual ~QueryCursor() REALM_NOEXCEPT {}
+
+    /// Append the index of the next matching rows to \a rows, at most
+    /// batch_size of them. Returns the number of rows appended, which is
+    /// zero only when there are no more matches.
+    ///
+    /// Throws LogicError::bad_version if the table was modified since the
+    /// cursor was created or reset.
+    std::size_t next_batch(std::vector<std::size_t>& rows);
+
+    /// Skip the next \a n matches, for example to jump to a page. Returns the
+    /// number of matches actually skipped.
+    std::size_t skip(std::size_t n);
+
+    bool is_at_end() const REALM_NOEXCEPT { return m_is_at_end; }
+
+    /// Number of matches produced (or skipped) so far.
+    std::size_t get_num_yielded() const REALM_NOEXCEPT { return m_num_yielded; }
+
+    /// The table row at which the next batch starts searching.
+    std::size_t get_position() const REALM_NOEXCEPT { return m_position; }
+
+    std::size_t get_batch_size() const REALM_NOEXCEPT { return m_batch_size; }
+    void set_batch_size(std::size_t batch_size) REALM_NOEXCEPT;
+
+    bool is_in_sync() const REALM_NOEXCEPT;
+
+    /// Start over from the first row of the current version of the table.
+    void reset() REALM_NOEXCEPT;
+
+    // Handover, see SharedGroup::export_for_handover()
+    virtual std::unique_ptr<QueryCursor> clone_for_handover(std::unique_ptr<Handover_patch>& patch,
+                                                            ConstSourcePayload mode) const;
+    virtual std::unique_ptr<QueryCursor> clone_for_handover(std::unique_ptr<Handover_patch>& patch,
+                                                            MutableSourcePayload mode);
+    virtual void apply_and_consume_patch(std::unique_ptr<Handover_patch>& patch, Group& group);
+
+private:
+    Query m_query;
+    std::size_t m_batch_size;
+    std::size_t m_position;
+    std::size_t m_num_yielded;
+    bool m_is_at_end;
+    uint_fast64_t m_version;
+
+    QueryCursor(const QueryCursor& source, Handover_patch& patch, ConstSourcePayload mode);
+    QueryCursor(QueryCursor& source, Handover_patch& patch, MutableSourcePayload mode);
+
+    uint_fast64_t get_table_version() const REALM_NOEXCEPT;
+
+    /// Append at most \a limit of the next matches to \a rows.
+    std::size_t find_next(std::vector<std::size_t>& rows, std::size_t limit);
+};
+
+
+
+
+// Implementation:
+
+inline QueryCursor::QueryCursor(const Query& query, std::size_t batch_size):
+    m_query(query, Query::TCopyExpressionTag()),
+    m_batch_size(std::max(std::size_t(1), batch_size)),
+    m_position(0),
+    m_num_yielded(0),
+    m_is_at_end(false),
+    m_version(get_table_version())
+{
+    // Set for both table views and link views
+    if (query.m_view)
+        throw LogicError(LogicError::illegal_combination);
+}
+
+inline QueryCursor::QueryCursor(const QueryCursor& source, Handover_patch& patch, ConstSourcePayload mode):
+    m_query(source.m_query, patch.query_patch, mode),
+    m_batch_size(source.m_batch_size),
+    m_position(source.m_position),
+    m_num_yielded(source.m_num_yielded),
+    m_is_at_end(source.m_is_at_end),
+    m_version(0)
+{
+    patch.position = m_position;
+    patch.num_yielded = m_num_yielded;
+    patch.is_at_end = m_is_at_end;
+}
+
+inline QueryCursor::QueryCursor(QueryCursor& source, Handover_patch& patch, MutableSourcePayload mode):
+    m_query(source.m_query, patch.query_patch, mode),
+    m_batch_size(source.m_batch_size),
+    m_position(source.m_position),
+    m_num_yielded(source.m_num_yielded),
+    m_is_at_end(source.m_is_at_end),
+    m_version(0)
+{
+    patch.position = m_position;
+    patch.num_yielded = m_num_yielded;
+    patch.is_at_end = m_is_at_end;
+}
+
+inline uint_fast64_t QueryCursor::get_table_version() const REALM_NOEXCEPT
+{
+    const TableRef& table = const_cast<Query&>(m_query).get_table();
+    return table && table->is_attached() ? _impl::TableFriend::get_version(*table) : 0;
+}
+
+inline bool QueryCursor::is_in_sync() const REALM_NOEXCEPT
+{
+    const TableRef& table = const_cast<Query&>(m_query).get_table();
+    return table && table->is_attached() && m_version == get_table_version();
+}
+
+inline void QueryCursor::set_batch_size(std::size_t batch_size) REALM_NOEXCEPT
+{
+    m_batch_size = std::max(std::size_t(1), batch_size);
+}
+
+inline void QueryCursor::reset() REALM_NOEXCEPT
+{
+    m_position = 0;
+    m_num_yielded = 0;
+    m_is_at_end = false;
+    m_version = get_table_version();
+}
+
+inline std::size_t QueryCursor::find_next(std::vector<std::size_t>& rows, std::size_t limit)
+{
+    if (m_is_at_end)
+        return 0;
+    if (!is_in_sync())
+        throw LogicError(LogicError::bad_version);
+
+    // The limit stops the search at the last match of the batch, so the
+    // part of the table after it is not visited yet.
+    TableView view = m_query.find_all(m_position, size_t(-1), limit); // Throws
+    std::size_t n = view.size();
+    rows.reserve(rows.size() + n); // Throws
+    for (std::size_t i = 0; i < n; ++i)
+        rows.push_back(view.get_source_ndx(i));
+    m_num_yielded += n;
+    if (n < limit) {
+        m_is_at_end = true;
+        m_position = m_query.get_table()->size();
+    }
+    else {
+        m_position = rows.back() + 1;
+    }
+    return n;
+}
+
+inline std::size_t QueryCursor::next_batch(std::vector<std::size_t>& rows)
+{
+    return find_next(rows, m_batch_size); // Throws
+}
+
+inline std::size_t QueryCursor::skip(std::size_t n)
+{
+    std::size_t num_skipped = 0;
+    std::vector<std::size_t> rows;
+    while (num_skipped < n) {
+        // Never read past the last match to be skipped
+        rows.clear();
+        std::size_t m = find_next(rows, std::min(m_batch_size, n - num_skipped)); // Throws
+        if (m == 0)
+            break;
+        num_skipped += m;
+    }
+    return num_skipped;
+}
+
+inline std::unique_ptr<QueryCursor>
+QueryCursor::clone_for_handover(std::unique_ptr<Handover_patch>& patch, ConstSourcePayload mode) const
+{
+    patch.reset(new Handover_patch);
+    std::unique_ptr<QueryCursor> retval(new QueryCursor(*this, *patch, mode));
+    return retval;
+}
+
+inline std::unique_ptr<QueryCursor>
+QueryCursor::clone_for_handover(std::unique_ptr<Handover_patch>& patch, MutableSourcePayload mode)
+{
+    patch.reset(new Handover_patch);
+    std::unique_ptr<QueryCursor> retval(new QueryCursor(*this, *patch, mode));
+    return retval;
+}
+
+inline void QueryCursor::apply_and_consume_patch(std::unique_ptr<Handover_patch>& patch, Group& group)
+{
+    m_query.apply_patch(patch->query_patch, group);
+    m_position = patch->position;
+    m_num_yielded = patch->num_yielded;
+    m_is_at_end = patch->is_at_end;
+    // Handover requires both sides to be at the same version, so the resume
+    // position remains valid
+    m_version = get_table_version();
+    patch.reset();
+}
+
+} // namespace realm
+
+#endif // REALM_QUERY_CURSOR_HPP
@@ -933,6 +933,8 @@ public:
 protected:
     TConditionValue m_value;
     SequentialGetter<ColType> m_condition_column;
+
+    friend class PreparedQuery;
 };
 
 
@@ -1078,6 +1080,7 @@ protected:
     size_t m_leaf_start;
     size_t m_leaf_end;
 
+    friend class PreparedQuery;
 };
 
 // Conditions for strings. Note that Equal is specialized later in this file!
@@ -1181,6 +1184,8 @@ public:
 protected:
     const char* m_lcase;
     const char* m_ucase;
+
+    friend class PreparedQuery;
 };
 
 
@@ -313,6 +313,7 @@ private:
     {
     }
     friend class SharedGroup;
+    friend class HandoverBatch;
 };
 
 typedef BasicRow<Table> Row;
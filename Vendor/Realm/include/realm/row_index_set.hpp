@@ -0,0 +1,565 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_ROW_INDEX_SET_HPP
+#define REALM_ROW_INDEX_SET_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include <realm/column.hpp>
+#include <realm/column_basic.hpp>
+#include <realm/table.hpp>
+#include <realm/query.hpp>
+#include <realm/query_cursor.hpp>
+#include <realm/utilities.hpp>
+#include <realm/views.hpp>
+
+namespace realm {
+
+/// Compact, read-only copy of the row indexes of a table view or link view
+/// (see RowIndexes), in one of three representations:
+///
+///  - kind_ranges: runs of consecutive row indexes, as (first row, position
+///    in the view) pairs. A view produced by a broad filter ("not deleted")
+///    over a table is mostly a few long runs, and costs 16 bytes per run
+///    instead of a few bytes per row.
+///
+///  - kind_bitmap: one bit per table row up to the last row in the view,
+///    with a rank directory for positional access. Used for views in
+///    ascending order that select a large fraction of the rows without
+///    forming long runs.
+///
+///  - kind_packed: each row index in 1, 2, 4 or 8 bytes, in view order. Used
+///    for sparse or unordered views, and for views with detached rows.
+///
+/// The representation with the smallest size is chosen when the set is
+/// built. size() and get_source_ndx() work on every representation, and
+/// for_each_range() presents the rows as runs, which lets the aggregate
+/// functions use the column level range aggregates (Column::sum() and
+/// friends) on each run, instead of looking up one row at a time.
+///
+/// The set is a snapshot. It does not follow changes to the view or the
+/// table.
+class RowIndexSet {
+public:
+    enum Kind {
+        kind_ranges,
+        kind_bitmap,
+        kind_packed
+    };
+
+    RowIndexSet() REALM_NOEXCEPT;
+    explicit RowIndexSet(const RowIndexes& view);
+    explicit RowIndexSet(const std::vector<std::size_t>& rows);
+
+    /// The rows that match the query, in table order. The matches are
+    /// streamed through a QueryCursor, so no TableView is materialized, and
+    /// memory use while building is bounded by one bit per table row plus
+    /// the runs found so far. The same restrictions as for QueryCursor apply,
+    /// so a query that is restricted by a view throws
+    /// LogicError::illegal_combination.
+    explicit RowIndexSet(Query& query);
+
+    Kind get_kind() const REALM_NOEXCEPT { return m_kind; }
+    std::size_t size() const REALM_NOEXCEPT { return m_size; }
+    bool is_empty() const REALM_NOEXCEPT { return m_size == 0; }
+
+    /// Same as TableViewBase::get_source_ndx(). Constant time for packed sets,
+    /// logarithmic in the number of runs or bitmap blocks otherwise.
+    std::size_t get_source_ndx(std::size_t ndx) const REALM_NOEXCEPT;
+
+    /// Approximate number of bytes used.
+    std::size_t get_byte_size() const REALM_NOEXCEPT;
+
+    /// Call \a handler with each row index in order. Detached rows are
+    /// passed as detached_ref.
+    template<class F> void for_each(F handler) const;
+
+    /// Call \a handler with (begin, end) for each run of consecutive,
+    /// attached rows, in order.
+    template<class F> void for_each_range(F handler) const;
+
+    // Aggregates over a column of the table that the row indexes refer to.
+    // Null values are skipped.
+    int64_t sum_int(const Table&, std::size_t column_ndx) const;
+    double sum_float(const Table&, std::size_t column_ndx) const;
+    double sum_double(const Table&, std::size_t column_ndx) const;
+    int64_t maximum_int(const Table&, std::size_t column_ndx) const;
+    float maximum_float(const Table&, std::size_t column_ndx) const;
+    double maximum_double(const Table&, std::size_t column_ndx) const;
+    int64_t minimum_int(const Table&, std::size_t column_ndx) const;
+    float minimum_float(const Table&, std::size_t column_ndx) const;
+    double minimum_double(const Table&, std::size_t column_ndx) const;
+    double average_int(const Table&, std::size_t column_ndx) const;
+    double average_float(const Table&, std::size_t column_ndx) const;
+    double average_double(const Table&, std::size_t column_ndx) const;
+
+private:
+    static const std::size_t words_per_block = 8;
+
+    Kind m_kind;
+    std::size_t m_size;
+
+    // kind_ranges
+    std::vector<std::size_t> m_range_rows; // First row of each run
+    std::vector<std::size_t> m_range_positions; // Position of that row in the view
+
+    // kind_bitmap
+    std::vector<uint64_t> m_words;
+    std::vector<std::size_t> m_block_ranks; // Bits set before each block
+
+    // kind_packed
+    std::vector<char> m_packed;
+    std::size_t m_width; // Bytes per row index
+
+    template<class R> void build(R row_at, std::size_t n);
+    void build_ascending(QueryCursor&, std::size_t table_size);
+
+    std::size_t get_packed(std::size_t ndx) const REALM_NOEXCEPT;
+    static std::size_t lowest_bit(uint64_t word) REALM_NOEXCEPT;
+
+    /// Reduce the column over all runs. \a range_op(column, begin, end)
+    /// reduces one run with the column's own aggregate; \a row_op(table, row)
+    /// is used when the column type has no range aggregate (nullable
+    /// integers). Returns the number of values.
+    template<class C, class T, class RangeOp, class RowOp, class Combine>
+    std::size_t reduce(const Table&, std::size_t column_ndx, RangeOp range_op, RowOp row_op,
+                       Combine combine, T& result) const;
+
+    template<class C, class T> T sum(const Table&, std::size_t column_ndx, std::size_t* count = nullptr) const;
+    template<class C, class T> T extreme(const Table&, std::size_t column_ndx, bool is_max) const;
+};
+
+
+
+
+// Implementation:
+
+inline RowIndexSet::RowIndexSet() REALM_NOEXCEPT:
+    m_kind(kind_ranges),
+    m_size(0),
+    m_width(1)
+{
+}
+
+inline RowIndexSet::RowIndexSet(const RowIndexes& view):
+    m_kind(kind_ranges),
+    m_size(0),
+    m_width(1)
+{
+    const IntegerColumn& rows = view.m_row_indexes;
+    build([&rows](std::size_t i) { return std::size_t(rows.get(i)); }, rows.size()); // Throws
+}
+
+inline RowIndexSet::RowIndexSet(const std::vector<std::size_t>& rows):
+    m_kind(kind_ranges),
+    m_size(0),
+    m_width(1)
+{
+    build([&rows](std::size_t i) { return rows[i]; }, rows.size()); // Throws
+}
+
+inline RowIndexSet::RowIndexSet(Query& query):
+    m_kind(kind_ranges),
+    m_size(0),
+    m_width(1)
+{
+    QueryCursor cursor(query);
+    build_ascending(cursor, query.get_table()->size()); // Throws
+}
+
+inline void RowIndexSet::build_ascending(QueryCursor& cursor, std::size_t table_size)
+{
+    // The rows arrive in ascending order, one batch at a time, so collect
+    // the runs and the bitmap as they come, and pick the representation at
+    // the end. The bitmap can never be bigger than one covering the whole
+    // table, so runs are no longer collected once they exceed that.
+    std::size_t max_num_words = table_size / 64 + 1;
+    std::size_t max_bitmap_size = max_num_words * 8 + (max_num_words / words_per_block + 1) * sizeof (std::size_t);
+    bool has_ranges = true;
+    std::size_t n = 0;
+    std::size_t prev = 0;
+    std::vector<std::size_t> rows;
+    while (cursor.next_batch(rows) != 0) { // Throws
+        for (std::size_t row: rows) {
+            if (row / 64 >= m_words.size())
+                m_words.resize(row / 64 + 1); // Throws
+            m_words[row / 64] |= uint64_t(1) << (row % 64);
+            if (has_ranges && (n == 0 || row != prev + 1)) {
+                if ((m_range_rows.size() + 1) * 2 * sizeof (std::size_t) > max_bitmap_size) {
+                    has_ranges = false;
+                    std::vector<std::size_t>().swap(m_range_rows);
+                    std::vector<std::size_t>().swap(m_range_positions);
+                }
+                else {
+                    m_range_rows.push_back(row); // Throws
+                    m_range_positions.push_back(n); // Throws
+                }
+            }
+            prev = row;
+            ++n;
+        }
+        rows.clear();
+    }
+
+    std::size_t max_row = n == 0 ? 0 : prev;
+    std::size_t width = 1;
+    while (width < sizeof (std::size_t) && (max_row + 1) >> (8 * width) != 0)
+        width *= 2;
+
+    std::size_t num_words = m_words.size();
+    std::size_t ranges_size = m_range_rows.size() * 2 * sizeof (std::size_t);
+    std::size_t bitmap_size = num_words * 8 + (num_words / words_per_block + 1) * sizeof (std::size_t);
+    std::size_t packed_size = n * width;
+
+    m_size = n;
+    if (has_ranges && ranges_size <= bitmap_size && ranges_size <= packed_size) {
+        m_kind = kind_ranges;
+        std::vector<uint64_t>().swap(m_words);
+    }
+    else if (bitmap_size <= packed_size) {
+        m_kind = kind_bitmap;
+        std::vector<std::size_t>().swap(m_range_rows);
+        std::vector<std::size_t>().swap(m_range_positions);
+        std::size_t rank = 0;
+        for (std::size_t i = 0; i < num_words; ++i) {
+            if (i % words_per_block == 0)
+                m_block_ranks.push_back(rank); // Throws
+            rank += fast_popcount64(int64_t(m_words[i]));
+        }
+    }
+    else {
+        m_kind = kind_packed;
+        std::vector<std::size_t>().swap(m_range_rows);
+        std::vector<std::size_t>().swap(m_range_positions);
+        m_width = width;
+        m_packed.resize(n * width); // Throws
+        char* p = m_packed.data();
+        for (std::size_t i = 0; i < num_words; ++i) {
+            for (uint64_t word = m_words[i]; word != 0; word &= word - 1) {
+                uint64_t v = uint64_t(i * 64 + lowest_bit(word));
+                for (std::size_t b = 0; b < width; ++b)
+                    *p++ = char(v >> (8 * b));
+            }
+        }
+        std::vector<uint64_t>().swap(m_words);
+    }
+}
+
+template<class R> void RowIndexSet::build(R row_at, std::size_t n)
+{
+    // One pass to measure the candidates
+    std::size_t num_runs = 0;
+    std::size_t max_row = 0;
+    bool is_ascending = true;
+    bool has_detached = false;
+    std::size_t prev = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        std::size_t row = row_at(i);
+        if (row == detached_ref) {
+            has_detached = true;
+            continue;
+        }
+        if (i == 0 || row != prev + 1)
+            ++num_runs;
+        if (i > 0 && row <= prev)
+            is_ascending = false;
+        max_row = std::max(max_row, row);
+        prev = row;
+    }
+
+    // Reserve the all-ones value of the packed width for detached rows
+    std::size_t width = 1;
+    while (width < sizeof (std::size_t) && (max_row + 1) >> (8 * width) != 0)
+        width *= 2;
+
+    std::size_t num_words = n == 0 ? 0 : max_row / 64 + 1;
+    std::size_t ranges_size = num_runs * 2 * sizeof (std::size_t);
+    std::size_t bitmap_size = num_words * 8 + (num_words / words_per_block + 1) * sizeof (std::size_t);
+    std::size_t packed_size = n * width;
+
+    m_size = n;
+    if (!has_detached && ranges_size <= bitmap_size && ranges_size <= packed_size) {
+        m_kind = kind_ranges;
+        m_range_rows.reserve(num_runs); // Throws
+        m_range_positions.reserve(num_runs); // Throws
+        for (std::size_t i = 0; i < n; ++i) {
+            std::size_t row = row_at(i);
+            if (i == 0 || row != prev + 1) {
+                m_range_rows.push_back(row);
+                m_range_positions.push_back(i);
+            }
+            prev = row;
+        }
+    }
+    else if (!has_detached && is_ascending && bitmap_size <= packed_size) {
+        m_kind = kind_bitmap;
+        m_words.assign(num_words, 0); // Throws
+        for (std::size_t i = 0; i < n; ++i) {
+            std::size_t row = row_at(i);
+            m_words[row / 64] |= uint64_t(1) << (row % 64);
+        }
+        std::size_t rank = 0;
+        for (std::size_t i = 0; i < num_words; ++i) {
+            if (i % words_per_block == 0)
+                m_block_ranks.push_back(rank); // Throws
+            rank += fast_popcount64(int64_t(m_words[i]));
+        }
+    }
+    else {
+        m_kind = kind_packed;
+        m_width = width;
+        m_packed.resize(n * width); // Throws
+        for (std::size_t i = 0; i < n; ++i) {
+            std::size_t row = row_at(i);
+            uint64_t v = row == detached_ref ? ~uint64_t(0) : uint64_t(row);
+            char* p = m_packed.data() + i * width;
+            for (std::size_t b = 0; b < width; ++b)
+                p[b] = char(v >> (8 * b));
+        }
+    }
+}
+
+inline std::size_t RowIndexSet::get_packed(std::size_t ndx) const REALM_NOEXCEPT
+{
+    const char* p = m_packed.data() + ndx * m_width;
+    uint64_t v = 0;
+    for (std::size_t b = 0; b < m_width; ++b)
+        v |= uint64_t(static_cast<unsigned char>(p[b])) << (8 * b);
+    if (m_width < 8 ? v == (uint64_t(1) << (8 * m_width)) - 1 : v == ~uint64_t(0))
+        return detached_ref;
+    return std::size_t(v);
+}
+
+inline std::size_t RowIndexSet::lowest_bit(uint64_t word) REALM_NOEXCEPT
+{
+    return std::size_t(fast_popcount64(int64_t((word & (~word + 1)) - 1)));
+}
+
+inline std::size_t RowIndexSet::get_source_ndx(std::size_t ndx) const REALM_NOEXCEPT
+{
+    REALM_ASSERT_3(ndx, <, m_size);
+    switch (m_kind) {
+        case kind_ranges: {
+            std::size_t run = std::upper_bound(m_range_positions.begin(), m_range_positions.end(), ndx) -
+                m_range_positions.begin() - 1;
+            return m_range_rows[run] + (ndx - m_range_positions[run]);
+        }
+        case kind_bitmap: {
+            std::size_t block = std::upper_bound(m_block_ranks.begin(), m_block_ranks.end(), ndx) -
+                m_block_ranks.begin() - 1;
+            std::size_t rank = m_block_ranks[block];
+            std::size_t word_ndx = block * words_per_block;
+            for (;;) {
+                std::size_t n = std::size_t(fast_popcount64(int64_t(m_words[word_ndx])));
+                if (rank + n > ndx)
+                    break;
+                rank += n;
+                ++word_ndx;
+            }
+            uint64_t word = m_words[word_ndx];
+            for (std::size_t i = rank; i < ndx; ++i)
+                word &= word - 1; // Clear the lowest set bit
+            return word_ndx * 64 + lowest_bit(word);
+        }
+        case kind_packed:
+            return get_packed(ndx);
+    }
+    REALM_ASSERT(false);
+    return detached_ref;
+}
+
+inline std::size_t RowIndexSet::get_byte_size() const REALM_NOEXCEPT
+{
+    return m_range_rows.capacity() * sizeof (std::size_t) + m_range_positions.capacity() * sizeof (std::size_t) +
+        m_words.capacity() * sizeof (uint64_t) + m_block_ranks.capacity() * sizeof (std::size_t) +
+        m_packed.capacity();
+}
+
+template<class F> void RowIndexSet::for_each(F handler) const
+{
+    switch (m_kind) {
+        case kind_ranges:
+            for (std::size_t i = 0; i < m_range_rows.size(); ++i) {
+                std::size_t end = i + 1 < m_range_rows.size() ? m_range_positions[i + 1] : m_size;
+                std::size_t row = m_range_rows[i];
+                for (std::size_t j = m_range_positions[i]; j < end; ++j)
+                    handler(row++);
+            }
+            return;
+        case kind_bitmap:
+            for (std::size_t i = 0; i < m_words.size(); ++i) {
+                for (uint64_t word = m_words[i]; word != 0; word &= word - 1)
+                    handler(i * 64 + lowest_bit(word));
+            }
+            return;
+        case kind_packed:
+            for (std::size_t i = 0; i < m_size; ++i)
+                handler(get_packed(i));
+            return;
+    }
+}
+
+template<class F> void RowIndexSet::for_each_range(F handler) const
+{
+    if (m_kind == kind_ranges) {
+        for (std::size_t i = 0; i < m_range_rows.size(); ++i) {
+            std::size_t end = i + 1 < m_range_rows.size() ? m_range_positions[i + 1] : m_size;
+            handler(m_range_rows[i], m_range_rows[i] + (end - m_range_positions[i]));
+        }
+        return;
+    }
+    // Coalesce consecutive rows
+    std::size_t begin = detached_ref, end = detached_ref;
+    for_each([&](std::size_t row) {
+        if (row == detached_ref)
+            return;
+        if (row == end) {
+            ++end;
+            return;
+        }
+        if (begin != detached_ref)
+            handler(begin, end);
+        begin = row;
+        end = row + 1;
+    });
+    if (begin != detached_ref)
+        handler(begin, end);
+}
+
+template<class C, class T, class RangeOp, class RowOp, class Combine>
+std::size_t RowIndexSet::reduce(const Table& table, std::size_t column_ndx, RangeOp range_op, RowOp row_op,
+                                Combine combine, T& result) const
+{
+    std::size_t count = 0;
+    const ColumnBase& base = _impl::TableFriend::get_column(table, column_ndx);
+    if (const C* column = dynamic_cast<const C*>(&base)) {
+        for_each_range([&](std::size_t begin, std::size_t end) {
+            T v = range_op(*column, begin, end);
+            result = count == 0 ? v : combine(result, v);
+            count += end - begin;
+        });
+        return count;
+    }
+    for_each([&](std::size_t row) {
+        if (row == detached_ref || table.is_null(column_ndx, row))
+            return;
+        T v = row_op(table, row);
+        result = count == 0 ? v : combine(result, v);
+        ++count;
+    });
+    return count;
+}
+
+template<class C, class T> T RowIndexSet::sum(const Table& table, std::size_t column_ndx, std::size_t* count) const
+{
+    T result = 0;
+    std::size_t n = reduce<C, T>(table, column_ndx,
+                                 [](const C& c, std::size_t b, std::size_t e) { return T(c.sum(b, e)); },
+                                 [column_ndx](const Table& t, std::size_t row) {
+                                     return T(t.get_int(column_ndx, row));
+                                 },
+                                 [](T a, T b) { return a + b; }, result);
+    if (count)
+        *count = n;
+    return result;
+}
+
+template<class C, class T> T RowIndexSet::extreme(const Table& table, std::size_t column_ndx, bool is_max) const
+{
+    T result = 0;
+    reduce<C, T>(table, column_ndx,
+                 [is_max](const C& c, std::size_t b, std::size_t e) {
+                     return T(is_max ? c.maximum(b, e) : c.minimum(b, e));
+                 },
+                 [column_ndx](const Table& t, std::size_t row) { return T(t.get_int(column_ndx, row)); },
+                 [is_max](T a, T b) { return is_max ? std::max(a, b) : std::min(a, b); }, result);
+    return result;
+}
+
+inline int64_t RowIndexSet::sum_int(const Table& table, std::size_t column_ndx) const
+{
+    return sum<IntegerColumn, int64_t>(table, column_ndx);
+}
+
+inline double RowIndexSet::sum_float(const Table& table, std::size_t column_ndx) const
+{
+    return sum<FloatColumn, double>(table, column_ndx);
+}
+
+inline double RowIndexSet::sum_double(const Table& table, std::size_t column_ndx) const
+{
+    return sum<DoubleColumn, double>(table, column_ndx);
+}
+
+inline int64_t RowIndexSet::maximum_int(const Table& table, std::size_t column_ndx) const
+{
+    return extreme<IntegerColumn, int64_t>(table, column_ndx, true);
+}
+
+inline float RowIndexSet::maximum_float(const Table& table, std::size_t column_ndx) const
+{
+    return extreme<FloatColumn, float>(table, column_ndx, true);
+}
+
+inline double RowIndexSet::maximum_double(const Table& table, std::size_t column_ndx) const
+{
+    return extreme<DoubleColumn, double>(table, column_ndx, true);
+}
+
+inline int64_t RowIndexSet::minimum_int(const Table& table, std::size_t column_ndx) const
+{
+    return extreme<IntegerColumn, int64_t>(table, column_ndx, false);
+}
+
+inline float RowIndexSet::minimum_float(const Table& table, std::size_t column_ndx) const
+{
+    return extreme<FloatColumn, float>(table, column_ndx, false);
+}
+
+inline double RowIndexSet::minimum_double(const Table& table, std::size_t column_ndx) const
+{
+    return extreme<DoubleColumn, double>(table, column_ndx, false);
+}
+
+inline double RowIndexSet::average_int(const Table& table, std::size_t column_ndx) const
+{
+    std::size_t count;
+    int64_t s = sum<IntegerColumn, int64_t>(table, column_ndx, &count);
+    return count == 0 ? 0 : double(s) / count;
+}
+
+inline double RowIndexSet::average_float(const Table& table, std::size_t column_ndx) const
+{
+    std::size_t count;
+    double s = sum<FloatColumn, double>(table, column_ndx, &count);
+    return count == 0 ? 0 : s / count;
+}
+
+inline double RowIndexSet::average_double(const Table& table, std::size_t column_ndx) const
+{
+    std::size_t count;
+    double s = sum<DoubleColumn, double>(table, column_ndx, &count);
+    return count == 0 ? 0 : s / count;
+}
+
+} // namespace realm
+
+#endif // REALM_ROW_INDEX_SET_HPP
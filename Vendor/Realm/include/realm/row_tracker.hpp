@@ -0,0 +1,539 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_ROW_TRACKER_HPP
+#define REALM_ROW_TRACKER_HPP
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include <realm/util/thread.hpp>
+#include <realm/impl/transact_log.hpp>
+#include <realm/table.hpp>
+
+namespace realm {
+
+class RowTracker;
+
+
+/// A row handle issued by RowTracker. Like a row accessor (Row), it follows
+/// its row when other rows are inserted or removed, and becomes detached
+/// when its row is removed. Handles are not thread safe, and must not
+/// outlive the tracker that issued them.
+class TrackedRow {
+public:
+    TrackedRow() REALM_NOEXCEPT;
+    TrackedRow(TrackedRow&&) REALM_NOEXCEPT;
+    TrackedRow& operator=(TrackedRow&&) REALM_NOEXCEPT;
+    ~TrackedRow() REALM_NOEXCEPT;
+
+    bool is_attached() const REALM_NOEXCEPT;
+
+    /// The current index of the row. Must only be called when attached.
+    std::size_t get_index() const REALM_NOEXCEPT;
+
+    /// Returns null if detached.
+    Table* get_table() const REALM_NOEXCEPT;
+
+    void detach() REALM_NOEXCEPT;
+
+private:
+    RowTracker* m_tracker;
+    std::size_t m_slot;
+
+    TrackedRow(RowTracker*, std::size_t slot) REALM_NOEXCEPT;
+
+    friend class RowTracker;
+};
+
+
+/// Registry of row handles for bindings that keep many rows of one table
+/// alive at the same time.
+///
+/// Every row accessor (Row) is linked into its table, and each
+/// Table::insert_empty_row(), remove() and move_last_over() walks all of
+/// them, under the accessor mutex of the table, to adjust their indexes. With
+/// thousands of live accessors, every row mutation costs that many steps.
+///
+/// A tracker does not touch its handles when rows move. It appends the
+/// mutation to a shared row translation log, and each handle is a cursor
+/// into that log. A handle replays the entries it has not yet seen when it
+/// is accessed, and log entries are discarded once every handle has seen
+/// them. A mutation therefore costs the same whatever the number of
+/// handles, and an access costs the number of mutations since the previous
+/// access of that handle. The log is kept back to the handle that was
+/// accessed least recently, so a handle that is never accessed keeps every
+/// later entry alive.
+///
+/// This is an opt-in alternative to row accessors. Table still adjusts its
+/// own row accessors on every mutation, so a tracker only saves that work
+/// if the binding uses handles instead of Row accessors:
+///
+///     RowTracker tracker(*table);
+///     TrackedRow row = tracker.track(7);
+///     tracker.remove(3); // or Table::remove() as part of a transaction
+///     table->get_int(0, row.get_index()); // Row 6 now
+///
+/// The tracker only learns about mutations that are made through it, or
+/// that it observes in a transaction log. For the latter, pass observer() to
+/// LangBindHelper::advance_read(), promote_to_write() or
+/// rollback_and_continue_as_read(). Rows must not be inserted or removed by
+/// other means while handles are live.
+class RowTracker {
+public:
+    class Observer;
+
+    explicit RowTracker(Table&) REALM_NOEXCEPT;
+    ~RowTracker() REALM_NOEXCEPT;
+
+    /// Issue a handle for the specified row.
+    TrackedRow track(std::size_t row_ndx);
+
+    /// Number of handles that have not been released.
+    std::size_t get_num_tracked() const REALM_NOEXCEPT;
+
+    Table& get_table() const REALM_NOEXCEPT { return *m_table; }
+
+    //@{
+    /// Modify the table, and adjust the handles accordingly.
+    void insert_empty_row(std::size_t row_ndx, std::size_t num_rows = 1);
+    std::size_t add_empty_row(std::size_t num_rows = 1);
+    void remove(std::size_t row_ndx);
+    void move_last_over(std::size_t row_ndx);
+    void clear();
+    //@}
+
+    //@{
+    /// Adjust the handles for modifications of the table that were made by
+    /// other means. These are called by the observer, and must be called
+    /// after the modification.
+    void on_insert_rows(std::size_t row_ndx, std::size_t num_rows);
+    void on_erase_rows(std::size_t row_ndx, std::size_t num_rows);
+    void on_move_last_over(std::size_t row_ndx, std::size_t last_row_ndx);
+    void on_clear();
+    //@}
+
+    /// A transaction log observer that forwards the row insertions and
+    /// removals of the tracked table to this tracker.
+    Observer observer() REALM_NOEXCEPT;
+
+private:
+    enum OpType {
+        op_Insert,          // Shift rows at or after row_ndx up by num_rows
+        op_Erase,           // Detach [row_ndx, row_ndx+num_rows), shift down
+        op_MoveLastOver,    // Detach row_ndx, move last_row_ndx there
+        op_InsertUnordered, // Move [row_ndx, row_ndx+num_rows) to last_row_ndx...
+        op_Clear            // Detach all
+    };
+
+    struct Op {
+        OpType type;
+        std::size_t row_ndx;
+        std::size_t num_rows;
+        std::size_t last_row_ndx;
+    };
+
+    struct Entry {
+        Op op;
+        std::size_t num_waiting; // Handles whose next entry to apply is this one
+    };
+
+    struct Slot {
+        std::size_t row_ndx; // detached_ref if detached, free list link if free
+        std::size_t seen;    // Log position up to which row_ndx is adjusted
+        bool is_free;
+    };
+
+    TableRef m_table;
+    std::vector<Slot> m_slots;
+    std::size_t m_free_slot = npos;
+    std::size_t m_num_tracked = 0;
+
+    // Log positions count every entry ever recorded, so that they stay
+    // valid when seen entries are discarded from the front
+    std::deque<Entry> m_log;
+    std::size_t m_log_begin = 0; // Position of m_log.front()
+    std::size_t m_num_current = 0; // Handles that have seen the whole log
+
+    // Protects the slots and the log. Handles may be released by a thread
+    // other than the one that modifies the table, as for row accessors.
+    mutable util::Mutex m_mutex;
+
+    void record(Op);
+    void release(std::size_t slot) REALM_NOEXCEPT;
+    std::size_t get_row_ndx(std::size_t slot) REALM_NOEXCEPT;
+    std::size_t get_log_end() const REALM_NOEXCEPT { return m_log_begin + m_log.size(); }
+    void catch_up(Slot&) REALM_NOEXCEPT;
+    void unsee(const Slot&) REALM_NOEXCEPT;
+    static void apply(const Op&, std::size_t& row_ndx) REALM_NOEXCEPT;
+
+    friend class TrackedRow;
+};
+
+
+class RowTracker::Observer: public _impl::NullInstructionObserver {
+public:
+    explicit Observer(RowTracker&) REALM_NOEXCEPT;
+
+    bool select_table(std::size_t group_level_ndx, std::size_t levels, const std::size_t*);
+    bool insert_group_level_table(std::size_t table_ndx, std::size_t num_tables, StringData);
+    bool erase_group_level_table(std::size_t table_ndx, std::size_t num_tables);
+    bool insert_empty_rows(std::size_t row_ndx, std::size_t num_rows, std::size_t prior_num_rows,
+                           bool unordered);
+    bool erase_rows(std::size_t row_ndx, std::size_t num_rows, std::size_t prior_num_rows,
+                    bool unordered);
+    bool clear_table();
+
+private:
+    RowTracker& m_tracker;
+    std::size_t m_table_ndx;
+    bool m_is_selected = false;
+};
+
+
+
+
+// Implementation:
+
+inline TrackedRow::TrackedRow() REALM_NOEXCEPT:
+    m_tracker(nullptr),
+    m_slot(0)
+{
+}
+
+inline TrackedRow::TrackedRow(RowTracker* tracker, std::size_t slot) REALM_NOEXCEPT:
+    m_tracker(tracker),
+    m_slot(slot)
+{
+}
+
+inline TrackedRow::TrackedRow(TrackedRow&& other) REALM_NOEXCEPT:
+    m_tracker(other.m_tracker),
+    m_slot(other.m_slot)
+{
+    other.m_tracker = nullptr;
+}
+
+inline TrackedRow& TrackedRow::operator=(TrackedRow&& other) REALM_NOEXCEPT
+{
+    if (this != &other) {
+        detach();
+        m_tracker = other.m_tracker;
+        m_slot = other.m_slot;
+        other.m_tracker = nullptr;
+    }
+    return *this;
+}
+
+inline TrackedRow::~TrackedRow() REALM_NOEXCEPT
+{
+    detach();
+}
+
+inline bool TrackedRow::is_attached() const REALM_NOEXCEPT
+{
+    if (!m_tracker)
+        return false;
+    return m_tracker->get_row_ndx(m_slot) != detached_ref;
+}
+
+inline std::size_t TrackedRow::get_index() const REALM_NOEXCEPT
+{
+    REALM_ASSERT(m_tracker);
+    std::size_t row_ndx = m_tracker->get_row_ndx(m_slot);
+    REALM_ASSERT(row_ndx != detached_ref);
+    return row_ndx;
+}
+
+inline Table* TrackedRow::get_table() const REALM_NOEXCEPT
+{
+    return is_attached() ? &m_tracker->get_table() : nullptr;
+}
+
+inline void TrackedRow::detach() REALM_NOEXCEPT
+{
+    if (m_tracker) {
+        m_tracker->release(m_slot);
+        m_tracker = nullptr;
+    }
+}
+
+
+inline RowTracker::RowTracker(Table& table) REALM_NOEXCEPT:
+    m_table(table.get_table_ref())
+{
+}
+
+inline RowTracker::~RowTracker() REALM_NOEXCEPT
+{
+    REALM_ASSERT(m_num_tracked == 0);
+}
+
+inline std::size_t RowTracker::get_num_tracked() const REALM_NOEXCEPT
+{
+    util::LockGuard lock(m_mutex);
+    return m_num_tracked;
+}
+
+inline TrackedRow RowTracker::track(std::size_t row_ndx)
+{
+    REALM_ASSERT_3(row_ndx, <, m_table->size());
+    util::LockGuard lock(m_mutex);
+    Slot slot = { row_ndx, get_log_end(), false };
+    std::size_t slot_ndx;
+    if (m_free_slot != npos) {
+        slot_ndx = m_free_slot;
+        m_free_slot = m_slots[slot_ndx].row_ndx;
+        m_slots[slot_ndx] = slot;
+    }
+    else {
+        slot_ndx = m_slots.size();
+        m_slots.push_back(slot); // Throws
+    }
+    ++m_num_tracked;
+    ++m_num_current;
+    return TrackedRow(this, slot_ndx);
+}
+
+inline void RowTracker::release(std::size_t slot_ndx) REALM_NOEXCEPT
+{
+    util::LockGuard lock(m_mutex);
+    Slot& slot = m_slots[slot_ndx];
+    unsee(slot);
+    slot.is_free = true;
+    slot.row_ndx = m_free_slot;
+    m_free_slot = slot_ndx;
+    --m_num_tracked;
+}
+
+inline void RowTracker::apply(const Op& op, std::size_t& row_ndx) REALM_NOEXCEPT
+{
+    if (row_ndx == detached_ref)
+        return;
+    switch (op.type) {
+        case op_Insert:
+            if (row_ndx >= op.row_ndx)
+                row_ndx += op.num_rows;
+            return;
+        case op_Erase:
+            if (row_ndx >= op.row_ndx + op.num_rows) {
+                row_ndx -= op.num_rows;
+            }
+            else if (row_ndx >= op.row_ndx) {
+                row_ndx = detached_ref;
+            }
+            return;
+        case op_MoveLastOver:
+            if (row_ndx == op.row_ndx) {
+                row_ndx = detached_ref;
+            }
+            else if (row_ndx == op.last_row_ndx) {
+                row_ndx = op.row_ndx;
+            }
+            return;
+        case op_InsertUnordered:
+            if (row_ndx >= op.row_ndx && row_ndx < op.row_ndx + op.num_rows)
+                row_ndx = op.last_row_ndx + (row_ndx - op.row_ndx);
+            return;
+        case op_Clear:
+            row_ndx = detached_ref;
+            return;
+    }
+    REALM_ASSERT(false);
+}
+
+inline void RowTracker::unsee(const Slot& slot) REALM_NOEXCEPT
+{
+    if (slot.seen == get_log_end()) {
+        --m_num_current;
+        return;
+    }
+    --m_log[slot.seen - m_log_begin].num_waiting;
+    // Discard the entries that every handle has seen
+    while (!m_log.empty() && m_log.front().num_waiting == 0) {
+        m_log.pop_front();
+        ++m_log_begin;
+    }
+}
+
+inline void RowTracker::catch_up(Slot& slot) REALM_NOEXCEPT
+{
+    std::size_t end = get_log_end();
+    if (slot.seen == end)
+        return;
+    for (std::size_t i = slot.seen; i < end; ++i)
+        apply(m_log[i - m_log_begin].op, slot.row_ndx);
+    unsee(slot);
+    slot.seen = end;
+    ++m_num_current;
+}
+
+inline std::size_t RowTracker::get_row_ndx(std::size_t slot_ndx) REALM_NOEXCEPT
+{
+    util::LockGuard lock(m_mutex);
+    Slot& slot = m_slots[slot_ndx];
+    catch_up(slot);
+    return slot.row_ndx;
+}
+
+inline void RowTracker::record(Op op)
+{
+    util::LockGuard lock(m_mutex);
+    if (m_num_tracked == 0)
+        return; // Nobody to adjust
+    // The handles that have seen the whole log will apply this entry next
+    Entry entry = { op, m_num_current };
+    m_log.push_back(entry); // Throws
+    m_num_current = 0;
+}
+
+inline void RowTracker::on_insert_rows(std::size_t row_ndx, std::size_t num_rows)
+{
+    record(Op{op_Insert, row_ndx, num_rows, 0}); // Throws
+}
+
+inline void RowTracker::on_erase_rows(std::size_t row_ndx, std::size_t num_rows)
+{
+    record(Op{op_Erase, row_ndx, num_rows, 0}); // Throws
+}
+
+inline void RowTracker::on_move_last_over(std::size_t row_ndx, std::size_t last_row_ndx)
+{
+    record(Op{op_MoveLastOver, row_ndx, 1, last_row_ndx}); // Throws
+}
+
+inline void RowTracker::on_clear()
+{
+    record(Op{op_Clear, 0, 0, 0}); // Throws
+}
+
+inline void RowTracker::insert_empty_row(std::size_t row_ndx, std::size_t num_rows)
+{
+    m_table->insert_empty_row(row_ndx, num_rows); // Throws
+    on_insert_rows(row_ndx, num_rows); // Throws
+}
+
+inline std::size_t RowTracker::add_empty_row(std::size_t num_rows)
+{
+    // Appending moves no existing row
+    return m_table->add_empty_row(num_rows); // Throws
+}
+
+inline void RowTracker::remove(std::size_t row_ndx)
+{
+    m_table->remove(row_ndx); // Throws
+    on_erase_rows(row_ndx, 1); // Throws
+}
+
+inline void RowTracker::move_last_over(std::size_t row_ndx)
+{
+    std::size_t last_row_ndx = m_table->size() - 1;
+    m_table->move_last_over(row_ndx); // Throws
+    on_move_last_over(row_ndx, last_row_ndx); // Throws
+}
+
+inline void RowTracker::clear()
+{
+    m_table->clear(); // Throws
+    on_clear(); // Throws
+}
+
+inline RowTracker::Observer RowTracker::observer() REALM_NOEXCEPT
+{
+    return Observer(*this);
+}
+
+
+inline RowTracker::Observer::Observer(RowTracker& tracker) REALM_NOEXCEPT:
+    m_tracker(tracker),
+    m_table_ndx(tracker.get_table().get_index_in_group())
+{
+}
+
+inline bool RowTracker::Observer::select_table(std::size_t group_level_ndx, std::size_t levels,
+                                               const std::size_t*)
+{
+    // Subtables are not tracked
+    m_is_selected = levels == 0 && group_level_ndx == m_table_ndx;
+    return true;
+}
+
+inline bool RowTracker::Observer::insert_group_level_table(std::size_t table_ndx, std::size_t, StringData)
+{
+    if (m_table_ndx != npos && table_ndx <= m_table_ndx)
+        ++m_table_ndx;
+    return true;
+}
+
+inline bool RowTracker::Observer::erase_group_level_table(std::size_t table_ndx, std::size_t)
+{
+    if (m_table_ndx == npos)
+        return true;
+    if (table_ndx == m_table_ndx) {
+        m_tracker.on_clear(); // Throws
+        m_table_ndx = npos;
+    }
+    else if (table_ndx < m_table_ndx) {
+        --m_table_ndx;
+    }
+    return true;
+}
+
+inline bool RowTracker::Observer::insert_empty_rows(std::size_t row_ndx, std::size_t num_rows,
+                                                    std::size_t prior_num_rows, bool unordered)
+{
+    if (!m_is_selected)
+        return true;
+    if (unordered) {
+        // The inverse of move_last_over(): the rows that were at row_ndx
+        // are moved to the end to make room
+        std::size_t num_moved = std::min(num_rows, prior_num_rows - row_ndx);
+        if (num_moved != 0)
+            m_tracker.record(Op{op_InsertUnordered, row_ndx, num_moved, prior_num_rows}); // Throws
+        return true;
+    }
+    m_tracker.on_insert_rows(row_ndx, num_rows); // Throws
+    return true;
+}
+
+inline bool RowTracker::Observer::erase_rows(std::size_t row_ndx, std::size_t num_rows,
+                                             std::size_t prior_num_rows, bool unordered)
+{
+    if (!m_is_selected)
+        return true;
+    if (unordered) {
+        REALM_ASSERT_3(num_rows, ==, 1);
+        m_tracker.on_move_last_over(row_ndx, prior_num_rows - 1); // Throws
+        return true;
+    }
+    m_tracker.on_erase_rows(row_ndx, num_rows); // Throws
+    return true;
+}
+
+inline bool RowTracker::Observer::clear_table()
+{
+    if (m_is_selected)
+        m_tracker.on_clear(); // Throws
+    return true;
+}
+
+} // namespace realm
+
+#endif // REALM_ROW_TRACKER_HPP
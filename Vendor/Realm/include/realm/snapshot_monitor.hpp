@@ -0,0 +1,331 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_SNAPSHOT_MONITOR_HPP
+#define REALM_SNAPSHOT_MONITOR_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include <realm/util/thread.hpp>
+#include <realm/group_shared.hpp>
+#include <realm/lang_bind_helper.hpp>
+
+namespace realm {
+
+/// Thrown when a monitored reader accesses its snapshot after it was asked
+/// to release it, under SnapshotMonitor::release_Throw.
+struct SnapshotReleaseRequested: std::exception {
+    const char* what() const REALM_NOEXCEPT_OR_NOTHROW override
+    {
+        return "Read transaction was asked to release its snapshot";
+    }
+};
+
+
+/// Keeps track of the snapshots pinned by the read transactions of this
+/// process, and lets writers ask stale readers to release them.
+///
+/// Every read transaction binds a version, and as long as it is bound, the
+/// space freed by later versions cannot be reused, so the file grows. A
+/// forgotten background transaction can make it grow without bounds.
+///
+/// Readers register with a monitor through a SnapshotMonitor::Reader, which
+/// begins and ends their read transactions, and must be consulted on each
+/// access to the snapshot:
+///
+///     SnapshotMonitor::Reader reader(monitor, sg, "sync worker", &history);
+///     const Group& group = reader.begin_read();
+///     for (...) {
+///         reader.check(); // May advance, or throw SnapshotReleaseRequested
+///         ...
+///     }
+///     reader.end_read();
+///
+/// get_stats() reports the pinned versions, how far behind the latest
+/// version they are, and how long they have been held. request_release()
+/// flags readers older than a given age. Depending on the policy, a flagged
+/// reader advances to the latest version at its next check(), which
+/// requires a history and keeps accessors valid, or throws.
+///
+/// Only readers in this process that are registered with the monitor are
+/// seen; read transactions in other processes also pin versions, and are
+/// reflected in get_number_of_versions() only.
+class SnapshotMonitor {
+public:
+    enum ReleasePolicy {
+        release_Advance, ///< Advance to the latest version at the next check()
+        release_Throw    ///< Throw SnapshotReleaseRequested at the next check()
+    };
+
+    typedef std::chrono::steady_clock clock;
+
+    struct ReaderInfo {
+        std::string label;
+        SharedGroup::version_type version;
+
+        /// Size of the file at the pinned version.
+        std::size_t file_size;
+
+        /// Time since the pinned version was bound.
+        clock::duration age;
+
+        bool release_requested;
+    };
+
+    struct Stats {
+        SharedGroup::version_type latest_version = 0;
+        std::size_t latest_file_size = 0;
+
+        /// The number of versions kept in the file, by all processes.
+        uint_fast64_t num_versions = 0;
+
+        /// Registered readers that are in a read transaction, oldest first.
+        std::vector<ReaderInfo> readers;
+
+        /// Age of the oldest reader, or zero if there are none.
+        clock::duration oldest_reader_age = clock::duration::zero();
+
+        /// Growth of the file since the oldest pinned version. This is only
+        /// an indication, not a bound, of the space that the pinned versions
+        /// keep from being reused: the file also grows with live data, and
+        /// space that is held back can be older than the pinned version.
+        /// The space held back by each version is not provided, as the free
+        /// lists that would tell are internal to the core library.
+        std::size_t bytes_held_back = 0;
+    };
+
+    class Reader;
+
+    explicit SnapshotMonitor(ReleasePolicy = release_Advance) REALM_NOEXCEPT;
+    ~SnapshotMonitor() REALM_NOEXCEPT;
+
+    /// Collect the statistics. A short read transaction on the specified
+    /// shared group, which must not be in a transaction, determines the
+    /// latest version.
+    Stats get_stats(SharedGroup&) const;
+
+    /// Ask every reader that has held its version for longer than \a max_age
+    /// to release it. Returns the number of readers that were flagged.
+    std::size_t request_release(clock::duration max_age);
+
+    ReleasePolicy get_policy() const REALM_NOEXCEPT { return m_policy; }
+
+private:
+    const ReleasePolicy m_policy;
+    mutable util::Mutex m_mutex;
+    std::vector<Reader*> m_readers;
+
+    void add(Reader*);
+    void remove(Reader*) REALM_NOEXCEPT;
+};
+
+
+/// A read transaction registered with a SnapshotMonitor. Must not outlive
+/// the monitor, and must only be used by one thread at a time.
+class SnapshotMonitor::Reader {
+public:
+    /// The history is required for the release_Advance policy.
+    Reader(SnapshotMonitor&, SharedGroup&, std::string label, History* = nullptr);
+    ~Reader() REALM_NOEXCEPT;
+
+    const Group& begin_read();
+    void end_read() REALM_NOEXCEPT;
+
+    /// Must be called on every access to the snapshot. Advances to the
+    /// latest version, or throws SnapshotReleaseRequested, if the monitor
+    /// asked this reader to release its version.
+    void check();
+
+private:
+    SnapshotMonitor& m_monitor;
+    SharedGroup& m_shared_group;
+    History* const m_history;
+    const std::string m_label;
+
+    // Protected by the monitor's mutex
+    bool m_is_reading = false;
+    SharedGroup::version_type m_version = 0;
+    std::size_t m_file_size = 0;
+    clock::time_point m_since;
+
+    std::atomic<bool> m_release_requested;
+
+    void bind();
+    void unbind() REALM_NOEXCEPT;
+
+    friend class SnapshotMonitor;
+};
+
+
+
+
+// Implementation:
+
+inline SnapshotMonitor::SnapshotMonitor(ReleasePolicy policy) REALM_NOEXCEPT:
+    m_policy(policy)
+{
+}
+
+inline SnapshotMonitor::~SnapshotMonitor() REALM_NOEXCEPT
+{
+    REALM_ASSERT(m_readers.empty());
+}
+
+inline SnapshotMonitor::Stats SnapshotMonitor::get_stats(SharedGroup& sg) const
+{
+    using sgf = _impl::SharedGroupFriend;
+    Stats stats;
+    {
+        ReadTransaction rt(sg); // Throws
+        stats.latest_version = sgf::get_read_version(sg);
+        stats.latest_file_size = sgf::get_read_file_size(sg);
+    }
+    stats.num_versions = sg.get_number_of_versions(); // Throws
+
+    clock::time_point now = clock::now();
+    {
+        util::LockGuard lg(m_mutex);
+        typedef std::vector<Reader*>::const_iterator iter;
+        for (iter i = m_readers.begin(), end = m_readers.end(); i != end; ++i) {
+            const Reader& r = **i;
+            if (!r.m_is_reading)
+                continue;
+            ReaderInfo info;
+            info.label = r.m_label; // Throws
+            info.version = r.m_version;
+            info.file_size = r.m_file_size;
+            info.age = now - r.m_since;
+            info.release_requested = r.m_release_requested.load(std::memory_order_relaxed);
+            stats.readers.push_back(std::move(info)); // Throws
+        }
+    }
+
+    std::sort(stats.readers.begin(), stats.readers.end(),
+              [](const ReaderInfo& a, const ReaderInfo& b) { return a.age > b.age; });
+    typedef std::vector<ReaderInfo>::const_iterator iter;
+    for (iter i = stats.readers.begin(), end = stats.readers.end(); i != end; ++i) {
+        if (i->file_size < stats.latest_file_size) {
+            std::size_t held_back = stats.latest_file_size - i->file_size;
+            if (held_back > stats.bytes_held_back)
+                stats.bytes_held_back = held_back;
+        }
+    }
+    if (!stats.readers.empty())
+        stats.oldest_reader_age = stats.readers.front().age;
+    return stats;
+}
+
+inline std::size_t SnapshotMonitor::request_release(clock::duration max_age)
+{
+    clock::time_point now = clock::now();
+    std::size_t n = 0;
+    util::LockGuard lg(m_mutex);
+    typedef std::vector<Reader*>::const_iterator iter;
+    for (iter i = m_readers.begin(), end = m_readers.end(); i != end; ++i) {
+        Reader& r = **i;
+        if (r.m_is_reading && now - r.m_since > max_age) {
+            r.m_release_requested.store(true, std::memory_order_relaxed);
+            ++n;
+        }
+    }
+    return n;
+}
+
+inline void SnapshotMonitor::add(Reader* reader)
+{
+    util::LockGuard lg(m_mutex);
+    m_readers.push_back(reader); // Throws
+}
+
+inline void SnapshotMonitor::remove(Reader* reader) REALM_NOEXCEPT
+{
+    util::LockGuard lg(m_mutex);
+    m_readers.erase(std::find(m_readers.begin(), m_readers.end(), reader));
+}
+
+
+inline SnapshotMonitor::Reader::Reader(SnapshotMonitor& monitor, SharedGroup& sg,
+                                       std::string label, History* history):
+    m_monitor(monitor),
+    m_shared_group(sg),
+    m_history(history),
+    m_label(std::move(label)),
+    m_release_requested(false)
+{
+    REALM_ASSERT(history || monitor.get_policy() != release_Advance);
+    m_monitor.add(this); // Throws
+}
+
+inline SnapshotMonitor::Reader::~Reader() REALM_NOEXCEPT
+{
+    if (m_is_reading)
+        end_read();
+    m_monitor.remove(this);
+}
+
+inline const Group& SnapshotMonitor::Reader::begin_read()
+{
+    const Group& group = m_shared_group.begin_read(); // Throws
+    bind();
+    return group;
+}
+
+inline void SnapshotMonitor::Reader::end_read() REALM_NOEXCEPT
+{
+    unbind();
+    m_shared_group.end_read();
+}
+
+inline void SnapshotMonitor::Reader::check()
+{
+    REALM_ASSERT(m_is_reading);
+    if (REALM_LIKELY(!m_release_requested.load(std::memory_order_relaxed)))
+        return;
+    if (m_monitor.get_policy() == release_Throw)
+        throw SnapshotReleaseRequested();
+    LangBindHelper::advance_read(m_shared_group, *m_history); // Throws
+    bind();
+}
+
+inline void SnapshotMonitor::Reader::bind()
+{
+    using sgf = _impl::SharedGroupFriend;
+    util::LockGuard lg(m_monitor.m_mutex);
+    m_is_reading = true;
+    m_version = sgf::get_read_version(m_shared_group);
+    m_file_size = sgf::get_read_file_size(m_shared_group);
+    m_since = clock::now();
+    m_release_requested.store(false, std::memory_order_relaxed);
+}
+
+inline void SnapshotMonitor::Reader::unbind() REALM_NOEXCEPT
+{
+    util::LockGuard lg(m_monitor.m_mutex);
+    m_is_reading = false;
+    m_release_requested.store(false, std::memory_order_relaxed);
+}
+
+} // namespace realm
+
+#endif // REALM_SNAPSHOT_MONITOR_HPP
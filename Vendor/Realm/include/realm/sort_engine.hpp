@@ -0,0 +1,529 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_SORT_ENGINE_HPP
+#define REALM_SORT_ENGINE_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <realm/column.hpp>
+#include <realm/column_basic.hpp>
+#include <realm/column_link.hpp>
+#include <realm/column_string.hpp>
+#include <realm/column_string_enum.hpp>
+#include <realm/collation_key.hpp>
+#include <realm/query_conditions.hpp>
+#include <realm/table_view.hpp>
+#include <realm/util/thread.hpp>
+
+namespace realm {
+
+/// Key extracting sort for table views.
+///
+/// RowIndexes::sort() hands a Sorter to std::sort(), so every comparison
+/// makes one virtual ColumnBase::compare_values() call per sort column, each
+/// of which looks up two values in the column B+-tree. This engine instead
+/// reads every sort value exactly once into a contiguous buffer, and then
+/// orders the rows without touching the columns again:
+///
+///  - Int, Bool and DateTime values, Float and Double values, and links (by
+///    target row index, null links first) are mapped to unsigned 64-bit keys
+///    whose natural order is the order of the values, and are sorted by an
+///    LSD radix sort. Byte positions in which all
+///    keys agree are skipped, so narrow values (bools, small ints) cost only
+///    one or two passes.
+///
+///  - String values are ordered with std::stable_sort() using the same
+///    ordering as StringColumn::compare_values(). With the core string
+///    compare method, each value is first turned into a collation key (see
+///    collation_key.hpp), so comparisons become memcmp() calls instead of
+///    utf8_compare() calls. Keys are cached in the engine for the rows
+///    that have been sorted, and are reused by later sorts until the table
+///    changes, so an engine should be kept alongside the view it sorts. The
+///    cache is guarded by a mutex, so sorts that share an engine are safe,
+///    but take turns on such columns.
+///
+/// A sort on several columns runs one stable pass per column, starting with
+/// the least significant column. Inputs of at least parallel_threshold rows
+/// are split across threads which each sort one slice. The sorted slices are
+/// then merged.
+///
+/// The resulting order is the same as the one produced by
+/// TableViewBase::sort(), except that rows that compare equal keep their
+/// relative order. The sort criteria are also recorded on the view, so when a
+/// view is synchronized by other means than sync_if_needed() below, its
+/// regular re-sort produces the same order.
+class SortEngine {
+public:
+    SortEngine(std::vector<std::size_t> columns, std::vector<bool> ascending);
+
+    /// Number of threads used for inputs of at least parallel_threshold
+    /// rows. Defaults to the number of hardware threads.
+    void set_num_threads(std::size_t num_threads) REALM_NOEXCEPT;
+
+    static const std::size_t parallel_threshold = 1 << 16;
+
+    /// Sort the rows of the view. Detached rows are placed last.
+    ///
+    /// \throw LogicError If a sort column is of a type other than Int, Bool,
+    /// DateTime, Float, Double, String or Link.
+    void sort(TableViewBase& view) const;
+
+    /// Bring the view in sync with its table (see
+    /// TableViewBase::sync_if_needed()), and sort it with this engine if
+    /// anything changed. Returns true if the view was out of sync.
+    bool sync_if_needed(TableViewBase& view) const;
+
+protected:
+    // Sort element: key and position in the unsorted view
+    struct Item {
+        uint64_t key;
+        std::size_t pos;
+    };
+    typedef std::vector<std::size_t> positions;
+
+    std::vector<std::size_t> m_columns;
+    std::vector<bool> m_ascending;
+    std::size_t m_num_threads;
+
+    /// Order-preserving mapping of values to unsigned keys.
+    static uint64_t int_key(int64_t v) REALM_NOEXCEPT;
+    static uint64_t float_key(float v) REALM_NOEXCEPT;
+    static uint64_t double_key(double v) REALM_NOEXCEPT;
+
+    static void check_column_type(const TableViewBase&, std::size_t column_ndx);
+
+    /// Read the keys of the rows at \a rows (source row indexes) from the
+    /// specified column of the view. Returns false if the column cannot be
+    /// mapped to integer keys (strings).
+    static bool extract_keys(const TableViewBase&, std::size_t column_ndx, const positions& rows,
+                             std::vector<uint64_t>& keys);
+
+    /// Stable pass over \a order on one column.
+    void sort_column(const TableViewBase&, std::size_t column_ndx, bool ascending,
+                     const positions& rows, positions& order) const;
+
+    static void radix_sort(Item* begin, Item* end, Item* buffer);
+
+    /// Split [begin, end) into slices, sort each one with \a sort_slice in its
+    /// own thread, and merge the results into [begin, end) with \a less.
+    template<class T, class F, class L>
+    void parallel_stable_sort(T* begin, T* end, F sort_slice, L less) const;
+
+    static void set_row_indexes(TableViewBase&, const positions& rows, const positions& order);
+
+    // Position of a collation key in KeyCache::data
+    struct KeyRange {
+        std::size_t begin;
+        std::size_t end;
+        bool is_null;
+    };
+
+    // Collation keys of one string column, for the rows that have been
+    // sorted so far
+    struct KeyCache {
+        std::size_t column_ndx;
+        uint_fast64_t table_version;
+        std::string data;
+        std::unordered_map<std::size_t, KeyRange> keys; // By source row
+    };
+    mutable std::vector<KeyCache> m_key_caches;
+    mutable util::Mutex m_key_cache_mutex;
+
+    /// Set \a ranges to the keys of \a rows, building those that are not
+    /// cached yet. Must be called with m_key_cache_mutex locked, which must
+    /// stay locked while the keys are used.
+    const KeyCache& get_key_cache(const TableViewBase&, std::size_t column_ndx, const positions& rows,
+                                  std::vector<KeyRange>& ranges) const;
+};
+
+
+
+
+// Implementation:
+
+inline SortEngine::SortEngine(std::vector<std::size_t> columns, std::vector<bool> ascending):
+    m_columns(std::move(columns)),
+    m_ascending(std::move(ascending)),
+    m_num_threads(std::max(1u, std::thread::hardware_concurrency()))
+{
+    REALM_ASSERT_3(m_columns.size(), ==, m_ascending.size());
+}
+
+inline void SortEngine::set_num_threads(std::size_t num_threads) REALM_NOEXCEPT
+{
+    m_num_threads = std::max(std::size_t(1), num_threads);
+}
+
+inline uint64_t SortEngine::int_key(int64_t v) REALM_NOEXCEPT
+{
+    // Flipping the sign bit makes two's complement order unsigned
+    return uint64_t(v) ^ (uint64_t(1) << 63);
+}
+
+inline uint64_t SortEngine::float_key(float v) REALM_NOEXCEPT
+{
+    return double_key(v);
+}
+
+inline uint64_t SortEngine::double_key(double v) REALM_NOEXCEPT
+{
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof bits);
+    // Negative values: reverse the order of the magnitude bits. Positive
+    // values: place above all negative values.
+    uint64_t sign = uint64_t(1) << 63;
+    return (bits & sign) ? ~bits : bits | sign;
+}
+
+inline bool SortEngine::extract_keys(const TableViewBase& view, std::size_t column_ndx,
+                                     const positions& rows, std::vector<uint64_t>& keys)
+{
+    std::size_t n = rows.size();
+    keys.resize(n); // Throws
+    const ColumnBase& column = view.get_column_base(column_ndx);
+
+    switch (view.get_column_type(column_ndx)) {
+        case type_Int:
+        case type_Bool:
+        case type_DateTime:
+            if (const IntegerColumn* c = dynamic_cast<const IntegerColumn*>(&column)) {
+                for (std::size_t i = 0; i < n; ++i)
+                    keys[i] = int_key(c->get(rows[i]));
+            }
+            else {
+                // Nullable and other integer-like column variants
+                const ColumnTemplate<int64_t>& c2 = dynamic_cast<const ColumnTemplate<int64_t>&>(column);
+                for (std::size_t i = 0; i < n; ++i)
+                    keys[i] = int_key(c2.get_val(rows[i]));
+            }
+            return true;
+        case type_Float: {
+            const FloatColumn& c = static_cast<const FloatColumn&>(column);
+            for (std::size_t i = 0; i < n; ++i)
+                keys[i] = float_key(c.get(rows[i]));
+            return true;
+        }
+        case type_Double: {
+            const DoubleColumn& c = static_cast<const DoubleColumn&>(column);
+            for (std::size_t i = 0; i < n; ++i)
+                keys[i] = double_key(c.get(rows[i]));
+            return true;
+        }
+        case type_Link: {
+            // Same order as LinkColumn::compare_values(), which compares the
+            // stored values (target row index plus one, zero for null)
+            const LinkColumn& c = static_cast<const LinkColumn&>(column);
+            for (std::size_t i = 0; i < n; ++i) {
+                std::size_t row_ndx = rows[i];
+                keys[i] = c.is_null_link(row_ndx) ? 0 : uint64_t(c.get_link(row_ndx)) + 1;
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+inline void SortEngine::check_column_type(const TableViewBase& view, std::size_t column_ndx)
+{
+    switch (view.get_column_type(column_ndx)) {
+        case type_Int:
+        case type_Bool:
+        case type_DateTime:
+        case type_Float:
+        case type_Double:
+        case type_String:
+        case type_Link:
+            return;
+        default:
+            throw LogicError(LogicError::type_mismatch);
+    }
+}
+
+inline void SortEngine::radix_sort(Item* begin, Item* end, Item* buffer)
+{
+    std::size_t n = end - begin;
+    if (n < 2)
+        return;
+
+    // One histogram per key byte, all filled in a single pass
+    std::vector<std::size_t> counts(8 * 256, 0); // Throws
+    for (Item* i = begin; i != end; ++i) {
+        uint64_t k = i->key;
+        for (int b = 0; b < 8; ++b)
+            ++counts[b * 256 + ((k >> (8 * b)) & 0xFF)];
+    }
+
+    Item* src = begin;
+    Item* dst = buffer;
+    for (int b = 0; b < 8; ++b) {
+        std::size_t* count = &counts[b * 256];
+        // All keys agree on this byte, so the pass would be the identity
+        if (count[(src->key >> (8 * b)) & 0xFF] == n)
+            continue;
+        std::size_t offset = 0;
+        for (int d = 0; d < 256; ++d) {
+            std::size_t c = count[d];
+            count[d] = offset;
+            offset += c;
+        }
+        for (Item* i = src; i != src + n; ++i)
+            dst[count[(i->key >> (8 * b)) & 0xFF]++] = *i;
+        std::swap(src, dst);
+    }
+    if (src != begin)
+        std::copy(src, src + n, begin);
+}
+
+template<class T, class F, class L>
+void SortEngine::parallel_stable_sort(T* begin, T* end, F sort_slice, L less) const
+{
+    std::size_t n = end - begin;
+    std::size_t num_slices = std::min(m_num_threads, n / (parallel_threshold / 4) + 1);
+    if (n < parallel_threshold || num_slices < 2) {
+        sort_slice(begin, end);
+        return;
+    }
+
+    std::vector<T*> bounds;
+    for (std::size_t i = 0; i < num_slices; ++i)
+        bounds.push_back(begin + n * i / num_slices);
+    bounds.push_back(end);
+
+    {
+        std::vector<util::Thread> threads(num_slices - 1);
+        for (std::size_t i = 1; i < num_slices; ++i) {
+            T* b = bounds[i];
+            T* e = bounds[i + 1];
+            threads[i - 1].start([=] { sort_slice(b, e); });
+        }
+        sort_slice(bounds[0], bounds[1]);
+        for (util::Thread& t: threads)
+            t.join();
+    }
+
+    // Pairwise merge rounds. std::merge() takes equal elements from the
+    // first range first, which keeps the sort stable.
+    std::vector<T> buffer(n); // Throws
+    T* src = begin;
+    T* dst = buffer.data();
+    while (bounds.size() > 2) {
+        std::vector<T*> next_bounds;
+        std::vector<util::Thread> threads(bounds.size() / 2);
+        for (std::size_t i = 0; i + 1 < bounds.size(); i += 2) {
+            T* b = src + (bounds[i] - bounds.front());
+            T* m = src + (bounds[i + 1] - bounds.front());
+            T* e = i + 2 < bounds.size() ? src + (bounds[i + 2] - bounds.front()) : m;
+            T* out = dst + (b - src);
+            next_bounds.push_back(bounds[i]);
+            threads[i / 2].start([=] { std::merge(b, m, m, e, out, less); });
+        }
+        next_bounds.push_back(bounds.back());
+        for (util::Thread& t: threads)
+            t.join();
+        bounds.swap(next_bounds);
+        std::swap(src, dst);
+    }
+    if (src != begin)
+        std::copy(src, src + n, begin);
+}
+
+inline void SortEngine::sort_column(const TableViewBase& view, std::size_t column_ndx, bool ascending,
+                                    const positions& rows, positions& order) const
+{
+    std::size_t n = order.size();
+    std::vector<uint64_t> keys;
+    if (extract_keys(view, column_ndx, rows, keys)) {
+        std::vector<Item> items(n); // Throws
+        for (std::size_t i = 0; i < n; ++i) {
+            std::size_t pos = order[i];
+            items[i].key = ascending ? keys[pos] : ~keys[pos];
+            items[i].pos = pos;
+        }
+        auto sort_slice = [](Item* b, Item* e) {
+            std::vector<Item> buffer(e - b); // Throws
+            radix_sort(b, e, buffer.data());
+        };
+        auto less = [](const Item& a, const Item& b) { return a.key < b.key; };
+        parallel_stable_sort(items.data(), items.data() + n, sort_slice, less); // Throws
+        for (std::size_t i = 0; i < n; ++i)
+            order[i] = items[i].pos;
+        return;
+    }
+
+    // Strings, same order as StringColumn::compare_values(): nulls first,
+    // then utf8_compare()
+    if (collation_keys_available()) {
+        util::LockGuard lg(m_key_cache_mutex);
+        std::vector<KeyRange> ranges;
+        const KeyCache& cache = get_key_cache(view, column_ndx, rows, ranges); // Throws
+        const char* data = cache.data.data();
+        auto less = [&](std::size_t a, std::size_t b) {
+            const KeyRange* k1 = &ranges[a];
+            const KeyRange* k2 = &ranges[b];
+            if (!ascending)
+                std::swap(k1, k2);
+            if (k1->is_null || k2->is_null)
+                return k1->is_null && !k2->is_null;
+            return compare_collation_keys(data + k1->begin, k1->end - k1->begin,
+                                          data + k2->begin, k2->end - k2->begin);
+        };
+        auto sort_slice = [&less](std::size_t* b, std::size_t* e) { std::stable_sort(b, e, less); };
+        parallel_stable_sort(order.data(), order.data() + n, sort_slice, less); // Throws
+        return;
+    }
+
+    const ColumnBase& column = view.get_column_base(column_ndx);
+    std::vector<StringData> values(n); // Throws
+    if (const StringEnumColumn* c = dynamic_cast<const StringEnumColumn*>(&column)) {
+        for (std::size_t i = 0; i < n; ++i)
+            values[i] = c->get(rows[i]);
+    }
+    else {
+        const StringColumn& c2 = dynamic_cast<const StringColumn&>(column);
+        for (std::size_t i = 0; i < n; ++i)
+            values[i] = c2.get(rows[i]);
+    }
+    auto less = [&values, ascending](std::size_t a, std::size_t b) {
+        StringData v1 = values[a];
+        StringData v2 = values[b];
+        if (!ascending)
+            std::swap(v1, v2);
+        if (v1.is_null() || v2.is_null())
+            return v1.is_null() && !v2.is_null();
+        return v1 != v2 && utf8_compare(v1, v2);
+    };
+    auto sort_slice = [&less](std::size_t* b, std::size_t* e) { std::stable_sort(b, e, less); };
+    parallel_stable_sort(order.data(), order.data() + n, sort_slice, less); // Throws
+}
+
+inline const SortEngine::KeyCache& SortEngine::get_key_cache(const TableViewBase& view,
+                                                             std::size_t column_ndx,
+                                                             const positions& rows,
+                                                             std::vector<KeyRange>& ranges) const
+{
+    uint_fast64_t version = _impl::TableFriend::get_version(*view.m_table);
+    KeyCache* cache = nullptr;
+    for (KeyCache& c: m_key_caches) {
+        if (c.column_ndx == column_ndx)
+            cache = &c;
+    }
+    if (!cache) {
+        m_key_caches.emplace_back(); // Throws
+        cache = &m_key_caches.back();
+        cache->column_ndx = column_ndx;
+        cache->table_version = version + 1; // Force reset below
+    }
+    if (cache->table_version != version) {
+        cache->table_version = version;
+        cache->data.clear();
+        cache->keys.clear();
+    }
+
+    // Only the rows of the view that have no key yet are read
+    const ColumnBase& column = view.get_column_base(column_ndx);
+    const StringEnumColumn* enum_column = dynamic_cast<const StringEnumColumn*>(&column);
+    const StringColumn* string_column = dynamic_cast<const StringColumn*>(&column);
+    REALM_ASSERT(enum_column || string_column);
+    std::size_t n = rows.size();
+    ranges.resize(n); // Throws
+    for (std::size_t i = 0; i < n; ++i) {
+        std::size_t row_ndx = rows[i];
+        std::unordered_map<std::size_t, KeyRange>::const_iterator j = cache->keys.find(row_ndx);
+        if (j != cache->keys.end()) {
+            ranges[i] = j->second;
+            continue;
+        }
+        StringData value = enum_column ? enum_column->get(row_ndx) : string_column->get(row_ndx);
+        KeyRange& range = ranges[i];
+        range.begin = cache->data.size();
+        range.is_null = value.is_null();
+        append_collation_key(value, cache->data); // Throws
+        range.end = cache->data.size();
+        cache->keys[row_ndx] = range; // Throws
+    }
+    return *cache;
+}
+
+inline void SortEngine::set_row_indexes(TableViewBase& view, const positions& rows, const positions& order)
+{
+    std::size_t n = order.size();
+    for (std::size_t i = 0; i < n; ++i)
+        view.m_row_indexes.set(i, int64_t(rows[order[i]])); // Throws
+}
+
+inline void SortEngine::sort(TableViewBase& view) const
+{
+    typedef std::vector<std::size_t>::const_iterator iter;
+    for (iter i = m_columns.begin(), end = m_columns.end(); i != end; ++i)
+        check_column_type(view, *i); // Throws
+
+    view.m_sorting_predicate = RowIndexes::Sorter(m_columns, m_ascending);
+    view.m_auto_sort = true;
+
+    std::size_t n = view.size();
+    if (n < 2 || m_columns.empty())
+        return;
+
+    // Detached rows are kept at the end and do not take part in the sort
+    positions rows;
+    positions detached;
+    rows.reserve(n); // Throws
+    for (std::size_t i = 0; i < n; ++i) {
+        std::size_t row_ndx = view.get_source_ndx(i);
+        if (row_ndx == detached_ref)
+            detached.push_back(row_ndx); // Throws
+        else
+            rows.push_back(row_ndx); // Throws
+    }
+
+    positions order(rows.size()); // Throws
+    for (std::size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+
+    // Least significant column first; each pass is stable
+    for (std::size_t c = m_columns.size(); c-- > 0; )
+        sort_column(view, m_columns[c], m_ascending[c], rows, order); // Throws
+
+    set_row_indexes(view, rows, order); // Throws
+    for (std::size_t i = 0; i < detached.size(); ++i)
+        view.m_row_indexes.set(rows.size() + i, int64_t(detached_ref)); // Throws
+}
+
+inline bool SortEngine::sync_if_needed(TableViewBase& view) const
+{
+    if (view.is_in_sync())
+        return false;
+    // Let the view rerun its query without its own comparison sort
+    bool auto_sort = view.m_auto_sort;
+    view.m_auto_sort = false;
+    view.sync_if_needed(); // Throws
+    view.m_auto_sort = auto_sort;
+    sort(view); // Throws
+    return true;
+}
+
+} // namespace realm
+
+#endif // REALM_SORT_ENGINE_HPP
@@ -0,0 +1,376 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_STALE_TABLE_TRACKER_HPP
+#define REALM_STALE_TABLE_TRACKER_HPP
+
+#include <vector>
+
+#include <realm/impl/transact_log.hpp>
+#include <realm/group.hpp>
+
+namespace realm {
+
+/// Tracks which tables and columns were modified by the transactions that a
+/// read transaction advances over, so that state derived from them can be
+/// refreshed when it is next used, rather than eagerly after every advance.
+///
+/// Group::advance_transact() only refreshes the accessors of tables that the
+/// transaction logs refer to. Bindings, however, usually keep derived state
+/// for every open table (table views, cached objects, list contents, UI
+/// models), and without knowing what changed, they must re-sync all of it
+/// after each advance. Pass the tracker to LangBindHelper::advance_read(),
+/// promote_to_write() or rollback_and_continue_as_read() to record the
+/// changes, and check it on first access instead:
+///
+///     StaleTableTracker stale;
+///     LangBindHelper::advance_read(sg, history, stale.observer());
+///     ...
+///     // When the UI next shows table 7:
+///     stale.refresh_if_stale(7, [&](const StaleTableTracker::TableState&) {
+///         view.sync_if_needed();
+///     });
+///
+/// The marks accumulate over multiple advances, until cleared by
+/// refresh_if_stale() or clear_stale(). Tables that were not touched cost
+/// nothing.
+///
+/// A change inside a subtable marks the column of the group-level table that
+/// holds the subtable, and a change to the set or order of group-level
+/// tables marks every table.
+class StaleTableTracker {
+public:
+    struct TableState {
+        /// True if anything in the table changed.
+        bool is_stale = false;
+
+        /// Rows were inserted, removed or moved (or the table was cleared).
+        bool rows_changed = false;
+
+        /// Columns were inserted, removed, renamed, or indexed, or the
+        /// table itself was moved.
+        bool schema_changed = false;
+
+        /// Columns whose values were modified. Row insertion and removal
+        /// changes every column, and is reported by rows_changed instead.
+        std::vector<bool> columns;
+
+        bool is_column_stale(std::size_t col_ndx) const REALM_NOEXCEPT;
+    };
+
+    class Observer;
+
+    bool is_stale(std::size_t table_ndx) const REALM_NOEXCEPT;
+
+    /// True if the values in the column may have changed (including by row
+    /// insertion or removal).
+    bool is_stale(std::size_t table_ndx, std::size_t col_ndx) const REALM_NOEXCEPT;
+
+    /// Returns null if the table is not stale.
+    const TableState* get_state(std::size_t table_ndx) const REALM_NOEXCEPT;
+
+    /// If the table is stale, call `refresh(const TableState&)` and clear
+    /// the mark. Returns true if \a refresh was called. The mark is not
+    /// cleared if \a refresh throws.
+    template<class F> bool refresh_if_stale(std::size_t table_ndx, F refresh);
+
+    void clear_stale(std::size_t table_ndx);
+    void clear_all() REALM_NOEXCEPT;
+
+    /// Mark every table stale, for example after the shared group was
+    /// re-opened, or on a transition that was not observed.
+    void mark_all_stale();
+
+    Observer observer() REALM_NOEXCEPT;
+
+private:
+    // Tables with an index at or above m_tables.size() are not stale, unless
+    // m_all_stale is set
+    std::vector<TableState> m_tables;
+
+    // After mark_all_stale(), every table is stale until it is cleared, which
+    // is recorded in m_cleared
+    bool m_all_stale = false;
+    std::vector<bool> m_cleared;
+    TableState m_all_state;
+
+    TableState& get(std::size_t table_ndx);
+    void mark_rows(std::size_t table_ndx);
+    void mark_schema(std::size_t table_ndx);
+    void mark_column(std::size_t table_ndx, std::size_t col_ndx);
+};
+
+
+/// Transaction log handler that records the changes in a StaleTableTracker.
+class StaleTableTracker::Observer: public _impl::NullInstructionObserver {
+public:
+    explicit Observer(StaleTableTracker&) REALM_NOEXCEPT;
+
+    bool select_table(std::size_t group_level_ndx, std::size_t levels, const std::size_t*);
+    bool select_descriptor(std::size_t levels, const std::size_t*);
+    bool select_link_list(std::size_t col_ndx, std::size_t row_ndx);
+    bool insert_group_level_table(std::size_t, std::size_t, StringData);
+    bool erase_group_level_table(std::size_t, std::size_t);
+    bool rename_group_level_table(std::size_t table_ndx, StringData);
+
+    bool insert_empty_rows(std::size_t, std::size_t, std::size_t, bool) { return rows(); }
+    bool erase_rows(std::size_t, std::size_t, std::size_t, bool) { return rows(); }
+    bool clear_table() { return rows(); }
+    bool optimize_table() { return rows(); }
+
+    bool set_int(std::size_t col_ndx, std::size_t, int_fast64_t) { return column(col_ndx); }
+    bool set_bool(std::size_t col_ndx, std::size_t, bool) { return column(col_ndx); }
+    bool set_float(std::size_t col_ndx, std::size_t, float) { return column(col_ndx); }
+    bool set_double(std::size_t col_ndx, std::size_t, double) { return column(col_ndx); }
+    bool set_string(std::size_t col_ndx, std::size_t, StringData) { return column(col_ndx); }
+    bool set_binary(std::size_t col_ndx, std::size_t, BinaryData) { return column(col_ndx); }
+    bool set_date_time(std::size_t col_ndx, std::size_t, DateTime) { return column(col_ndx); }
+    bool set_table(std::size_t col_ndx, std::size_t) { return column(col_ndx); }
+    bool set_mixed(std::size_t col_ndx, std::size_t, const Mixed&) { return column(col_ndx); }
+    bool set_link(std::size_t col_ndx, std::size_t, std::size_t) { return column(col_ndx); }
+    bool set_null(std::size_t col_ndx, std::size_t) { return column(col_ndx); }
+    bool nullify_link(std::size_t col_ndx, std::size_t) { return column(col_ndx); }
+
+    bool insert_link_column(std::size_t, DataType, StringData, std::size_t, std::size_t) { return schema(); }
+    bool insert_column(std::size_t, DataType, StringData, bool) { return schema(); }
+    bool erase_link_column(std::size_t, std::size_t, std::size_t) { return schema(); }
+    bool erase_column(std::size_t) { return schema(); }
+    bool rename_column(std::size_t, StringData) { return schema(); }
+    bool add_search_index(std::size_t) { return schema(); }
+    bool remove_search_index(std::size_t) { return schema(); }
+    bool add_primary_key(std::size_t) { return schema(); }
+    bool remove_primary_key() { return schema(); }
+    bool set_link_type(std::size_t, LinkType) { return schema(); }
+
+    bool link_list_set(std::size_t, std::size_t) { return link_list(); }
+    bool link_list_insert(std::size_t, std::size_t) { return link_list(); }
+    bool link_list_move(std::size_t, std::size_t) { return link_list(); }
+    bool link_list_swap(std::size_t, std::size_t) { return link_list(); }
+    bool link_list_erase(std::size_t) { return link_list(); }
+    bool link_list_nullify(std::size_t) { return link_list(); }
+    bool link_list_clear(std::size_t) { return link_list(); }
+
+private:
+    StaleTableTracker& m_tracker;
+    std::size_t m_table_ndx = npos;
+    std::size_t m_subtable_col_ndx = npos; // npos unless a subtable is selected
+    std::size_t m_link_list_col_ndx = npos;
+
+    bool rows();
+    bool column(std::size_t col_ndx);
+    bool schema();
+    bool link_list();
+};
+
+
+
+
+// Implementation:
+
+inline bool StaleTableTracker::TableState::is_column_stale(std::size_t col_ndx) const REALM_NOEXCEPT
+{
+    if (rows_changed || schema_changed)
+        return true;
+    return col_ndx < columns.size() && columns[col_ndx];
+}
+
+inline const StaleTableTracker::TableState*
+StaleTableTracker::get_state(std::size_t table_ndx) const REALM_NOEXCEPT
+{
+    if (table_ndx < m_tables.size() && m_tables[table_ndx].is_stale)
+        return &m_tables[table_ndx];
+    if (m_all_stale && !(table_ndx < m_cleared.size() && m_cleared[table_ndx]))
+        return &m_all_state;
+    return nullptr;
+}
+
+inline bool StaleTableTracker::is_stale(std::size_t table_ndx) const REALM_NOEXCEPT
+{
+    return get_state(table_ndx);
+}
+
+inline bool StaleTableTracker::is_stale(std::size_t table_ndx, std::size_t col_ndx) const REALM_NOEXCEPT
+{
+    const TableState* state = get_state(table_ndx);
+    return state && state->is_column_stale(col_ndx);
+}
+
+template<class F> bool StaleTableTracker::refresh_if_stale(std::size_t table_ndx, F refresh)
+{
+    const TableState* state = get_state(table_ndx);
+    if (!state)
+        return false;
+    refresh(*state); // Throws
+    clear_stale(table_ndx); // Throws
+    return true;
+}
+
+inline void StaleTableTracker::clear_stale(std::size_t table_ndx)
+{
+    if (m_all_stale) {
+        if (table_ndx >= m_cleared.size())
+            m_cleared.resize(table_ndx + 1); // Throws
+        m_cleared[table_ndx] = true;
+    }
+    if (table_ndx < m_tables.size()) {
+        TableState& state = m_tables[table_ndx];
+        state.is_stale = false;
+        state.rows_changed = false;
+        state.schema_changed = false;
+        state.columns.clear();
+    }
+}
+
+inline void StaleTableTracker::clear_all() REALM_NOEXCEPT
+{
+    m_tables.clear();
+    m_cleared.clear();
+    m_all_stale = false;
+}
+
+inline void StaleTableTracker::mark_all_stale()
+{
+    m_tables.clear();
+    m_cleared.clear();
+    m_all_stale = true;
+    m_all_state.is_stale = true;
+    m_all_state.rows_changed = true;
+    m_all_state.schema_changed = true;
+}
+
+inline StaleTableTracker::TableState& StaleTableTracker::get(std::size_t table_ndx)
+{
+    if (table_ndx >= m_tables.size())
+        m_tables.resize(table_ndx + 1); // Throws
+    TableState& state = m_tables[table_ndx];
+    if (m_all_stale && !(table_ndx < m_cleared.size() && m_cleared[table_ndx])) {
+        // Still covered by mark_all_stale()
+        state.rows_changed = true;
+        state.schema_changed = true;
+    }
+    return state;
+}
+
+inline void StaleTableTracker::mark_rows(std::size_t table_ndx)
+{
+    TableState& state = get(table_ndx); // Throws
+    state.is_stale = true;
+    state.rows_changed = true;
+}
+
+inline void StaleTableTracker::mark_schema(std::size_t table_ndx)
+{
+    TableState& state = get(table_ndx); // Throws
+    state.is_stale = true;
+    state.schema_changed = true;
+}
+
+inline void StaleTableTracker::mark_column(std::size_t table_ndx, std::size_t col_ndx)
+{
+    TableState& state = get(table_ndx); // Throws
+    state.is_stale = true;
+    if (col_ndx >= state.columns.size())
+        state.columns.resize(col_ndx + 1); // Throws
+    state.columns[col_ndx] = true;
+}
+
+inline StaleTableTracker::Observer StaleTableTracker::observer() REALM_NOEXCEPT
+{
+    return Observer(*this);
+}
+
+
+inline StaleTableTracker::Observer::Observer(StaleTableTracker& tracker) REALM_NOEXCEPT:
+    m_tracker(tracker)
+{
+}
+
+inline bool StaleTableTracker::Observer::select_table(std::size_t group_level_ndx, std::size_t levels,
+                                                      const std::size_t* path)
+{
+    // The path is a sequence of (column, row) pairs, starting at the
+    // group-level table
+    m_table_ndx = group_level_ndx;
+    m_subtable_col_ndx = levels == 0 ? npos : path[0];
+    m_link_list_col_ndx = npos;
+    return true;
+}
+
+inline bool StaleTableTracker::Observer::select_descriptor(std::size_t, const std::size_t*)
+{
+    return true;
+}
+
+inline bool StaleTableTracker::Observer::select_link_list(std::size_t col_ndx, std::size_t)
+{
+    m_link_list_col_ndx = col_ndx;
+    return true;
+}
+
+inline bool StaleTableTracker::Observer::insert_group_level_table(std::size_t, std::size_t, StringData)
+{
+    // Tables after the new one change index
+    m_tracker.mark_all_stale(); // Throws
+    return true;
+}
+
+inline bool StaleTableTracker::Observer::erase_group_level_table(std::size_t, std::size_t)
+{
+    m_tracker.mark_all_stale(); // Throws
+    return true;
+}
+
+inline bool StaleTableTracker::Observer::rename_group_level_table(std::size_t table_ndx, StringData)
+{
+    m_tracker.mark_schema(table_ndx); // Throws
+    return true;
+}
+
+inline bool StaleTableTracker::Observer::rows()
+{
+    // Inserting rows into a subtable changes a cell of the group-level table
+    if (m_subtable_col_ndx != npos)
+        return column(m_subtable_col_ndx); // Throws
+    m_tracker.mark_rows(m_table_ndx); // Throws
+    return true;
+}
+
+inline bool StaleTableTracker::Observer::column(std::size_t col_ndx)
+{
+    if (m_subtable_col_ndx != npos)
+        col_ndx = m_subtable_col_ndx;
+    m_tracker.mark_column(m_table_ndx, col_ndx); // Throws
+    return true;
+}
+
+inline bool StaleTableTracker::Observer::schema()
+{
+    // Also for the shared descriptor of the subtables of a column
+    m_tracker.mark_schema(m_table_ndx); // Throws
+    return true;
+}
+
+inline bool StaleTableTracker::Observer::link_list()
+{
+    return column(m_link_list_col_ndx); // Throws
+}
+
+} // namespace realm
+
+#endif // REALM_STALE_TABLE_TRACKER_HPP
@@ -38,6 +38,7 @@
 #include <realm/mixed.hpp>
 #include <realm/query.hpp>
 #include <realm/column.hpp>
+#include <realm/impl/destroy_guard.hpp>
 
 namespace realm {
 
@@ -395,6 +396,24 @@ public:
 
     //@}
 
+    //@{
+
+    /// Remove a set of rows, with the same effect as calling remove() or
+    /// move_last_over() once for each of them, but in a single batch.
+    ///
+    /// The row indexes refer to the table before any of the rows are removed,
+    /// may be given in any order, and may contain duplicates. The rows are
+    /// removed from the highest index downwards, so that removing one row
+    /// never moves another row of the set, and cascading removals are
+    /// collected for the whole set. Table views are updated once, as for
+    /// TableView::clear(). Removing every row of the table is done as by
+    /// clear().
+
+    void remove_rows(const std::vector<std::size_t>& row_indexes);
+    void move_last_over_rows(const std::vector<std::size_t>& row_indexes);
+
+    //@}
+
     // Get cell values
     int64_t     get_int(std::size_t column_ndx, std::size_t row_ndx) const REALM_NOEXCEPT;
     bool        get_bool(std::size_t column_ndx, std::size_t row_ndx) const REALM_NOEXCEPT;
@@ -847,6 +866,7 @@ private:
 
     void erase_row(size_t row_ndx, bool is_move_last_over);
     void batch_erase_rows(const IntegerColumn& row_indexes, bool is_move_last_over);
+    void batch_erase_rows(const std::vector<std::size_t>& row_indexes, bool is_move_last_over);
     void do_remove(size_t row_ndx, bool broken_reciprocal_backlinks);
     void do_move_last_over(size_t row_ndx, bool broken_reciprocal_backlinks);
     void do_clear(bool broken_reciprocal_backlinks);
@@ -1397,6 +1417,51 @@ inline void Table::remove_last()
         remove(size()-1);
 }
 
+inline void Table::remove_rows(const std::vector<size_t>& row_indexes)
+{
+    bool is_move_last_over = false;
+    batch_erase_rows(row_indexes, is_move_last_over); // Throws
+}
+
+inline void Table::move_last_over_rows(const std::vector<size_t>& row_indexes)
+{
+    bool is_move_last_over = true;
+    batch_erase_rows(row_indexes, is_move_last_over); // Throws
+}
+
+inline void Table::batch_erase_rows(const std::vector<size_t>& row_indexes, bool is_move_last_over)
+{
+    REALM_ASSERT(is_attached());
+    std::vector<size_t> rows(row_indexes); // Throws
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    if (rows.empty())
+        return;
+    REALM_ASSERT_3(rows.back(), <, size());
+    if (rows.size() == size()) {
+        clear(); // Throws
+        return;
+    }
+    if (rows.size() == 1) {
+        erase_row(rows.front(), is_move_last_over); // Throws
+        return;
+    }
+
+    // FIXME: This code is unreasonably complicated because it uses `IntegerColumn` as
+    // a free-standing container, and because `IntegerColumn` does not conform to the
+    // RAII idiom (nor should it).
+    Allocator& alloc = Allocator::get_default();
+    _impl::DeepArrayRefDestroyGuard ref_guard(alloc);
+    ref_guard.reset(IntegerColumn::create(alloc)); // Throws
+    IntegerColumn row_column(alloc, ref_guard.get()); // Throws
+    ref_guard.release();
+    // The root ref changes as the column grows, so destroy through the column
+    _impl::DestroyGuard<IntegerColumn> column_guard(&row_column);
+    for (size_t row_ndx: rows)
+        row_column.add(int64_t(row_ndx)); // Throws
+    batch_erase_rows(row_column, is_move_last_over); // Throws
+}
+
 inline void Table::register_view(const TableViewBase* view)
 {
     // Casting away constness here - operations done on tableviews
@@ -1983,6 +2048,14 @@ public:
         return *table.m_cols[col_ndx];
     }
 
+    /// Changes whenever the table, or a table it links to, is modified. Used
+    /// by accessor-side structures (such as secondary indexes) that must
+    /// detect when they have gone out of sync with the table.
+    static uint_fast64_t get_version(const Table& table) REALM_NOEXCEPT
+    {
+        return table.m_version;
+    }
+
     static void do_remove(Table& table, std::size_t row_ndx)
     {
         bool broken_reciprocal_backlinks = false;
@@ -434,6 +434,7 @@ private:
 
     friend class BasicTable;
     friend class SharedGroup;
+    friend class HandoverBatch;
     template<class, int, class> friend class _impl::QueryColumnBase;
     template<class, int, class> friend class _impl::QueryColumn;
 };
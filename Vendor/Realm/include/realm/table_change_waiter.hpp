@@ -0,0 +1,232 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_TABLE_CHANGE_WAITER_HPP
+#define REALM_TABLE_CHANGE_WAITER_HPP
+
+#include <chrono>
+#include <vector>
+
+#include <realm/util/thread.hpp>
+#include <realm/group_shared.hpp>
+#include <realm/lang_bind_helper.hpp>
+#include <realm/stale_table_tracker.hpp>
+
+namespace realm {
+
+/// Waits for commits that change a specific set of tables, or columns of
+/// tables, rather than for any commit to the file.
+///
+/// SharedGroup::has_changed() and wait_for_change() report every commit. A
+/// thread that is only interested in one table must then advance its read
+/// transaction and look at the result itself. The waiter does that work: it
+/// advances the read transaction of the shared group through
+/// LangBindHelper::advance_read(), records which tables and columns the
+/// transaction logs touched, and only returns when they intersect the
+/// watched set:
+///
+///     sg.begin_read();
+///     TableChangeWaiter waiter(sg, history);
+///     waiter.watch_table(3);
+///     waiter.watch_column(5, 2);
+///     while (waiter.wait_for_change()) {
+///         // Table 3 or column 2 of table 5 changed, and the read
+///         // transaction of sg is at the latest version.
+///     }
+///
+/// The shared group must be in a read transaction, which the waiter keeps
+/// advancing. Commits that only touch other tables are absorbed without
+/// returning. Insertion, removal or reordering of group-level tables is
+/// reported to every waiter, because table indexes may have changed.
+///
+/// The filtering happens in the waiting thread, after it has been woken up.
+/// Every waiting thread is still woken up, and advances its read
+/// transaction, on every commit to the file. What the waiter saves is the
+/// work the caller would do for commits that do not concern it.
+///
+/// SharedGroup::wait_for_change() is not available on Apple platforms. There
+/// wait_for_change() polls SharedGroup::has_changed() every
+/// `poll_interval` milliseconds instead, so changes are seen up to that
+/// much later, and the thread wakes up at that rate while waiting.
+class TableChangeWaiter {
+public:
+    TableChangeWaiter(SharedGroup&, History&);
+
+    /// Report any change to the specified table.
+    void watch_table(std::size_t table_ndx);
+
+    /// Report changes to the values of the specified column, including row
+    /// insertion and removal, and changes to the table schema.
+    void watch_column(std::size_t table_ndx, std::size_t col_ndx);
+
+    void unwatch_all() REALM_NOEXCEPT;
+
+    /// Advance the read transaction to the latest version, if a newer one
+    /// is available, and return true if the watched tables changed. Does not
+    /// block.
+    bool has_changed();
+
+    /// Block until a commit changes the watched tables, and return true, or
+    /// until release() is called, and return false. Returns immediately if a
+    /// change occurred since the last call to has_changed() or
+    /// wait_for_change().
+    bool wait_for_change();
+
+    /// Make wait_for_change() return false, now and in future calls. May be
+    /// called from any thread.
+    void release() REALM_NOEXCEPT;
+
+    /// How often wait_for_change() polls on Apple platforms, in
+    /// milliseconds.
+    static const int poll_interval = 100;
+
+    /// Number of advances over commits that did not change the watched
+    /// tables.
+    uint_fast64_t get_num_filtered() const REALM_NOEXCEPT { return m_num_filtered; }
+
+private:
+    struct Watch {
+        std::size_t table_ndx;
+        std::size_t col_ndx; // npos for the whole table
+    };
+
+    SharedGroup& m_shared_group;
+    History& m_history;
+    std::vector<Watch> m_watches;
+    StaleTableTracker m_tracker;
+    uint_fast64_t m_num_filtered = 0;
+
+    // Used for polling where SharedGroup::wait_for_change() is unavailable
+    util::Mutex m_mutex;
+    util::CondVar m_cond;
+    bool m_is_released = false;
+
+    bool advance();
+    bool is_watched_changed() const REALM_NOEXCEPT;
+};
+
+
+
+
+// Implementation:
+
+inline TableChangeWaiter::TableChangeWaiter(SharedGroup& sg, History& history):
+    m_shared_group(sg),
+    m_history(history)
+{
+}
+
+inline void TableChangeWaiter::watch_table(std::size_t table_ndx)
+{
+    m_watches.push_back(Watch{table_ndx, npos}); // Throws
+}
+
+inline void TableChangeWaiter::watch_column(std::size_t table_ndx, std::size_t col_ndx)
+{
+    m_watches.push_back(Watch{table_ndx, col_ndx}); // Throws
+}
+
+inline void TableChangeWaiter::unwatch_all() REALM_NOEXCEPT
+{
+    m_watches.clear();
+}
+
+inline bool TableChangeWaiter::has_changed()
+{
+    if (!m_shared_group.has_changed())
+        return false;
+    return advance(); // Throws
+}
+
+#ifndef __APPLE__
+
+inline bool TableChangeWaiter::wait_for_change()
+{
+    for (;;) {
+        if (!m_shared_group.wait_for_change())
+            return false;
+        if (advance()) // Throws
+            return true;
+    }
+}
+
+inline void TableChangeWaiter::release() REALM_NOEXCEPT
+{
+    m_shared_group.wait_for_change_release();
+}
+
+#else // __APPLE__
+
+inline bool TableChangeWaiter::wait_for_change()
+{
+    for (;;) {
+        {
+            util::LockGuard lg(m_mutex);
+            if (m_is_released)
+                return false;
+        }
+        if (has_changed()) // Throws
+            return true;
+
+        std::chrono::system_clock::time_point deadline =
+            std::chrono::system_clock::now() + std::chrono::milliseconds(poll_interval);
+        std::chrono::nanoseconds since_epoch = deadline.time_since_epoch();
+        struct timespec ts;
+        ts.tv_sec = time_t(std::chrono::duration_cast<std::chrono::seconds>(since_epoch).count());
+        ts.tv_nsec = long((since_epoch - std::chrono::seconds(ts.tv_sec)).count());
+        util::LockGuard lg(m_mutex);
+        if (!m_is_released)
+            m_cond.wait(lg, &ts);
+    }
+}
+
+inline void TableChangeWaiter::release() REALM_NOEXCEPT
+{
+    util::LockGuard lg(m_mutex);
+    m_is_released = true;
+    m_cond.notify_all();
+}
+
+#endif // __APPLE__
+
+inline bool TableChangeWaiter::advance()
+{
+    m_tracker.clear_all();
+    StaleTableTracker::Observer observer = m_tracker.observer();
+    LangBindHelper::advance_read(m_shared_group, m_history, observer); // Throws
+    if (is_watched_changed())
+        return true;
+    ++m_num_filtered;
+    return false;
+}
+
+inline bool TableChangeWaiter::is_watched_changed() const REALM_NOEXCEPT
+{
+    typedef std::vector<Watch>::const_iterator iter;
+    for (iter i = m_watches.begin(), end = m_watches.end(); i != end; ++i) {
+        if (i->col_ndx == npos ? m_tracker.is_stale(i->table_ndx) :
+            m_tracker.is_stale(i->table_ndx, i->col_ndx))
+            return true;
+    }
+    return false;
+}
+
+} // namespace realm
+
+#endif // REALM_TABLE_CHANGE_WAITER_HPP
@@ -391,6 +391,12 @@ private:
     friend class Table;
     friend class Query;
     friend class SharedGroup;
+    friend class HandoverBatch;
+    friend class SortEngine;
+    friend class GroupBy;
+    friend class Statistics;
+    friend class DistinctFilter;
+    friend class BatchReader;
     template<class Tab, class View, class Impl> friend class BasicTableViewBase;
 
     // Called by table to adjust any row references:
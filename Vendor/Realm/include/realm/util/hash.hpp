@@ -0,0 +1,69 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_UTIL_HASH_HPP
+#define REALM_UTIL_HASH_HPP
+
+#include <cstddef>
+#include <stdint.h>
+
+#include <realm/util/features.h>
+
+namespace realm {
+namespace util {
+
+
+/// 64-bit FNV-1a hash of the specified bytes. Fast for short keys and
+/// stable across platforms and runs, so results may be compared between
+/// processes.
+inline uint64_t hash_bytes(const char* data, std::size_t size,
+                           uint64_t seed = 0xcbf29ce484222325ULL) REALM_NOEXCEPT
+{
+    uint64_t h = seed;
+    for (std::size_t i = 0; i < size; ++i) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/// Finalizer from MurmurHash3. Spreads every input bit over the whole
+/// result, which makes it suitable for hashing integers, and for improving
+/// the low bits of hash_bytes() before they are used as a bucket index.
+inline uint64_t hash_mix(uint64_t h) REALM_NOEXCEPT
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/// Combine the hash of one more value into \a seed.
+inline uint64_t hash_combine(uint64_t seed, uint64_t h) REALM_NOEXCEPT
+{
+    return hash_mix(seed ^ (h + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+}
+
+
+} // namespace util
+} // namespace realm
+
+#endif // REALM_UTIL_HASH_HPP
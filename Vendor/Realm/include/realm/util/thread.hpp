@@ -280,6 +280,10 @@ public:
 
     /// Wait for another thread to call notify() or notify_all().
     void wait(LockGuard& l) REALM_NOEXCEPT;
+
+    /// Same as wait(LockGuard&), but also return once the absolute time
+    /// \a tp (of the system clock) has passed.
+    void wait(LockGuard& l, const struct timespec* tp) REALM_NOEXCEPT;
     template<class Func>
     void wait(RobustMutex& m, Func recover_func, const struct timespec* tp = 0);
 
@@ -524,6 +528,13 @@ inline void CondVar::wait(LockGuard& l) REALM_NOEXCEPT
         REALM_TERMINATE("pthread_cond_wait() failed");
 }
 
+inline void CondVar::wait(LockGuard& l, const struct timespec* tp) REALM_NOEXCEPT
+{
+    int r = pthread_cond_timedwait(&m_impl, &l.m_mutex.m_impl, tp);
+    if (REALM_UNLIKELY(r != 0 && r != ETIMEDOUT))
+        REALM_TERMINATE("pthread_cond_timedwait() failed");
+}
+
 template<class Func>
 inline void CondVar::wait(RobustMutex& m, Func recover_func, const struct timespec* tp)
 {
@@ -0,0 +1,287 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_WRITE_AHEAD_LOG_HPP
+#define REALM_WRITE_AHEAD_LOG_HPP
+
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <realm/util/features.h>
+#include <realm/util/file.hpp>
+#include <realm/replication.hpp>
+#include <realm/group_shared.hpp>
+#include <realm/commit_log.hpp>
+
+// The write-ahead log relies on durability_Async, and so on the async
+// daemon, which is not built for iOS, watchOS or Windows. There this header
+// declares nothing, and REALM_HAVE_WRITE_AHEAD_LOG is left undefined, so
+// that code which uses it can fall back to durability_Full.
+#ifdef REALM_ASYNC_DAEMON
+#define REALM_HAVE_WRITE_AHEAD_LOG 1
+
+namespace realm {
+
+/// Makes commits durable by appending their transaction logs to a sequential
+/// log file, instead of by synchronizing the database file.
+///
+/// With durability_Full, every commit writes the modified arrays to scattered
+/// places in the database file, synchronizes it, writes the new top ref, and
+/// synchronizes again. With durability_Async, commits are not synchronized,
+/// and the async daemon checkpoints the database file to disk in the
+/// background, but commits since the last checkpoint are lost on a crash.
+///
+/// A write-ahead log combines durability_Async with a log of every commit.
+/// Each commit appends its transaction log to the file at
+/// `database_file + ".wal"` in a single sequential write, and synchronizes it
+/// once. After a crash, recover() replays the commits that the checkpointed
+/// database file is missing:
+///
+///     WriteAheadLog::recover(path);
+///     WriteAheadLog wal(path);
+///     SharedGroup sg(wal, SharedGroup::durability_Async);
+///
+/// recover() must be called while no session is in progress, that is, before
+/// the first SharedGroup of the process opens the file, and only if no other
+/// process has it open. Every SharedGroup of the session must be opened with
+/// a write-ahead log, since commits without one are not logged.
+///
+/// recover() is also the only place where the log is truncated, so the log
+/// grows by every commit for the duration of a session. The async daemon
+/// checkpoints the database file within the core library, and neither the
+/// version it has made durable nor the time it did so is visible here, so
+/// entries cannot safely be dropped while a session is in progress.
+/// Applications with long sessions should watch get_log_size(), and end the
+/// session (close every SharedGroup, which makes the daemon checkpoint the
+/// final version), call recover(), and reopen when the log grows too big.
+///
+/// An entry is appended when the commit is prepared, before the database file
+/// is updated. If the commit then fails, the entry is truncated away again,
+/// or, if another process has appended after it, superseded by the next
+/// entry of the same version, which recover() prefers.
+///
+/// Available only where the async daemon is (see REALM_HAVE_WRITE_AHEAD_LOG).
+class WriteAheadLog: public TrivialReplication {
+public:
+    explicit WriteAheadLog(const std::string& database_file);
+    ~WriteAheadLog() REALM_NOEXCEPT {}
+
+    /// Replay the logged commits that are missing from the database file,
+    /// commit them with full durability, and truncate the log. Returns the
+    /// number of commits replayed. A partially written commit at the end of
+    /// the log, from a crash during the append, is ignored.
+    ///
+    /// \throw LogFileError If the log does not connect to the version of the
+    /// database file.
+    static std::size_t recover(const std::string& database_file,
+                               const char* encryption_key = 0);
+
+    static std::string get_log_path(const std::string& database_file);
+
+    /// Current size of the log, in bytes.
+    util::File::SizeType get_log_size();
+
+protected:
+    void prepare_changeset(const char* data, std::size_t size, version_type new_version) override;
+    void finalize_changeset() REALM_NOEXCEPT override;
+    void do_abort_transact(SharedGroup&) REALM_NOEXCEPT override;
+
+private:
+    // Each entry is a header followed by the changeset
+    struct EntryHeader {
+        uint_fast64_t version;
+        uint_fast64_t size;
+        uint_fast64_t checksum; // Of version, size, and changeset
+    };
+
+    util::File m_file;
+    std::vector<char> m_buffer;
+
+    // The entry of a prepared commit, which is neither finalized nor
+    // aborted yet
+    bool m_is_pending = false;
+    util::File::SizeType m_pending_begin = 0;
+    util::File::SizeType m_pending_end = 0;
+
+    void discard_pending() REALM_NOEXCEPT;
+    static uint_fast64_t checksum(const EntryHeader&, const char* data) REALM_NOEXCEPT;
+};
+
+
+
+
+// Implementation:
+
+inline WriteAheadLog::WriteAheadLog(const std::string& database_file):
+    TrivialReplication(database_file)
+{
+    m_file.open(get_log_path(database_file), util::File::mode_Append); // Throws
+}
+
+inline std::string WriteAheadLog::get_log_path(const std::string& database_file)
+{
+    return database_file + ".wal"; // Throws
+}
+
+inline util::File::SizeType WriteAheadLog::get_log_size()
+{
+    return m_file.get_size(); // Throws
+}
+
+inline void WriteAheadLog::prepare_changeset(const char* data, std::size_t size,
+                                             version_type new_version)
+{
+    // The entry goes out in a single write, and the log is opened in
+    // append mode, so concurrent writers (which are serialized by the write
+    // lock anyway) cannot interleave
+    discard_pending();
+    EntryHeader header;
+    header.version = new_version;
+    header.size = size;
+    header.checksum = checksum(header, data);
+    m_buffer.resize(sizeof header + size); // Throws
+    std::memcpy(m_buffer.data(), &header, sizeof header);
+    if (size != 0)
+        std::memcpy(m_buffer.data() + sizeof header, data, size);
+    m_pending_begin = m_file.get_size(); // Throws
+    m_is_pending = true;
+    m_file.write(m_buffer.data(), m_buffer.size()); // Throws
+    m_file.sync(); // Throws
+    m_pending_end = m_pending_begin + util::File::SizeType(m_buffer.size());
+}
+
+inline void WriteAheadLog::finalize_changeset() REALM_NOEXCEPT
+{
+    m_is_pending = false;
+}
+
+inline void WriteAheadLog::do_abort_transact(SharedGroup&) REALM_NOEXCEPT
+{
+    // TrivialReplication has nothing to undo on abort
+    discard_pending();
+}
+
+inline void WriteAheadLog::discard_pending() REALM_NOEXCEPT
+{
+    if (!m_is_pending)
+        return;
+    m_is_pending = false;
+    // Writers are serialized by the write lock, which is still held, so if
+    // the log ends with the entry of the failed commit, nobody can append
+    // to it while it is truncated. If the append itself failed halfway, the
+    // partial entry is truncated too. If truncation fails, recover() skips
+    // the entry in favor of the next one of the same version.
+    try {
+        util::File::SizeType size = m_file.get_size(); // Throws
+        if (size <= m_pending_end || m_pending_end == 0) {
+            m_file.resize(m_pending_begin); // Throws
+            m_file.sync(); // Throws
+        }
+    }
+    catch (...) {
+    }
+    m_pending_end = 0;
+}
+
+inline std::size_t WriteAheadLog::recover(const std::string& database_file,
+                                          const char* encryption_key)
+{
+    std::string log_path = get_log_path(database_file); // Throws
+    if (!util::File::exists(log_path)) // Throws
+        return 0;
+
+    util::File file(log_path, util::File::mode_Update); // Throws
+    std::vector<char> log(std::size_t(file.get_size())); // Throws
+    std::size_t n = 0;
+    while (n < log.size()) {
+        std::size_t m = file.read(log.data() + n, log.size() - n); // Throws
+        if (m == 0)
+            break;
+        n += m;
+    }
+    log.resize(n);
+
+    std::size_t num_replayed = 0;
+    {
+        bool no_create = false;
+        SharedGroup sg(database_file, no_create, SharedGroup::durability_Full,
+                       encryption_key); // Throws
+        uint_fast64_t version;
+        {
+            ReadTransaction rt(sg); // Throws
+            version = sg.get_version_of_current_transaction().version;
+        }
+        // An entry that is followed by another of the same version belongs
+        // to a commit that failed after its entry was written, so the last
+        // entry of each version is the one that was committed
+        std::map<uint_fast64_t, std::size_t> entries; // Version -> position
+        std::size_t pos = 0;
+        while (log.size() - pos >= sizeof (EntryHeader)) {
+            EntryHeader header;
+            std::memcpy(&header, log.data() + pos, sizeof header);
+            const char* data = log.data() + pos + sizeof header;
+            if (log.size() - pos - sizeof header < header.size)
+                break; // Torn write
+            if (checksum(header, data) != header.checksum)
+                break; // Torn write
+            if (header.version > version)
+                entries[header.version] = pos; // Throws
+            pos += sizeof header + std::size_t(header.size);
+        }
+        typedef std::map<uint_fast64_t, std::size_t>::const_iterator iter;
+        for (iter i = entries.begin(), end = entries.end(); i != end; ++i) {
+            if (i->first != version + 1)
+                throw LogFileError(log_path);
+            EntryHeader header;
+            std::memcpy(&header, log.data() + i->second, sizeof header);
+            const char* data = log.data() + i->second + sizeof header;
+            apply_changeset(data, std::size_t(header.size), sg); // Throws
+            version = header.version;
+            ++num_replayed;
+        }
+    }
+
+    file.resize(0); // Throws
+    file.sync(); // Throws
+    return num_replayed;
+}
+
+inline uint_fast64_t WriteAheadLog::checksum(const EntryHeader& header, const char* data) REALM_NOEXCEPT
+{
+    // FNV-1a
+    uint_fast64_t h = 14695981039346656037ULL;
+    auto mix = [&](const char* p, std::size_t size) {
+        for (std::size_t i = 0; i < size; ++i) {
+            h ^= static_cast<unsigned char>(p[i]);
+            h *= 1099511628211ULL;
+        }
+    };
+    mix(reinterpret_cast<const char*>(&header.version), sizeof header.version);
+    mix(reinterpret_cast<const char*>(&header.size), sizeof header.size);
+    mix(data, std::size_t(header.size));
+    return h;
+}
+
+} // namespace realm
+
+#endif // REALM_ASYNC_DAEMON
+
+#endif // REALM_WRITE_AHEAD_LOG_HPP
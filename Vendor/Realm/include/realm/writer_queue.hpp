@@ -0,0 +1,487 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_WRITER_QUEUE_HPP
+#define REALM_WRITER_QUEUE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <realm/util/features.h>
+#include <realm/util/file.hpp>
+#include <realm/util/thread.hpp>
+#include <realm/util/platform_specific_condvar.hpp>
+
+namespace realm {
+
+/// Orders the writers of a database file by priority, and first-come
+/// first-served within each priority.
+///
+/// SharedGroup::begin_write() blocks on a single process-shared mutex, which
+/// does not order its waiters, so a writer that commits in a loop, such as a
+/// bulk importer, can keep a latency-sensitive writer out for as long as the
+/// loop runs. A writer queue is placed in front of begin_write(). Every
+/// writer, in every process, takes a turn from the queue before it begins
+/// its write transaction, and gives it back after committing:
+///
+///     WriterQueue queue(path);
+///
+///     // UI thread
+///     {
+///         WriterQueue::Turn turn(queue, WriterQueue::priority_High);
+///         WriteTransaction wt(sg);
+///         ...
+///         wt.commit();
+///     }
+///
+///     // Importer thread
+///     WriterQueue::Turn turn(queue, WriterQueue::priority_Low);
+///     sg.begin_write();
+///     for (const Chunk& chunk : chunks) {
+///         import(chunk);
+///         if (turn.should_yield()) {
+///             sg.commit();
+///             turn.yield(); // Lets the high priority writers in first
+///             sg.begin_write();
+///         }
+///     }
+///     sg.commit();
+///
+/// When a turn is given back, the next turn goes to the waiting writer of
+/// the highest priority that has waited the longest. To keep low priority
+/// writers from starving, a writer that has been passed over by
+/// `max_passes` turns goes first, regardless of priority.
+///
+/// The queue only orders writers that use it. Writers that call
+/// begin_write() directly still compete for the write mutex as before.
+///
+/// The state of the queue is kept in a file next to the database file
+/// (`database_file + ".writers"`). A turn that is held, or waited for, by a
+/// process that has died is reclaimed by the other waiters, which check for
+/// this every `liveness_check_interval` milliseconds.
+class WriterQueue {
+public:
+    enum Priority {
+        priority_Low,
+        priority_Normal,
+        priority_High
+    };
+
+    static const int num_priorities = 3;
+
+    /// Number of turns that a waiting writer can be passed over by, before
+    /// it goes first.
+    static const uint_fast32_t max_passes = 16;
+
+    /// Maximum number of writers, from all processes, that can wait at the
+    /// same time. Further writers wait for a free place.
+    static const std::size_t max_waiters = 64;
+
+    /// Interval, in milliseconds, at which waiters check that the holder of
+    /// the turn, and the waiters ahead of them, are still alive.
+    static const int liveness_check_interval = 100;
+
+    struct Stats {
+        /// Number of turns taken.
+        uint_fast64_t num_turns = 0;
+
+        /// Number of times a turn was given back by yield().
+        uint_fast64_t num_yields = 0;
+
+        /// Time spent waiting for turns, in total, and at most.
+        std::chrono::nanoseconds total_wait = std::chrono::nanoseconds::zero();
+        std::chrono::nanoseconds max_wait = std::chrono::nanoseconds::zero();
+    };
+
+    class Turn;
+
+    explicit WriterQueue(const std::string& database_file);
+    ~WriterQueue() REALM_NOEXCEPT {}
+
+    /// Statistics over all the processes using the queue, since the queue
+    /// was created by the first of them.
+    Stats get_stats(Priority) const;
+
+    /// The number of writers currently waiting for a turn.
+    std::size_t get_num_waiting(Priority) const REALM_NOEXCEPT;
+
+    static std::string get_queue_path(const std::string& database_file);
+
+private:
+    struct Waiter {
+        uint_fast64_t ticket;
+        uint_fast64_t passes;
+        uint32_t pid; // Zero if the place is free
+        uint32_t priority;
+    };
+
+    struct SharedStats {
+        uint64_t num_turns;
+        uint64_t num_yields;
+        uint64_t total_wait_ns;
+        uint64_t max_wait_ns;
+    };
+
+    // Placed in the memory mapped queue file
+    struct SharedInfo {
+        util::RobustMutex mutex;
+        util::PlatformSpecificCondVar::SharedPart cond;
+        uint64_t next_ticket;
+        uint32_t holder_pid; // Zero if no turn is held
+        std::atomic<uint32_t> num_waiting[num_priorities];
+        Waiter waiters[max_waiters];
+        SharedStats stats[num_priorities];
+
+        SharedInfo();
+    };
+
+    util::File m_file;
+    util::File::Map<SharedInfo> m_map;
+    mutable util::PlatformSpecificCondVar m_cond;
+
+    SharedInfo& get_info() const REALM_NOEXCEPT { return *m_map.get_addr(); }
+    void lock() const;
+    void unlock() const REALM_NOEXCEPT;
+    void acquire(Priority);
+    void release(Priority, bool yielded) REALM_NOEXCEPT;
+    void recover() REALM_NOEXCEPT;
+    std::size_t select_next() const REALM_NOEXCEPT;
+    static bool is_alive(uint32_t pid) REALM_NOEXCEPT;
+};
+
+
+/// A turn to write, which is held for the lifetime of the object.
+class WriterQueue::Turn {
+public:
+    /// Wait for a turn.
+    Turn(WriterQueue&, Priority);
+
+    /// Give back the turn.
+    ~Turn() REALM_NOEXCEPT;
+
+    /// Whether a writer of higher priority is waiting, or one that must go
+    /// first because it has been passed over too many times.
+    bool should_yield() const REALM_NOEXCEPT;
+
+    /// Give back the turn, and wait for a new one at the same priority,
+    /// behind the writers that are already waiting. Must not be called
+    /// while in a write transaction.
+    void yield();
+
+    Priority get_priority() const REALM_NOEXCEPT { return m_priority; }
+
+private:
+    WriterQueue& m_queue;
+    Priority m_priority;
+    bool m_is_held = false;
+};
+
+
+
+
+// Implementation:
+
+inline WriterQueue::SharedInfo::SharedInfo():
+    next_ticket(0),
+    holder_pid(0)
+{
+    util::PlatformSpecificCondVar::init_shared_part(cond); // Throws
+    for (int i = 0; i < num_priorities; ++i) {
+        num_waiting[i] = 0;
+        stats[i] = SharedStats();
+    }
+    for (std::size_t i = 0; i < max_waiters; ++i)
+        waiters[i] = Waiter();
+}
+
+inline WriterQueue::WriterQueue(const std::string& database_file)
+{
+    std::string path = get_queue_path(database_file); // Throws
+    m_file.open(path, util::File::access_ReadWrite, util::File::create_Auto, 0); // Throws
+
+    // The first process to open the queue, which is the only one that can
+    // get an exclusive lock, initializes it. The shared lock that is held
+    // from then on keeps later processes from initializing it again, while
+    // it is in use.
+    if (m_file.try_lock_exclusive()) { // Throws
+        util::File::UnlockGuard ug(m_file);
+        if (m_file.get_size() < util::File::SizeType(sizeof (SharedInfo))) // Throws
+            m_file.resize(sizeof (SharedInfo)); // Throws
+        m_map.map(m_file, util::File::access_ReadWrite, sizeof (SharedInfo)); // Throws
+        new (m_map.get_addr()) SharedInfo; // Throws
+    }
+    // Any process that holds a lock has initialized the queue, or is doing
+    // so under the exclusive lock, so the queue is ready once the shared
+    // lock is acquired
+    m_file.lock_shared(); // Throws
+    REALM_ASSERT(m_file.get_size() >= util::File::SizeType(sizeof (SharedInfo)));
+    if (!m_map.is_attached())
+        m_map.map(m_file, util::File::access_ReadWrite, sizeof (SharedInfo)); // Throws
+
+    SharedInfo& info = get_info();
+    std::size_t offset = reinterpret_cast<char*>(&info.cond) - reinterpret_cast<char*>(&info);
+    m_cond.set_shared_part(info.cond, path, offset); // Throws
+}
+
+inline std::string WriterQueue::get_queue_path(const std::string& database_file)
+{
+    return database_file + ".writers"; // Throws
+}
+
+inline WriterQueue::Stats WriterQueue::get_stats(Priority priority) const
+{
+    lock(); // Throws
+    const SharedStats& s = get_info().stats[priority];
+    Stats stats;
+    stats.num_turns = s.num_turns;
+    stats.num_yields = s.num_yields;
+    stats.total_wait = std::chrono::nanoseconds(s.total_wait_ns);
+    stats.max_wait = std::chrono::nanoseconds(s.max_wait_ns);
+    unlock();
+    return stats;
+}
+
+inline std::size_t WriterQueue::get_num_waiting(Priority priority) const REALM_NOEXCEPT
+{
+    return get_info().num_waiting[priority].load(std::memory_order_relaxed);
+}
+
+inline void WriterQueue::lock() const
+{
+    WriterQueue* self = const_cast<WriterQueue*>(this);
+    get_info().mutex.lock([self] { self->recover(); }); // Throws
+}
+
+inline void WriterQueue::unlock() const REALM_NOEXCEPT
+{
+    get_info().mutex.unlock();
+}
+
+inline void WriterQueue::acquire(Priority priority)
+{
+    typedef std::chrono::steady_clock clock;
+    clock::time_point begin = clock::now();
+    SharedInfo& info = get_info();
+    uint32_t pid = uint32_t(getpid());
+    WriterQueue* self = this;
+    auto recover_func = [self] { self->recover(); };
+
+    lock(); // Throws
+    std::size_t place = max_waiters;
+    for (;;) {
+        if (place == max_waiters) {
+            for (std::size_t i = 0; i < max_waiters; ++i) {
+                if (info.waiters[i].pid == 0) {
+                    Waiter& w = info.waiters[i];
+                    w.ticket = info.next_ticket++;
+                    w.passes = 0;
+                    w.pid = pid;
+                    w.priority = uint32_t(priority);
+                    ++info.num_waiting[priority];
+                    place = i;
+                    break;
+                }
+            }
+        }
+        if (info.holder_pid != 0 && !is_alive(info.holder_pid))
+            info.holder_pid = 0;
+        if (place != max_waiters && info.holder_pid == 0) {
+            std::size_t next = select_next();
+            while (next != max_waiters && !is_alive(info.waiters[next].pid)) {
+                // Waited for by a process that has died
+                --info.num_waiting[info.waiters[next].priority];
+                info.waiters[next].pid = 0;
+                next = select_next();
+            }
+            if (next == place)
+                break;
+        }
+
+        // Wake up now and then to check that the holder, and the waiters
+        // ahead of us, are still alive
+        std::chrono::system_clock::time_point deadline =
+            std::chrono::system_clock::now() + std::chrono::milliseconds(liveness_check_interval);
+        std::chrono::nanoseconds since_epoch = deadline.time_since_epoch();
+        struct timespec ts;
+        ts.tv_sec = time_t(std::chrono::duration_cast<std::chrono::seconds>(since_epoch).count());
+        ts.tv_nsec = long((since_epoch - std::chrono::seconds(ts.tv_sec)).count());
+        try {
+            m_cond.wait(info.mutex, recover_func, &ts); // Throws
+        }
+        catch (...) {
+            // The mutex is no longer locked
+            if (place != max_waiters) {
+                lock(); // Throws
+                if (info.waiters[place].pid == pid) {
+                    --info.num_waiting[priority];
+                    info.waiters[place].pid = 0;
+                }
+                unlock();
+            }
+            throw;
+        }
+    }
+
+    // Our turn
+    for (std::size_t i = 0; i < max_waiters; ++i) {
+        if (i != place && info.waiters[i].pid != 0)
+            ++info.waiters[i].passes;
+    }
+    --info.num_waiting[priority];
+    info.waiters[place].pid = 0;
+    info.holder_pid = pid;
+
+    uint64_t wait_ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        clock::now() - begin).count());
+    SharedStats& stats = info.stats[priority];
+    ++stats.num_turns;
+    stats.total_wait_ns += wait_ns;
+    if (wait_ns > stats.max_wait_ns)
+        stats.max_wait_ns = wait_ns;
+    unlock();
+}
+
+inline void WriterQueue::release(Priority priority, bool yielded) REALM_NOEXCEPT
+{
+    // Locking can only fail if the mutex became unrecoverable, in which
+    // case the queue is unusable anyway
+    try {
+        lock(); // Throws
+    }
+    catch (...) {
+        return;
+    }
+    SharedInfo& info = get_info();
+    info.holder_pid = 0;
+    if (yielded)
+        ++info.stats[priority].num_yields;
+    unlock();
+    m_cond.notify_all();
+}
+
+inline void WriterQueue::recover() REALM_NOEXCEPT
+{
+    // A process died while holding the mutex. Drop the places of dead
+    // processes, and recompute the counts from the places that are left.
+    SharedInfo& info = get_info();
+    if (info.holder_pid != 0 && !is_alive(info.holder_pid))
+        info.holder_pid = 0;
+    uint32_t num_waiting[num_priorities] = {};
+    for (std::size_t i = 0; i < max_waiters; ++i) {
+        Waiter& w = info.waiters[i];
+        if (w.pid == 0)
+            continue;
+        if (w.priority >= uint32_t(num_priorities) || !is_alive(w.pid)) {
+            w.pid = 0;
+            continue;
+        }
+        ++num_waiting[w.priority];
+    }
+    for (int i = 0; i < num_priorities; ++i)
+        info.num_waiting[i] = num_waiting[i];
+}
+
+inline std::size_t WriterQueue::select_next() const REALM_NOEXCEPT
+{
+    const SharedInfo& info = get_info();
+    std::size_t best = max_waiters;
+    bool best_is_overdue = false;
+    for (std::size_t i = 0; i < max_waiters; ++i) {
+        const Waiter& w = info.waiters[i];
+        if (w.pid == 0)
+            continue;
+        bool is_overdue = w.passes >= max_passes;
+        if (best != max_waiters) {
+            const Waiter& b = info.waiters[best];
+            if (is_overdue != best_is_overdue) {
+                if (!is_overdue)
+                    continue;
+            }
+            else if (!is_overdue && w.priority != b.priority) {
+                if (w.priority < b.priority)
+                    continue;
+            }
+            else if (w.ticket > b.ticket) {
+                continue;
+            }
+        }
+        best = i;
+        best_is_overdue = is_overdue;
+    }
+    return best;
+}
+
+inline bool WriterQueue::is_alive(uint32_t pid) REALM_NOEXCEPT
+{
+    return kill(pid_t(pid), 0) == 0 || errno != ESRCH;
+}
+
+
+inline WriterQueue::Turn::Turn(WriterQueue& queue, Priority priority):
+    m_queue(queue),
+    m_priority(priority)
+{
+    m_queue.acquire(priority); // Throws
+    m_is_held = true;
+}
+
+inline WriterQueue::Turn::~Turn() REALM_NOEXCEPT
+{
+    if (m_is_held)
+        m_queue.release(m_priority, false);
+}
+
+inline bool WriterQueue::Turn::should_yield() const REALM_NOEXCEPT
+{
+    const SharedInfo& info = m_queue.get_info();
+    for (int i = int(m_priority) + 1; i < num_priorities; ++i) {
+        if (info.num_waiting[i].load(std::memory_order_relaxed) != 0)
+            return true;
+    }
+    // Cheap check for overdue waiters of the same or lower priority, which
+    // may be slightly out of date, since the places are read without the
+    // mutex
+    for (std::size_t i = 0; i < max_waiters; ++i) {
+        const Waiter& w = info.waiters[i];
+        if (w.pid != 0 && w.passes >= max_passes)
+            return true;
+    }
+    return false;
+}
+
+inline void WriterQueue::Turn::yield()
+{
+    REALM_ASSERT(m_is_held);
+    m_queue.release(m_priority, true);
+    m_is_held = false;
+    m_queue.acquire(m_priority); // Throws
+    m_is_held = true;
+}
+
+} // namespace realm
+
+#endif // REALM_WRITER_QUEUE_HPP